@@ -0,0 +1,157 @@
+#include "BinaryProtocol.h"
+#include "ChatServer.h"
+#include "CommandTable.h"
+#include <string>
+
+namespace
+{
+    uint64_t userId(ChatServer *server, std::string_view username)
+    {
+        if (!server)
+        {
+            return 0;
+        }
+        if (std::shared_ptr<Client> client = server->findClientByUsername(username))
+        {
+            return client->getId();
+        }
+        Federation *federation = server->getFederation();
+        return federation ? federation->remoteUserId(username) : 0; // 0: already gone
+    }
+
+    // Drops the single space the text framing puts between fields
+    std::string_view restAfterSeparator(std::string_view rest)
+    {
+        if (!rest.empty() && rest.front() == ' ')
+        {
+            rest.remove_prefix(1);
+        }
+        return rest;
+    }
+
+    WireRef encodeLine(std::string_view line, ChatServer *server)
+    {
+        using BinaryProtocol::Opcode;
+
+        std::string_view rest = line;
+        std::string_view kind = CommandText::nextToken(rest);
+        rest = restAfterSeparator(rest);
+
+        if (kind == "OK" && rest.empty())
+        {
+            return BinaryProtocol::encode(Opcode::Ok, {});
+        }
+        if (kind == "PONG" && rest.empty())
+        {
+            return BinaryProtocol::encode(Opcode::Pong, {});
+        }
+        if (kind == "ERR")
+        {
+            return BinaryProtocol::encode(Opcode::Error, {rest});
+        }
+        if (kind == "INFO")
+        {
+            return BinaryProtocol::encode(Opcode::Info, {rest});
+        }
+        if (kind == "USER")
+        {
+            char id[8];
+            BinaryProtocol::putU64(id, userId(server, rest));
+            return BinaryProtocol::encode(Opcode::User, {std::string_view(id, sizeof(id)), rest});
+        }
+        if (kind == "DM")
+        {
+            std::string_view sender = CommandText::nextToken(rest);
+            char id[8];
+            BinaryProtocol::putU64(id, userId(server, sender));
+            return BinaryProtocol::encode(Opcode::Direct, {std::string_view(id, sizeof(id)), restAfterSeparator(rest)});
+        }
+        if (kind == "MSG")
+        {
+            // "MSG <user> <text>" in the lobby, "MSG <#room> <user> <text>" elsewhere
+            std::string_view room = DEFAULT_ROOM;
+            std::string_view sender = CommandText::nextToken(rest);
+            if (!sender.empty() && sender.front() == '#')
+            {
+                room = sender;
+                sender = CommandText::nextToken(rest);
+            }
+            char id[8];
+            BinaryProtocol::putU64(id, userId(server, sender));
+            char roomLength = static_cast<char>(room.size());
+            return BinaryProtocol::encode(Opcode::Message, {std::string_view(id, sizeof(id)), std::string_view(&roomLength, 1),
+                                                            room, restAfterSeparator(rest)});
+        }
+        if (kind == "ROOM")
+        {
+            std::string_view room = CommandText::nextToken(rest);
+            char count[4];
+            uint32_t members = 0;
+            for (char digit : CommandText::trim(rest))
+            {
+                members = members * 10 + static_cast<uint32_t>(digit - '0');
+            }
+            BinaryProtocol::putU32(count, members);
+            return BinaryProtocol::encode(Opcode::RoomInfo, {std::string_view(count, sizeof(count)), room});
+        }
+        return BinaryProtocol::encode(Opcode::Text, {line});
+    }
+}
+
+const char *BinaryProtocol::commandName(uint8_t opcode)
+{
+    switch (static_cast<Opcode>(opcode))
+    {
+    case Opcode::Login:
+        return "LOGIN";
+    case Opcode::Msg:
+        return "MSG";
+    case Opcode::Who:
+        return "WHO";
+    case Opcode::Ping:
+        return "PING";
+    case Opcode::Join:
+        return "JOIN";
+    case Opcode::Part:
+        return "PART";
+    case Opcode::Room:
+        return "ROOM";
+    case Opcode::History:
+        return "HISTORY";
+    default:
+        return nullptr;
+    }
+}
+
+WireRef BinaryProtocol::hello(uint8_t grantedFlags)
+{
+    char body[6];
+    body[0] = static_cast<char>(BINARY_PROTOCOL_VERSION);
+    putU32(body + 1, BINARY_MAX_FRAME);
+    body[5] = static_cast<char>(grantedFlags);
+    return encode(Opcode::Hello, {std::string_view(body, sizeof(body))});
+}
+
+WireRef BinaryProtocol::loginOk(uint64_t id)
+{
+    char body[8];
+    putU64(body, id);
+    return encode(Opcode::Ok, {std::string_view(body, sizeof(body))});
+}
+
+WireRef BinaryProtocol::translate(const WireRef &line, ChatServer *server)
+{
+    WireRef cached = line->encodedForm();
+    if (cached)
+    {
+        return cached;
+    }
+
+    std::string_view text(line->data(), line->size() - 1); // Without the '\n'
+    WireRef encoded = encodeLine(text, server);
+    if (!encoded)
+    {
+        return encoded;
+    }
+    return line->cacheEncodedForm(std::move(encoded));
+}
@@ -0,0 +1,137 @@
+#ifndef BINARYPROTOCOL_H
+#define BINARYPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include "WireBuffer.h"
+#include "serverDefaults.h"
+
+class ChatServer;
+
+// Compact framing that runs next to the newline text protocol on the same
+// port. Connect::performHandshake selects it when a connection opens with the
+// preamble {0x00, 'C', 'B', version | flags}; every frame after that, both ways, is
+//
+//   u32 length (big-endian; opcode + body) | u8 opcode | body
+//
+// Frames may carry up to BINARY_MAX_FRAME bytes, and users are identified by
+// their numeric connection id (u64, big-endian) where text uses usernames.
+namespace BinaryProtocol
+{
+    constexpr char MAGIC[3] = {'\0', 'C', 'B'};
+    constexpr size_t PREAMBLE_SIZE = sizeof(MAGIC) + 1; // Magic plus the version byte
+    constexpr size_t LENGTH_SIZE = 4;
+
+    // Preamble flags, sharing the version byte
+    constexpr uint8_t VERSION_MASK = 0x7f;
+    constexpr uint8_t FLAG_DEFLATE = 0x80; // Deflated frames allowed both ways (Compression.h)
+
+    enum class Opcode : uint8_t
+    {
+        // Client -> server; bodies are the text command's arguments
+        Login = 0x01, // username
+        Msg = 0x02,   // text, to the current room
+        Dm = 0x03,    // u64 target id, text
+        Who = 0x04,
+        Ping = 0x05,
+        Join = 0x06, // room
+        Part = 0x07, // [room]
+        Room = 0x08, // [room]
+        History = 0x09, // [count], as decimal text; replayed as Text frames
+
+        // Server -> client
+        Hello = 0x80,    // u8 version, u32 largest accepted frame, u8 granted flags
+        Ok = 0x81,       // After LOGIN: u64 own id
+        Error = 0x82,    // code, e.g. "username-taken"
+        Message = 0x83,  // u64 sender id, u8 room length, room, text
+        Direct = 0x84,   // u64 sender id, text
+        User = 0x85,     // u64 id, username
+        Info = 0x86,     // text
+        Pong = 0x87,
+        RoomInfo = 0x88, // u32 member count, room
+        Text = 0x8f,     // Any other server line, verbatim
+
+        // Either direction, once FLAG_DEFLATE is granted
+        Deflated = 0x90 // Raw deflate (preset dictionary) of one complete frame
+    };
+
+    // Text command a client opcode stands for, or null. Dm is not listed: it
+    // names its target by id and has its own handler.
+    const char *commandName(uint8_t opcode);
+
+    WireRef hello(uint8_t grantedFlags);
+    WireRef loginOk(uint64_t id);
+
+    // Binary form of a framed text line, made once per buffer and cached on
+    // it, so a broadcast is re-encoded once however many binary clients get it
+    WireRef translate(const WireRef &line, ChatServer *server);
+
+    // Big-endian integers
+    inline void putU32(char *out, uint32_t value)
+    {
+        for (int i = 3; i >= 0; --i)
+        {
+            out[i] = static_cast<char>(value & 0xff);
+            value >>= 8;
+        }
+    }
+
+    inline void putU64(char *out, uint64_t value)
+    {
+        for (int i = 7; i >= 0; --i)
+        {
+            out[i] = static_cast<char>(value & 0xff);
+            value >>= 8;
+        }
+    }
+
+    inline uint32_t getU32(const char *in)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            value = (value << 8) | static_cast<unsigned char>(in[i]);
+        }
+        return value;
+    }
+
+    // Reads a u64 off the front of body; false if body is too short
+    inline bool takeU64(std::string_view &body, uint64_t &value)
+    {
+        if (body.size() < 8)
+        {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            value = (value << 8) | static_cast<unsigned char>(body[i]);
+        }
+        body.remove_prefix(8);
+        return true;
+    }
+
+    // Frames body parts behind the length prefix and opcode; null if too long.
+    // Inline, like the helpers above, so code outside the server can frame too.
+    inline WireRef encode(Opcode opcode, std::initializer_list<std::string_view> body)
+    {
+        size_t length = 1;
+        for (std::string_view part : body)
+        {
+            length += part.size();
+        }
+        if (length > BINARY_MAX_FRAME)
+        {
+            return WireRef();
+        }
+
+        char header[LENGTH_SIZE + 1];
+        putU32(header, static_cast<uint32_t>(length));
+        header[LENGTH_SIZE] = static_cast<char>(opcode);
+        return WireBuffer::binaryFrame(std::string_view(header, sizeof(header)), body);
+    }
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "BroadcastService.h"
+#include "ChatServer.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include <unordered_set>
+
+BroadcastService::BroadcastService(ChatServer *srv)
+    : server(srv)
+{
+}
+
+void BroadcastService::toAll(const WireRef &payload)
+{
+    Metrics::ScopedTimer timer(Metrics::Histogram::Broadcast);
+
+    if (server->isSharded())
+    {
+        server->broadcastToShards(payload, "");
+        return;
+    }
+
+    const auto &clients = server->getAuthenticatedClients();
+    server->fanOut(clients.size(), [&](size_t begin, size_t end)
+                   {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (clients[i])
+            {
+                clients[i]->sendWire(payload);
+            }
+        } });
+}
+
+void BroadcastService::toOthers(const WireRef &payload, std::string_view exclude)
+{
+    Metrics::ScopedTimer timer(Metrics::Histogram::Broadcast);
+
+    if (server->isSharded())
+    {
+        server->broadcastToShards(payload, exclude);
+        return;
+    }
+
+    const auto &clients = server->getAuthenticatedClients();
+    server->fanOut(clients.size(), [&](size_t begin, size_t end)
+                   {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (clients[i] && !clients[i]->hasUsername(exclude))
+            {
+                clients[i]->sendWire(payload);
+            }
+        } });
+}
+
+void BroadcastService::toMembers(const std::shared_ptr<const Room::Members> &members, const WireRef &payload,
+                                 std::string_view exclude)
+{
+    Metrics::ScopedTimer timer(Metrics::Histogram::Broadcast);
+
+    if (server->isSharded())
+    {
+        server->broadcastToMembers(members, payload, exclude);
+        return;
+    }
+
+    // Logged-in clients never have an empty name, so "" excludes nobody
+    const Room::Members &recipients = *members;
+    server->fanOut(recipients.size(), [&](size_t begin, size_t end)
+                   {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto &client = recipients[i];
+            if (client && client->isAuthenticated() && !client->hasUsername(exclude))
+            {
+                client->sendWire(payload);
+            }
+        } });
+}
+
+void BroadcastService::toRoom(const Room &room, const WireRef &payload, std::string_view exclude)
+{
+    toMembers(room.snapshot(), payload, exclude);
+}
+
+void BroadcastService::toRooms(const std::vector<std::shared_ptr<Room>> &rooms, const WireRef &payload)
+{
+    if (rooms.size() == 1)
+    {
+        toRoom(*rooms[0], payload, "");
+        return;
+    }
+
+    // Everyone who shares one of the rooms hears it once; nobody else does
+    auto merged = std::make_shared<Room::Members>();
+    std::unordered_set<const Client *> seen;
+    for (auto &room : rooms)
+    {
+        for (auto &member : *room->snapshot())
+        {
+            if (seen.insert(member.get()).second)
+            {
+                merged->push_back(member);
+            }
+        }
+    }
+    toMembers(merged, payload, "");
+}
+
+void BroadcastService::chatMessage(const Room &room, std::string_view sender, std::string_view message)
+{
+    deliverChat(room.getName(), &room, sender, message);
+    if (Federation *federation = server->getFederation())
+    {
+        federation->forwardChat(room.getName(), sender, message);
+    }
+}
+
+void BroadcastService::info(const Room &room, std::string_view user, std::string_view event, std::string_view subject)
+{
+    deliverInfo(room, user, event, subject);
+    if (Federation *federation = server->getFederation())
+    {
+        federation->forwardInfo(room.getName(), user, event, subject);
+    }
+}
+
+void BroadcastService::chatFromPeer(std::string_view room, std::string_view sender, std::string_view message)
+{
+    // Recorded even with no members here, so HISTORY reads the same on every node
+    std::shared_ptr<Room> local = server->findRoom(room);
+    deliverChat(room, local.get(), sender, message);
+}
+
+void BroadcastService::infoFromPeer(std::string_view room, std::string_view user, std::string_view event,
+                                    std::string_view subject)
+{
+    if (std::shared_ptr<Room> local = server->findRoom(room))
+    {
+        deliverInfo(*local, user, event, subject);
+    }
+}
+
+void BroadcastService::departureFromPeer(std::string_view user, std::string_view event,
+                                         const std::vector<std::string_view> &rooms)
+{
+    std::vector<std::shared_ptr<Room>> local;
+    for (std::string_view name : rooms)
+    {
+        if (std::shared_ptr<Room> room = server->findRoom(name))
+        {
+            local.push_back(std::move(room));
+        }
+    }
+    if (local.empty())
+    {
+        return;
+    }
+
+    if (WireRef payload = WireBuffer::frame({"INFO ", user, " ", event}))
+    {
+        toRooms(local, payload);
+    }
+}
+
+void BroadcastService::deliverChat(std::string_view roomName, const Room *room, std::string_view sender,
+                                   std::string_view message)
+{
+    // The default room keeps the original "MSG <user> <text>" line; other
+    // rooms name themselves so clients can tell the conversations apart
+    WireRef formattedMessage = roomName == DEFAULT_ROOM
+                                   ? WireBuffer::frame({"MSG ", sender, " ", message})
+                                   : WireBuffer::frame({"MSG ", roomName, " ", sender, " ", message});
+    if (!formattedMessage)
+    {
+        Log::limited(Log::Level::Warn, "message-too-long", "Message too long");
+        return;
+    }
+    if (room)
+    {
+        toRoom(*room, formattedMessage, sender);
+    }
+
+    // Recorded after delivery; the log only copies it into its pending batch
+    if (MessageLog *history = server->getHistory())
+    {
+        history->append(MessageLog::Kind::Room, sender, roomName, message);
+    }
+}
+
+void BroadcastService::deliverInfo(const Room &room, std::string_view user, std::string_view event,
+                                   std::string_view subject)
+{
+    WireRef payload = subject.empty() ? WireBuffer::frame({"INFO ", user, " ", event})
+                                      : WireBuffer::frame({"INFO ", user, " ", event, " ", subject});
+    if (!payload)
+    {
+        Log::limited(Log::Level::Warn, "message-too-long", "Message too long");
+        return;
+    }
+    toRoom(room, payload, "");
+}
@@ -0,0 +1,50 @@
+#ifndef BROADCASTSERVICE_H
+#define BROADCASTSERVICE_H
+
+#include "RoomManager.h"
+#include "WireBuffer.h"
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class ChatServer;
+
+// Fan-out of one framed message to many clients. Holds nothing but the
+// server, so one instance serves every thread: the sender is passed by name
+// and nothing is constructed per message beyond the shared wire buffer.
+class BroadcastService
+{
+public:
+    explicit BroadcastService(ChatServer *srv);
+
+    // Every authenticated client, or every one but `exclude`
+    void toAll(const WireRef &payload);
+    void toOthers(const WireRef &payload, std::string_view exclude);
+
+    // The given members only, skipping `exclude` (empty: nobody)
+    void toMembers(const std::shared_ptr<const Room::Members> &members, const WireRef &payload, std::string_view exclude);
+    void toRoom(const Room &room, const WireRef &payload, std::string_view exclude);
+    void toRooms(const std::vector<std::shared_ptr<Room>> &rooms, const WireRef &payload); // Once per member
+
+    // "MSG <sender> <text>" to the room's other members, and into the history.
+    // Federated servers also pass it to every peer.
+    void chatMessage(const Room &room, std::string_view sender, std::string_view message);
+
+    // "INFO <user> <event> [subject]" to every member of the room, user included
+    void info(const Room &room, std::string_view user, std::string_view event, std::string_view subject = {});
+
+    // The same, for a message from a user on a peer: this server's members
+    // of the named room get it, and it goes no further
+    void chatFromPeer(std::string_view room, std::string_view sender, std::string_view message);
+    void infoFromPeer(std::string_view room, std::string_view user, std::string_view event, std::string_view subject);
+    void departureFromPeer(std::string_view user, std::string_view event, const std::vector<std::string_view> &rooms);
+
+private:
+    ChatServer *server;
+
+    // Frames, delivers to `room` (null: nobody here is in it) and records it
+    void deliverChat(std::string_view roomName, const Room *room, std::string_view sender, std::string_view message);
+    void deliverInfo(const Room &room, std::string_view user, std::string_view event, std::string_view subject);
+};
+
+#endif
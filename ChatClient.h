@@ -0,0 +1,162 @@
+#ifndef CHATCLIENT_H
+#define CHATCLIENT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "socketCompat.h"
+
+#ifndef MAX_BUFFER_SIZE
+#define MAX_BUFFER_SIZE 1024
+#endif
+
+#ifdef _WIN32
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+// Text-protocol connection to a ChatServer: connect, send command lines and
+// read server lines. Used by the interactive client and by bench/LoadGen.
+class ChatClient
+{
+private:
+    SOCKET clientSocket;
+    std::string serverAddress;
+    int serverPort;
+    bool connected;
+    std::string pending; // Received bytes after the last complete line
+
+public:
+    ChatClient(const std::string &address, int port)
+        : clientSocket(INVALID_SOCKET), serverAddress(address),
+          serverPort(port), connected(false) {}
+
+    ~ChatClient()
+    {
+        disconnect();
+    }
+
+    bool connect()
+    {
+        if (!socketStartup())
+        {
+            std::cerr << "WSAStartup failed" << std::endl;
+            return false;
+        }
+
+        clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (clientSocket == INVALID_SOCKET)
+        {
+            std::cerr << "Socket creation failed" << std::endl;
+            socketCleanup();
+            return false;
+        }
+
+        sockaddr_in serverAddr;
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(serverPort);
+        inet_pton(AF_INET, serverAddress.c_str(), &serverAddr.sin_addr);
+
+        if (::connect(clientSocket, (sockaddr *)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
+        {
+            std::cerr << "Connection failed: " << lastSocketError() << std::endl;
+            closesocket(clientSocket);
+            socketCleanup();
+            return false;
+        }
+
+        connected = true;
+        return true;
+    }
+
+    void disconnect()
+    {
+        if (clientSocket != INVALID_SOCKET)
+        {
+            closesocket(clientSocket);
+            clientSocket = INVALID_SOCKET;
+        }
+        connected = false;
+        socketCleanup();
+    }
+
+    bool sendMessage(const std::string &message)
+    {
+        if (!connected)
+            return false;
+
+        std::string fullMessage = message + "\n";
+        if(fullMessage.length() > MAX_BUFFER_SIZE)
+        {
+            std::cerr << "Message too long" << std::endl;
+            return false; // Message too long
+        }
+        int result = send(clientSocket, fullMessage.c_str(), fullMessage.length(), MSG_NOSIGNAL);
+        return result != SOCKET_ERROR;
+    }
+
+    // Reads once from the socket and appends every completed line, without
+    // its newline, to lines. Returns the bytes read: 0 once the server has
+    // closed the connection, SOCKET_ERROR on failure.
+    int receiveLines(std::vector<std::string> &lines)
+    {
+        if (!connected)
+            return 0;
+
+        char buffer[MAX_BUFFER_SIZE + 1];
+        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+        if (bytesReceived <= 0)
+        {
+            return bytesReceived;
+        }
+
+        pending.append(buffer, bytesReceived);
+        size_t start = 0;
+        size_t newline;
+        while ((newline = pending.find('\n', start)) != std::string::npos)
+        {
+            size_t end = newline;
+            if (end > start && pending[end - 1] == '\r')
+            {
+                --end;
+            }
+            lines.emplace_back(pending, start, end - start);
+            start = newline + 1;
+        }
+        pending.erase(0, start);
+        return bytesReceived;
+    }
+
+    void receiveLoop()
+    {
+        std::vector<std::string> lines;
+        while (connected)
+        {
+            lines.clear();
+            if (receiveLines(lines) > 0)
+            {
+                for (const std::string &message : lines)
+                {
+                    std::cout << "< " << message << std::endl;
+                }
+            }
+            else if (connected)
+            {
+                std::cout << "Disconnected from server" << std::endl;
+                connected = false;
+                break;
+            }
+        }
+    }
+
+    bool isConnected() const
+    {
+        return connected;
+    }
+
+    SOCKET getSocket() const
+    {
+        return clientSocket;
+    }
+};
+
+#endif
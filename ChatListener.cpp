@@ -1,123 +1,255 @@
 #include "ChatListener.h"
 #include "ChatServer.h"
-#include "BroadcastClient.h"
-#include "DMClient.h"
-#include <sstream>
+#include "BinaryProtocol.h"
+#include "Compression.h"
+#include "Metrics.h"
+#include "MessageLog.h"
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
 
-ChatListener::ChatListener(ChatServer *srv) : server(srv) {}
+ChatListener::ChatListener(ChatServer *srv) : server(srv), directMessageSlot(Metrics::commandSlot("DM"))
+{
+    registerCommand("LOGIN", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleLogin(c, args); }, false);
+    registerCommand("PING", [this](const std::shared_ptr<Client> &c, std::string_view)
+                    { handlePing(c); }, false);
+    registerCommand("MSG", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleChatMessage(c, args); });
+    registerCommand("WHO", [this](const std::shared_ptr<Client> &c, std::string_view)
+                    { handleWhoCommand(c); });
+    registerCommand("DM", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleDirectMessage(c, args); });
+    registerCommand("JOIN", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleJoin(c, args); });
+    registerCommand("PART", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handlePart(c, args); });
+    registerCommand("ROOM", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleRoom(c, args); });
+    registerCommand("STATS", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleStats(c, args); }, false);
+    registerCommand("HISTORY", [this](const std::shared_ptr<Client> &c, std::string_view args)
+                    { handleHistory(c, args); });
+}
 
-std::string ChatListener::trim(const std::string &str)
+bool ChatListener::registerCommand(std::string_view name, CommandTable::Handler handler, bool requiresAuth)
 {
-    size_t first = str.find_first_not_of(" \t\r\n");
-    if (first == std::string::npos)
-        return "";
-    size_t last = str.find_last_not_of(" \t\r\n");
-    return str.substr(first, (last - first + 1));
+    return commands.add(name, std::move(handler), requiresAuth, Metrics::commandSlot(name));
 }
 
-void ChatListener::handleMessage(std::shared_ptr<Client> client, const std::string &message)
+size_t ChatListener::handleMessages(std::shared_ptr<Client> client, const std::vector<std::string_view> &messages)
 {
-    if (message.empty())
+    bool binary = client->getProtocol() == Client::Protocol::Binary;
+    for (size_t i = 0; i < messages.size(); ++i)
     {
-        return;
+        {
+            Metrics::ScopedTimer timer(Metrics::Histogram::HandleMessage);
+            if (binary)
+            {
+                handleFrame(client, messages[i]);
+            }
+            else
+            {
+                handleMessage(client, messages[i]);
+            }
+        }
+        if (client->getInbox().isHeld())
+        {
+            return i + 1;
+        }
     }
+    return messages.size();
+}
 
-    std::string trimmedMessage = trim(message);
-    std::istringstream iss(trimmedMessage);
-    std::string command;
-    iss >> command;
+void ChatListener::handleMessage(const std::shared_ptr<Client> &client, std::string_view message)
+{
+    if (message.empty() || !admit(client, message.size()))
+    {
+        return;
+    }
 
-    // Convert command to uppercase for case-insensitive comparison
-    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+    std::string_view args = message;
+    std::string_view name = CommandText::nextToken(args);
+    dispatch(client, name, args);
+}
 
-    if (command == "LOGIN")
+void ChatListener::handleFrame(const std::shared_ptr<Client> &client, std::string_view frame)
+{
+    if (admit(client, frame.size()))
     {
-        std::string username;
-        iss >> username;
-        handleLogin(client, username);
+        dispatchFrame(client, frame);
     }
-    else if (command == "PING")
+}
+
+bool ChatListener::admit(const std::shared_ptr<Client> &client, size_t bytes)
+{
+    // Checked before parsing, so a flood costs one reply per line and never a broadcast
+    const ServerOptions &options = server->getOptions();
+    auto now = TokenBucket::Clock::now();
+    bool bytesAllowed = options.byteRate == 0 ||
+                        client->getByteTokens().take(double(bytes), double(options.byteRate), double(options.byteBurst), now);
+    if (bytesAllowed && (options.commandRate == 0 ||
+                         client->getCommandTokens().take(1, double(options.commandRate), double(options.commandBurst), now)))
     {
-        handlePing(client);
+        return true;
     }
-    else if (!client->isAuthenticated())
+    Metrics::add(Metrics::Counter::RateLimited);
+    client->sendMessage("ERR rate-limited");
+    return false;
+}
+
+void ChatListener::dispatchFrame(const std::shared_ptr<Client> &client, std::string_view frame)
+{
+    // The opcode names the command and the body is its arguments: no text to scan
+    uint8_t opcode = static_cast<uint8_t>(frame.front());
+    std::string_view body = frame.substr(1);
+
+    if (opcode == static_cast<uint8_t>(BinaryProtocol::Opcode::Deflated))
     {
-        client->sendMessage("ERR not-authenticated");
+        // One complete frame inside; it may not be compressed again
+        std::string inner;
+        if (!client->isCompressing() || !Compression::inflateFrame(body, inner) ||
+            inner.size() <= BinaryProtocol::LENGTH_SIZE ||
+            BinaryProtocol::getU32(inner.data()) != inner.size() - BinaryProtocol::LENGTH_SIZE ||
+            static_cast<uint8_t>(inner[BinaryProtocol::LENGTH_SIZE]) == opcode)
+        {
+            client->sendMessage("ERR bad-compressed-frame");
+            return;
+        }
+        dispatchFrame(client, std::string_view(inner).substr(BinaryProtocol::LENGTH_SIZE));
+        return;
     }
-    else if (command == "MSG")
+
+    if (opcode == static_cast<uint8_t>(BinaryProtocol::Opcode::Dm))
     {
-        std::string msg;
-        std::getline(iss, msg);
-        handleChatMessage(client, trim(msg));
+        if (!client->isAuthenticated())
+        {
+            client->sendMessage("ERR not-authenticated");
+            return;
+        }
+        Metrics::countCommand(directMessageSlot);
+        handleDirectMessageById(client, body);
+        return;
     }
-    else if (command == "WHO")
+
+    const char *name = BinaryProtocol::commandName(opcode);
+    dispatch(client, name ? std::string_view(name) : std::string_view(), body);
+}
+
+void ChatListener::dispatch(const std::shared_ptr<Client> &client, std::string_view name, std::string_view args)
+{
+    const CommandTable::Entry *command = name.empty() ? nullptr : commands.find(name);
+    Metrics::countCommand(command ? command->tag : 0);
+
+    if ((!command || command->requiresAuth) && !client->isAuthenticated())
     {
-        handleWhoCommand(client);
+        client->sendMessage("ERR not-authenticated");
     }
-    else if (command == "DM")
+    else if (!command)
     {
-        std::string remainingMessage;
-        std::getline(iss, remainingMessage);
-        handleDirectMessage(client, trim(remainingMessage));
+        client->sendMessage("ERR unknown-command");
     }
     else
     {
-        client->sendMessage("ERR unknown-command");
+        command->handler(client, args);
     }
 }
 
-void ChatListener::handleLogin(std::shared_ptr<Client> client, const std::string &username)
+void ChatListener::handleLogin(const std::shared_ptr<Client> &client, std::string_view args)
 {
+    std::string username(CommandText::nextToken(args));
+
     if (client->isAuthenticated())
     {
         client->sendMessage("ERR already-authenticated");
         return;
     }
 
-    if (username.empty())
+    // A leading '#' would make "MSG #room user text" ambiguous
+    if (username.empty() || username[0] == '#')
     {
         client->sendMessage("ERR invalid-username");
+        Metrics::add(Metrics::Counter::LoginFailures);
         return;
     }
 
-    if (server->isUsernameTaken(username))
+    // Check and register in one step so two concurrent LOGINs cannot both win.
+    // Federation peers may take a while to answer; meanwhile the connection's
+    // later commands wait in its inbox, not the thread running this one.
+    client->getInbox().hold();
+    server->claimUsername(username, client, [this, client, username](bool claimed)
+                          {
+        finishLogin(client, username, claimed);
+        server->resumeCommands(client); });
+}
+
+void ChatListener::finishLogin(const std::shared_ptr<Client> &client, const std::string &username, bool claimed)
+{
+    if (!claimed)
     {
         client->sendMessage("ERR username-taken");
+        Metrics::add(Metrics::Counter::LoginFailures);
         return;
     }
 
     client->setUsername(username);
     client->setAuthenticated(true);
-    client->sendMessage("OK");
+    server->addAuthenticatedClient(client);
+    Metrics::add(Metrics::Counter::Logins);
+    if (client->getProtocol() == Client::Protocol::Binary)
+    {
+        client->sendWire(BinaryProtocol::loginOk(client->getId())); // Binary clients address users by id
+    }
+    else
+    {
+        client->sendMessage("OK");
+    }
+
+    // DMs sent while the user was away. The user is findable by now, so a DM
+    // deposited concurrently is collected either here or by its sender's recheck
+    server->deliverMailbox(client);
 
-    // Notify other users using BroadcastClient instance
-    // Use INVALID_SOCKET since we're only using this for broadcasting
-    BroadcastClient broadcaster(INVALID_SOCKET, server);
-    broadcaster.setUsername(username);
-    broadcaster.setAuthenticated(true);
-    broadcaster.broadcastInfo(username + " connected");
+    // Everyone starts in the default room; only its members hear about the login
+    std::shared_ptr<Room> lobby;
+    if (server->joinRoom(client, DEFAULT_ROOM, lobby) != RoomManager::JoinResult::Joined)
+    {
+        return;
+    }
+
+    server->getBroadcasts().info(*lobby, username, "connected");
 }
 
-void ChatListener::handleChatMessage(std::shared_ptr<Client> client, const std::string &message)
+void ChatListener::handleChatMessage(const std::shared_ptr<Client> &client, std::string_view args)
 {
+    std::string_view message = CommandText::trim(args);
     if (message.empty())
     {
         client->sendMessage("ERR empty-message");
         return;
     }
 
-    // Create BroadcastClient instance and broadcast the message
-    // Use INVALID_SOCKET since we're only using this for broadcasting
-    BroadcastClient broadcaster(INVALID_SOCKET, server);
-    broadcaster.setUsername(client->getUsername());
-    broadcaster.setAuthenticated(true);
-    broadcaster.broadcastChatMessage(message);
+    // Only the members of the sender's current room receive it
+    std::shared_ptr<Room> room = client->getCurrentRoom();
+    if (!room)
+    {
+        client->sendMessage("ERR no-room");
+        return;
+    }
+
+    if (!server->chargeFanout(room->size()))
+    {
+        Metrics::add(Metrics::Counter::RateLimited);
+        client->sendMessage("ERR rate-limited");
+        return;
+    }
+
+    server->getBroadcasts().chatMessage(*room, client->getUsername(), message);
 }
 
-void ChatListener::handleWhoCommand(std::shared_ptr<Client> client)
+void ChatListener::handleWhoCommand(const std::shared_ptr<Client> &client)
 {
-    auto clients = server->getAuthenticatedClients();
+    const auto &clients = server->getAuthenticatedClients();
     for (auto &c : clients)
     {
         if (c)
@@ -125,13 +257,20 @@ void ChatListener::handleWhoCommand(std::shared_ptr<Client> client)
             client->sendMessage("USER " + c->getUsername());
         }
     }
+
+    // Then the users logged in on federated peers
+    if (Federation *federation = server->getFederation())
+    {
+        for (const std::string &username : federation->remoteUsers())
+        {
+            client->sendMessage("USER " + username);
+        }
+    }
 }
 
-void ChatListener::handleDirectMessage(std::shared_ptr<Client> client, const std::string &message)
+void ChatListener::handleDirectMessage(const std::shared_ptr<Client> &client, std::string_view args)
 {
-    std::istringstream iss(message);
-    std::string targetUsername;
-    iss >> targetUsername;
+    std::string_view targetUsername = CommandText::nextToken(args);
 
     if (targetUsername.empty())
     {
@@ -139,9 +278,7 @@ void ChatListener::handleDirectMessage(std::shared_ptr<Client> client, const std
         return;
     }
 
-    std::string dmMessage;
-    std::getline(iss, dmMessage);
-    dmMessage = trim(dmMessage);
+    std::string_view dmMessage = CommandText::trim(args);
 
     if (dmMessage.empty())
     {
@@ -149,18 +286,279 @@ void ChatListener::handleDirectMessage(std::shared_ptr<Client> client, const std
         return;
     }
 
-    // Create DMClient instance and send direct message
-    // Use INVALID_SOCKET since we're only using this for sending DM
-    DMClient dmSender(INVALID_SOCKET, server);
-    dmSender.setUsername(client->getUsername());
-    dmSender.setAuthenticated(true);
+    switch (server->getDirectMessages().send(client->getUsername(), targetUsername, dmMessage))
+    {
+    case DMService::Delivery::Sent:
+        break;
+    case DMService::Delivery::Queued:
+        client->sendMessage("INFO dm-queued " + std::string(targetUsername));
+        break;
+    case DMService::Delivery::MailboxFull:
+        client->sendMessage("ERR mailbox-full");
+        break;
+    case DMService::Delivery::NotFound:
+        client->sendMessage("ERR user-not-found");
+        break;
+    }
+}
+void ChatListener::handleDirectMessageById(const std::shared_ptr<Client> &client, std::string_view body)
+{
+    uint64_t targetId;
+    if (!BinaryProtocol::takeU64(body, targetId))
+    {
+        client->sendMessage("ERR invalid-dm-format");
+        return;
+    }
+    if (body.empty())
+    {
+        client->sendMessage("ERR empty-message");
+        return;
+    }
+
+    std::shared_ptr<Client> target = server->findClientById(targetId);
+    if (target)
+    {
+        if (!server->getDirectMessages().send(client->getUsername(), target, body))
+        {
+            client->sendMessage("ERR user-not-found");
+        }
+        return;
+    }
 
-    if (!dmSender.sendDirectMessage(targetUsername, dmMessage))
+    // A user on another node, by the id this node gave it
+    Federation *federation = server->getFederation();
+    std::string targetName;
+    if (!federation || !federation->remoteUserName(targetId, targetName) ||
+        !federation->forwardDirectMessage(client->getUsername(), targetName, body))
     {
         client->sendMessage("ERR user-not-found");
     }
 }
-void ChatListener::handlePing(std::shared_ptr<Client> client)
+
+void ChatListener::handlePing(const std::shared_ptr<Client> &client)
 {
     client->sendMessage("PONG");
 }
+
+void ChatListener::handleJoin(const std::shared_ptr<Client> &client, std::string_view args)
+{
+    std::string_view name = CommandText::nextToken(args);
+    if (!RoomManager::isValidName(name))
+    {
+        client->sendMessage("ERR invalid-room");
+        return;
+    }
+
+    std::shared_ptr<Room> room;
+    switch (server->joinRoom(client, std::string(name), room))
+    {
+    case RoomManager::JoinResult::Joined:
+        break;
+    case RoomManager::JoinResult::AlreadyMember:
+        client->selectRoom(name);
+        client->sendMessage("OK");
+        return;
+    case RoomManager::JoinResult::TooManyRooms:
+        client->sendMessage("ERR too-many-rooms");
+        return;
+    case RoomManager::JoinResult::Closed:
+        return;
+    }
+
+    client->sendMessage("OK");
+
+    server->getBroadcasts().info(*room, client->getUsername(), "joined", room->getName());
+}
+
+void ChatListener::handlePart(const std::shared_ptr<Client> &client, std::string_view args)
+{
+    std::string name(CommandText::nextToken(args));
+    if (name.empty())
+    {
+        // No argument: leave the current room
+        std::shared_ptr<Room> current = client->getCurrentRoom();
+        if (!current)
+        {
+            client->sendMessage("ERR no-room");
+            return;
+        }
+        name = current->getName();
+    }
+
+    std::shared_ptr<Room> room = server->partRoom(client, name);
+    if (!room)
+    {
+        client->sendMessage("ERR not-in-room");
+        return;
+    }
+
+    client->sendMessage("OK");
+
+    server->getBroadcasts().info(*room, client->getUsername(), "left", room->getName());
+}
+
+void ChatListener::handleRoom(const std::shared_ptr<Client> &client, std::string_view args)
+{
+    std::string_view name = CommandText::nextToken(args);
+    if (!name.empty())
+    {
+        // Switch the room MSG goes to
+        client->sendMessage(client->selectRoom(name) ? "OK" : "ERR not-in-room");
+        return;
+    }
+
+    // No argument: list joined rooms with their sizes, the current room first
+    std::shared_ptr<Room> current = client->getCurrentRoom();
+    if (!current)
+    {
+        client->sendMessage("ERR no-room");
+        return;
+    }
+
+    client->sendMessage("ROOM " + current->getName() + " " + std::to_string(current->size()));
+    for (auto &room : client->getRooms())
+    {
+        if (room != current)
+        {
+            client->sendMessage("ROOM " + room->getName() + " " + std::to_string(room->size()));
+        }
+    }
+}
+
+void ChatListener::handleStats(const std::shared_ptr<Client> &client, std::string_view args)
+{
+    const std::string &expected = server->getOptions().adminToken;
+    std::string_view token = CommandText::nextToken(args);
+
+    // Compares every byte so the reply time does not reveal a matching prefix
+    bool match = !expected.empty() && token.size() == expected.size();
+    unsigned char difference = 0;
+    for (size_t i = 0; match && i < token.size(); ++i)
+    {
+        difference |= static_cast<unsigned char>(token[i] ^ expected[i]);
+    }
+    if (!match || difference != 0)
+    {
+        client->sendMessage("ERR not-authorized");
+        return;
+    }
+
+    for (const std::string &line : Metrics::renderStatLines(server->collectGauges()))
+    {
+        client->sendMessage(line);
+    }
+    client->sendMessage("OK");
+}
+
+void ChatListener::handleHistory(const std::shared_ptr<Client> &client, std::string_view args)
+{
+    MessageLog *history = server->getHistory();
+    if (!history)
+    {
+        client->sendMessage("ERR history-disabled");
+        return;
+    }
+
+    size_t count = HISTORY_DEFAULT_COUNT;
+    std::string_view countText = CommandText::nextToken(args);
+    if (!countText.empty())
+    {
+        auto parsed = std::from_chars(countText.data(), countText.data() + countText.size(), count);
+        if (parsed.ec != std::errc() || parsed.ptr != countText.data() + countText.size() || count == 0)
+        {
+            client->sendMessage("ERR invalid-count");
+            return;
+        }
+        count = std::min<size_t>(count, HISTORY_MAX_COUNT);
+    }
+
+    // Messages in the rooms the client is in now, and DMs it sent or received
+    std::vector<std::shared_ptr<Room>> rooms = client->getRooms();
+    std::string username = client->getUsername();
+    auto visible = [&](const MessageLog::Entry &entry)
+    {
+        if (entry.kind == MessageLog::Kind::Direct)
+        {
+            return entry.sender == username || entry.scope == username;
+        }
+        for (const auto &room : rooms)
+        {
+            if (room->getName() == entry.scope)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // "HISTORY <ms> DM <from> <to> <text>" or "HISTORY <ms> MSG <#room> <from> <text>"
+    auto lineParts = [](const MessageLog::Entry &entry, char (&stamp)[24])
+    {
+        std::string_view time(stamp, std::to_chars(stamp, stamp + sizeof(stamp), entry.timeMs).ptr - stamp);
+        bool direct = entry.kind == MessageLog::Kind::Direct;
+        return std::array<std::string_view, 8>{"HISTORY ", time, direct ? " DM " : " MSG ",
+                                              direct ? entry.sender : entry.scope, " ",
+                                              direct ? entry.scope : entry.sender, " ", entry.text};
+    };
+    auto lineLength = [](const std::array<std::string_view, 8> &parts)
+    {
+        size_t length = 0;
+        for (std::string_view part : parts)
+        {
+            length += part.size();
+        }
+        return length;
+    };
+
+    // The whole reply is sized, then written straight from the mapped records
+    // into one buffer: one allocation per HISTORY, not one per line. Binary
+    // clients get Text frames; lines a client could not take are left out.
+    bool binary = client->getProtocol() == Client::Protocol::Binary;
+    size_t lineLimit = binary ? BINARY_MAX_FRAME : MAX_BUFFER_SIZE;
+    size_t overhead = binary ? BinaryProtocol::LENGTH_SIZE + 1 : 1;
+    history->replay(count, visible, [&](const std::vector<MessageLog::Entry> &entries)
+                    {
+        char stamp[24];
+        size_t total = 0;
+        for (const MessageLog::Entry &entry : entries)
+        {
+            size_t length = lineLength(lineParts(entry, stamp));
+            if (length + 1 <= lineLimit)
+            {
+                total += length + overhead;
+            }
+        }
+        if (total == 0)
+        {
+            return;
+        }
+
+        WireRef reply = WireBuffer::raw(total, [&](char *out)
+                                        {
+            for (const MessageLog::Entry &entry : entries)
+            {
+                std::array<std::string_view, 8> parts = lineParts(entry, stamp);
+                size_t length = lineLength(parts);
+                if (length + 1 > lineLimit)
+                {
+                    continue;
+                }
+                if (binary)
+                {
+                    BinaryProtocol::putU32(out, static_cast<uint32_t>(length + 1));
+                    out[BinaryProtocol::LENGTH_SIZE] = static_cast<char>(BinaryProtocol::Opcode::Text);
+                    out += BinaryProtocol::LENGTH_SIZE + 1;
+                }
+                for (std::string_view part : parts)
+                {
+                    std::memcpy(out, part.data(), part.size());
+                    out += part.size();
+                }
+                if (!binary)
+                {
+                    *out++ = '\n';
+                }
+            } });
+        client->sendEncoded(reply); });
+    client->sendMessage("OK");
+}
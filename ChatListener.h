@@ -2,28 +2,53 @@
 #define CHATLISTENER_H
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <memory>
 #include "Client.h"
+#include "CommandTable.h"
 
 class ChatServer;
 
 class ChatListener {
 private:
     ChatServer* server;
+    CommandTable commands;
+    size_t directMessageSlot; // Metrics slot for binary DMs, which skip the table
 
 public:
     explicit ChatListener(ChatServer* srv);
     
-    void handleMessage(std::shared_ptr<Client> client, const std::string& message);
+    // Dispatches the lines (or binary frames) framed from one read, in order.
+    // Returns how many ran: it stops after a command that holds the client's
+    // inbox (a LOGIN waiting on federation peers), and the caller parks the rest.
+    size_t handleMessages(std::shared_ptr<Client> client, const std::vector<std::string_view>& messages);
+    void handleMessage(const std::shared_ptr<Client>& client, std::string_view message);
+    void handleFrame(const std::shared_ptr<Client>& client, std::string_view frame); // Opcode + body
+
+    // Adds a command (or replaces one). The handler gets the rest of the line
+    // after the command name, untrimmed. Commands that require authentication
+    // answer "ERR not-authenticated" before LOGIN.
+    bool registerCommand(std::string_view name, CommandTable::Handler handler, bool requiresAuth = true);
     
 private:
-    void handleLogin(std::shared_ptr<Client> client, const std::string& username);
-    void handleChatMessage(std::shared_ptr<Client> client, const std::string& message);
-    void handleWhoCommand(std::shared_ptr<Client> client);
-    void handleDirectMessage(std::shared_ptr<Client> client, const std::string& message);
-    void handlePing(std::shared_ptr<Client> client);
-    
-    std::string trim(const std::string& str);
+    // Charges one command and its bytes to the client's token buckets;
+    // false (after answering "ERR rate-limited") if either is empty
+    bool admit(const std::shared_ptr<Client>& client, size_t bytes);
+    void dispatchFrame(const std::shared_ptr<Client>& client, std::string_view frame);
+    void dispatch(const std::shared_ptr<Client>& client, std::string_view name, std::string_view args);
+    void handleLogin(const std::shared_ptr<Client>& client, std::string_view args);
+    void finishLogin(const std::shared_ptr<Client>& client, const std::string& username, bool claimed);
+    void handleChatMessage(const std::shared_ptr<Client>& client, std::string_view args);
+    void handleWhoCommand(const std::shared_ptr<Client>& client);
+    void handleDirectMessage(const std::shared_ptr<Client>& client, std::string_view args);
+    void handleDirectMessageById(const std::shared_ptr<Client>& client, std::string_view body);
+    void handlePing(const std::shared_ptr<Client>& client);
+    void handleJoin(const std::shared_ptr<Client>& client, std::string_view args);
+    void handlePart(const std::shared_ptr<Client>& client, std::string_view args);
+    void handleRoom(const std::shared_ptr<Client>& client, std::string_view args);
+    void handleStats(const std::shared_ptr<Client>& client, std::string_view args); // Admin token required
+    void handleHistory(const std::shared_ptr<Client>& client, std::string_view args);
 };
 
 #endif
@@ -1,18 +1,43 @@
 #include "ChatServer.h"
 #include "ChatListener.h"
-#include "BroadcastClient.h"
-#include <iostream>
+#include "ClientPool.h"
+#include "Reactor.h"
+#include "UringBackend.h"
+#include "Logger.h"
 #include <thread>
 #include <algorithm>
-#include <ws2tcpip.h>
 
+#ifdef _WIN32
 #pragma comment(lib, "ws2_32.lib")
+#endif
+
+static ServerOptions defaultOptions(int serverPort, int idleTimeout)
+{
+    ServerOptions options;
+    options.port = serverPort;
+    options.idleTimeoutSeconds = idleTimeout;
+    return options;
+}
 
 ChatServer::ChatServer(int serverPort, int idleTimeout)
-    : port(serverPort), serverSocket(INVALID_SOCKET), running(false),
-      idleTimeoutSeconds(idleTimeout)
+    : ChatServer(defaultOptions(serverPort, idleTimeout))
+{
+}
+
+ChatServer::ChatServer(const ServerOptions &serverOptions)
+    : port(serverOptions.port), serverSocket(INVALID_SOCKET), running(false),
+      idleTimeoutSeconds(serverOptions.idleTimeoutSeconds), options(serverOptions),
+      startedAt(std::chrono::steady_clock::now()), broadcasts(this), directMessages(this)
 {
     listener = std::make_unique<ChatListener>(this);
+
+    // Shards already fan out in parallel, each to its own connections
+    int workers = options.fanoutThreads >= 0 ? options.fanoutThreads
+                                             : static_cast<int>(std::thread::hardware_concurrency()) - 1;
+    if (shardCount() == 1 && workers > 0)
+    {
+        fanoutPool = std::make_unique<FanoutPool>(workers);
+    }
 }
 
 ChatServer::~ChatServer()
@@ -22,19 +47,21 @@ ChatServer::~ChatServer()
 
 bool ChatServer::initializeWinsock()
 {
+#ifdef _WIN32
     WSADATA wsaData;
     int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (result != 0)
     {
-        std::cerr << "WSAStartup failed: " << result << std::endl;
+        Log::error("WSAStartup failed: ", result);
         return false;
     }
+#endif
     return true;
 }
 
 void ChatServer::cleanupWinsock()
 {
-    WSACleanup();
+    socketCleanup();
 }
 
 bool ChatServer::initialize()
@@ -44,85 +71,569 @@ bool ChatServer::initialize()
         return false;
     }
 
-    serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!options.handoffSocket.empty())
+    {
+        takeOver();
+    }
+    if (serverSocket == INVALID_SOCKET)
+    {
+        serverSocket = createListener(shardCount() > 1);
+    }
     if (serverSocket == INVALID_SOCKET)
     {
-        std::cerr << "Socket creation failed: " << WSAGetLastError() << std::endl;
         cleanupWinsock();
         return false;
     }
 
+    Log::info("Server initialized on port ", port);
+    return true;
+}
+
+SOCKET ChatServer::createListener(bool reusePort)
+{
+    SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET)
+    {
+        Log::error("Socket creation failed: ", lastSocketError());
+        return INVALID_SOCKET;
+    }
+
+#ifdef SO_REUSEPORT
+    // Lets every shard bind its own listener; the kernel spreads connections across them
+    int one = 1;
+    if (reusePort && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == SOCKET_ERROR)
+    {
+        Log::error("SO_REUSEPORT failed: ", lastSocketError());
+    }
+#else
+    (void)reusePort;
+#endif
+
     sockaddr_in serverAddr;
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
     serverAddr.sin_port = htons(port);
 
-    if (bind(serverSocket, (sockaddr *)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
+    if (bind(listenSocket, (sockaddr *)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
     {
-        std::cerr << "Bind failed: " << WSAGetLastError() << std::endl;
-        closesocket(serverSocket);
-        cleanupWinsock();
-        return false;
+        Log::error("Bind failed: ", lastSocketError());
+        closesocket(listenSocket);
+        return INVALID_SOCKET;
     }
 
-    if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR)
+    if (listen(listenSocket, SOMAXCONN) == SOCKET_ERROR)
     {
-        std::cerr << "Listen failed: " << WSAGetLastError() << std::endl;
-        closesocket(serverSocket);
-        cleanupWinsock();
-        return false;
+        Log::error("Listen failed: ", lastSocketError());
+        closesocket(listenSocket);
+        return INVALID_SOCKET;
     }
 
-    std::cout << "Server initialized on port " << port << std::endl;
-    return true;
+    return listenSocket;
+}
+
+int ChatServer::shardCount() const
+{
+#ifdef __linux__
+    if (options.ioBackend != IoBackendType::Epoll)
+    {
+        return 1;
+    }
+    int count = options.shards > 0 ? options.shards : static_cast<int>(std::thread::hardware_concurrency());
+    return count > 0 ? count : 1;
+#else
+    return 1;
+#endif
 }
 
 void ChatServer::start()
 {
     running = true;
-    std::cout << "Server started. Waiting for connections..." << std::endl;
+    Log::info("Server started. Waiting for connections...");
+
+    // Idle timeouts (and any other per-connection timers) run on the timer wheel's thread
+    timerThread = std::thread(&TimerWheel::run, &timers);
+
+    if (options.statsPort > 0)
+    {
+        metricsEndpoint = std::make_unique<MetricsEndpoint>(options.statsPort, [this]()
+                                                            { return Metrics::renderText(collectGauges()); });
+        if (!metricsEndpoint->start())
+        {
+            metricsEndpoint.reset();
+        }
+    }
+
+    if (!options.mailboxDir.empty())
+    {
+        mailboxes = std::make_shared<MailboxStore>(options.mailboxDir);
+        if (mailboxes->open())
+        {
+            mailboxSweep.bind(&timers, mailboxes, [this]()
+                              {
+                mailboxes->sweep();
+                mailboxSweep.schedule(MAILBOX_SWEEP_MS); });
+            mailboxSweep.schedule(MAILBOX_SWEEP_MS);
+        }
+        else
+        {
+            Log::warn("Offline mailboxes disabled");
+            mailboxes.reset();
+        }
+    }
+
+    if (!options.historyDir.empty())
+    {
+        history = std::make_unique<MessageLog>(options.historyDir);
+        if (!history->open())
+        {
+            Log::warn("Message history disabled");
+            history.reset();
+        }
+    }
+
+    if (options.peerPort > 0)
+    {
+        federation = std::make_unique<Federation>(this, usernames, options.nodeId, options.peerBind, options.peerPort,
+                                                  options.peers);
+        if (!federation->start())
+        {
+            Log::warn("Federation disabled");
+            federation.reset();
+        }
+    }
+
+    int commandWorkers = options.commandThreads >= 0 ? options.commandThreads
+                                                     : static_cast<int>(std::thread::hardware_concurrency());
+    if (commandWorkers > 0)
+    {
+        commandPool = std::make_unique<CommandPool>(commandWorkers, [this](const std::shared_ptr<Client> &client)
+                                                    { runCommands(client); });
+        Log::info("Command pool: ", commandWorkers, " workers");
+    }
+    if (fanoutPool)
+    {
+        Log::info("Fan-out pool: ", fanoutPool->size(), " workers for broadcasts to ", options.fanoutThreshold,
+                  "+ recipients");
+    }
+
+    createBackends();
+    adoptSessions();
+    if (!backends.empty())
+    {
+        if (restart)
+        {
+            // The successor connects from another process; stop the loops so its state can be sent
+            restart->listen([this]()
+                            {
+                for (auto &backend : backends)
+                {
+                    backend->release();
+                } });
+        }
 
-    // Start idle checker thread
-    std::thread idleCheckerThread([this]()
-                                  {
-        while (running) {
-            std::this_thread::sleep_for(std::chrono::seconds(10));
-            checkIdleClients();
-        } });
-    idleCheckerThread.detach();
+        if (backends.size() > 1)
+        {
+            Log::info("Using ", backends[0]->name(), " I/O backend (", backends.size(), " shards)");
+        }
+        else
+        {
+            Log::info("Using ", backends[0]->name(), " I/O backend");
+        }
 
+        // Shard 0 runs on this thread, the rest get their own
+        std::vector<std::thread> shardThreads;
+        for (size_t i = 1; i < backends.size(); ++i)
+        {
+            shardThreads.emplace_back(&IoBackend::run, backends[i].get());
+        }
+        backends[0]->run();
+        for (auto &thread : shardThreads)
+        {
+            thread.join();
+        }
+        if (restart && restart->hasSuccessor())
+        {
+            stop(); // Hands the connections over instead of closing them
+        }
+        return;
+    }
+
+    Log::info("Using thread-per-connection I/O");
+    std::thread writerThread(&ChatServer::flushSlowConsumers, this);
+    writerThread.detach();
     acceptClients();
 }
 
+void ChatServer::createBackends()
+{
+    IoBackendType type = options.ioBackend;
+
+    // Fall back uring -> epoll -> threads when the platform lacks support
+    if (type == IoBackendType::Uring)
+    {
+#ifdef CHATTCP_HAVE_IO_URING
+        auto uring = std::make_unique<UringBackend>(this, serverSocket);
+        if (uring->initialize())
+        {
+            backends.push_back(std::move(uring));
+            closeSpareListeners(0);
+            return;
+        }
+#endif
+        Log::warn("io_uring unavailable, falling back to epoll");
+        type = IoBackendType::Epoll;
+    }
+
+    if (type == IoBackendType::Epoll)
+    {
+#ifdef __linux__
+        int count = shardCount();
+        int cpus = static_cast<int>(std::thread::hardware_concurrency());
+
+        for (int i = 0; i < count; ++i)
+        {
+            SOCKET listenSocket = serverSocket;
+            if (i > 0 && static_cast<size_t>(i) <= shardListeners.size())
+            {
+                listenSocket = shardListeners[i - 1]; // Taken over from the previous process
+            }
+            else if (i > 0)
+            {
+                listenSocket = createListener(true);
+                if (listenSocket == INVALID_SOCKET)
+                {
+                    Log::warn("Shard ", i, ": no listener, running ", i, " shards");
+                    break;
+                }
+                shardListeners.push_back(listenSocket);
+            }
+
+            int cpu = options.pinCpus && cpus > 0 ? i % cpus : -1;
+            auto reactor = std::make_unique<Reactor>(this, listenSocket, i, cpu);
+            if (!reactor->initialize())
+            {
+                break;
+            }
+            shards.push_back(reactor.get());
+            backends.push_back(std::move(reactor));
+        }
+
+        if (!backends.empty())
+        {
+            closeSpareListeners(backends.size() - 1);
+            if (shards.size() < 2)
+            {
+                shards.clear(); // A single shard delivers inline
+            }
+            return;
+        }
+#endif
+        Log::warn("epoll unavailable, falling back to thread-per-connection");
+    }
+    closeSpareListeners(0);
+}
+
+void ChatServer::closeSpareListeners(size_t used)
+{
+    // Left open, the kernel would keep handing them connections nobody accepts
+    for (size_t i = used; i < shardListeners.size(); ++i)
+    {
+        closesocket(shardListeners[i]);
+    }
+    if (shardListeners.size() > used)
+    {
+        shardListeners.resize(used);
+    }
+}
+
+bool ChatServer::isSharded() const
+{
+    return !shards.empty();
+}
+
+void ChatServer::broadcastToShards(const WireRef &payload, std::string_view excludeUsername)
+{
+    int current = -1;
+#ifdef __linux__
+    current = Reactor::currentShard();
+#endif
+
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        if (static_cast<int>(i) == current)
+        {
+            continue; // Delivered inline below
+        }
+        shards[i]->post(ShardTask{payload, nullptr, std::string(excludeUsername), nullptr, false});
+    }
+
+    if (current >= 0)
+    {
+        shards[current]->broadcastLocal(payload, excludeUsername);
+    }
+}
+
+bool ChatServer::deliverTo(std::shared_ptr<Client> target, const WireRef &payload)
+{
+    int owner = target->getShard();
+#ifdef __linux__
+    if (isSharded() && owner >= 0 && owner != Reactor::currentShard())
+    {
+        shards[owner]->post(ShardTask{payload, target, "", nullptr, false});
+        return true;
+    }
+#endif
+    return target->sendWire(payload);
+}
+
+void ChatServer::broadcastToMembers(const std::shared_ptr<const ClientRoster::Members> &members, const WireRef &payload,
+                                    std::string_view excludeUsername)
+{
+    int current = -1;
+#ifdef __linux__
+    current = Reactor::currentShard();
+#endif
+
+    // Local members are served inline; each other shard that owns a member
+    // gets one task sharing the member list, not one task per member
+    static thread_local std::vector<char> pending;
+    pending.assign(shards.size(), 0);
+
+    for (auto &client : *members)
+    {
+        if (!client->isAuthenticated() || client->hasUsername(excludeUsername))
+        {
+            continue;
+        }
+        int owner = client->getShard();
+        if (owner < 0 || owner == current)
+        {
+            client->sendWire(payload);
+        }
+        else
+        {
+            pending[owner] = 1;
+        }
+    }
+
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        if (pending[i])
+        {
+            shards[i]->post(ShardTask{payload, nullptr, std::string(excludeUsername), members, false});
+        }
+    }
+}
+
+const ServerOptions &ChatServer::getOptions() const
+{
+    return options;
+}
+
+BroadcastService &ChatServer::getBroadcasts()
+{
+    return broadcasts;
+}
+
+DMService &ChatServer::getDirectMessages()
+{
+    return directMessages;
+}
+
+bool ChatServer::chargeFanout(size_t deliveries)
+{
+    if (options.fanoutBudget == 0)
+    {
+        return true;
+    }
+    double budget = static_cast<double>(options.fanoutBudget);
+    auto now = TokenBucket::Clock::now();
+    std::lock_guard<std::mutex> lock(fanoutBudgetMutex);
+    return fanoutBudget.take(static_cast<double>(deliveries), budget, budget, now);
+}
+
+Federation *ChatServer::getFederation()
+{
+    return federation.get();
+}
+
+std::shared_ptr<Room> ChatServer::findRoom(std::string_view name)
+{
+    return rooms.find(name);
+}
+
+MessageLog *ChatServer::getHistory()
+{
+    return history.get();
+}
+
+MailboxStore *ChatServer::getMailboxes()
+{
+    return mailboxes.get();
+}
+
+void ChatServer::deliverMailbox(const std::shared_ptr<Client> &client)
+{
+    if (!mailboxes)
+    {
+        return;
+    }
+
+    // Messages leave the mailbox only once queued; DMs deposited meanwhile
+    // are picked up by the next round
+    const std::string &username = client->getUsername();
+    for (;;)
+    {
+        size_t taken = 0;
+        std::vector<MailboxStore::Message> messages = mailboxes->collect(username, taken);
+        if (taken == 0)
+        {
+            return;
+        }
+
+        bool delivered = true;
+        if (!messages.empty())
+        {
+            // A count first, then each DM exactly as it would have arrived live
+            std::vector<WireRef> batch;
+            batch.reserve(messages.size() + 1);
+            batch.push_back(WireBuffer::frame("INFO mailbox " + std::to_string(messages.size())));
+            for (const MailboxStore::Message &message : messages)
+            {
+                WireRef line = WireBuffer::frame({"DM ", message.sender, " ", message.text});
+                if (line)
+                {
+                    batch.push_back(std::move(line));
+                }
+            }
+            delivered = client->sendBatch(batch);
+        }
+        if (!mailboxes->acknowledge(username, taken, delivered) || !delivered)
+        {
+            return;
+        }
+    }
+}
+
+std::vector<Metrics::Gauge> ChatServer::collectGauges()
+{
+    // Copied first so no client's send lock is taken under clientsMutex
+    std::vector<std::shared_ptr<Client>> connected = getClients();
+    size_t queued = 0, largest = 0, overWatermark = 0;
+    for (auto &client : connected)
+    {
+        size_t bytes = client->getOutboundBytes();
+        queued += bytes;
+        largest = std::max(largest, bytes);
+        if (bytes > options.outboundHighWatermark)
+        {
+            ++overWatermark;
+        }
+    }
+
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+    return {
+        {"uptime_seconds", "Seconds since the server started", uptime},
+        {"connections", "Open connections", static_cast<double>(connected.size())},
+        {"users", "Logged-in users", static_cast<double>(getAuthenticatedClients().size())},
+        {"rooms", "Open rooms", static_cast<double>(rooms.count())},
+        {"outbound_queued_bytes", "Bytes waiting in all outbound queues", static_cast<double>(queued)},
+        {"outbound_queue_max_bytes", "Largest single outbound queue", static_cast<double>(largest)},
+        {"outbound_over_watermark", "Clients above the outbound high watermark", static_cast<double>(overWatermark)},
+        {"client_slots", "Pooled client slots, in use or free", static_cast<double>(SlabPool::totalSlots())},
+        {"peers_linked", "Federation peers linked both ways", static_cast<double>(federation ? federation->linkedPeers() : 0)},
+        {"remote_users", "Users logged in on other nodes", static_cast<double>(federation ? federation->remoteUsers().size() : 0)},
+    };
+}
+
+void ChatServer::watchWritable(std::shared_ptr<Client> client)
+{
+    {
+        std::lock_guard<std::mutex> lock(writersMutex);
+        writeWaiters.push_back(std::move(client));
+    }
+    writersReady.notify_one();
+}
+
+void ChatServer::flushSlowConsumers()
+{
+    std::vector<std::shared_ptr<Client>> waiting;
+    std::vector<pollfd> fds;
+
+    while (running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(writersMutex);
+            writersReady.wait_for(lock, std::chrono::milliseconds(WRITER_POLL_MS),
+                                  [this, &waiting]() { return !writeWaiters.empty() || !waiting.empty(); });
+            for (auto &client : writeWaiters)
+            {
+                waiting.push_back(std::move(client));
+            }
+            writeWaiters.clear();
+        }
+
+        fds.clear();
+        for (auto &client : waiting)
+        {
+            fds.push_back(pollfd{client->getSocket(), POLLOUT, 0});
+        }
+        if (fds.empty() || pollSockets(fds.data(), fds.size(), WRITER_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        // Keep only the clients that still have output after this round
+        size_t kept = 0;
+        for (size_t i = 0; i < waiting.size(); ++i)
+        {
+            if (fds[i].revents != 0)
+            {
+                waiting[i]->flushOutbound();
+            }
+            if (waiting[i]->hasPendingOutput())
+            {
+                waiting[kept++] = std::move(waiting[i]);
+            }
+        }
+        waiting.resize(kept);
+    }
+}
+
 void ChatServer::acceptClients()
 {
     while (running)
     {
         sockaddr_in clientAddr;
-        int clientAddrSize = sizeof(clientAddr);
+        socklen_t clientAddrSize = sizeof(clientAddr);
         SOCKET clientSocket = accept(serverSocket, (sockaddr *)&clientAddr, &clientAddrSize);
 
         if (clientSocket == INVALID_SOCKET)
         {
             if (running)
             {
-                std::cerr << "Accept failed: " << WSAGetLastError() << std::endl;
+                Log::limited(Log::Level::Error, "accept", "Accept failed: ", lastSocketError());
             }
             continue;
         }
 
         char clientIP[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
-        std::cout << "New connection from " << clientIP << std::endl;
-
-        // Create a new Client object for this connection
-        auto client = std::make_shared<Client>(clientSocket, this);
+        Log::info("New connection from ", clientIP);
 
+        // Non-blocking so a slow reader can never stall the thread sending to it
+        if (!setNonBlocking(clientSocket))
         {
-            std::lock_guard<std::mutex> lock(clientsMutex);
-            clients.push_back(client);
+            Log::limited(Log::Level::Error, "nonblocking-client", "Failed to make client socket non-blocking: ", lastSocketError());
+            closesocket(clientSocket);
+            continue;
         }
 
+        // Create a new Client object for this connection
+        auto client = ClientPool::make<Client>(clientSocket, this);
+
+        addClient(client);
+
         // Handle client in a new thread
         std::thread clientThread(&ChatServer::handleClient, this, client);
         clientThread.detach();
@@ -133,35 +644,181 @@ void ChatServer::handleClient(std::shared_ptr<Client> client)
 {
     try
     {
+        std::vector<std::string_view> lines;
         while (running && client->getSocket() != INVALID_SOCKET)
         {
-            std::string message = client->receiveMessage();
-
-            if (message.empty())
+            lines.clear();
+            if (!client->receiveLines(lines))
             {
                 // Client disconnected
                 break;
             }
 
-            listener->handleMessage(client, message);
+            bool stalled = processMessages(client, lines);
+            client->releaseLines();
+
+            // Reads no further until the pool catches up; polls so a stop is noticed
+            while (stalled && running && !client->getInbox().waitUntilDrained(COMMAND_STALL_POLL_MS))
+            {
+            }
         }
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Exception handling client: " << e.what() << std::endl;
+        Log::limited(Log::Level::Error, "client-exception", "Exception handling client: ", e.what());
     }
 
-    // Client disconnected
-    if (client->isAuthenticated())
+    disconnectClient(client);
+}
+
+void ChatServer::addClient(std::shared_ptr<Client> client)
+{
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    clients[client->getId()] = client;
+    Metrics::add(Metrics::Counter::ConnectionsOpened);
+}
+
+bool ChatServer::processMessages(std::shared_ptr<Client> client, const std::vector<std::string_view> &lines)
+{
+    if (!commandPool)
     {
-        std::cout << "User " << client->getUsername() << " disconnected" << std::endl;
+        // Lines behind a LOGIN still waiting on the peers queue up after it
+        bool full;
+        if (client->getInbox().pushIfBusy(lines, full))
+        {
+            if (full)
+            {
+                Metrics::add(Metrics::Counter::InboxStalls);
+            }
+            return full;
+        }
+        size_t handled = listener->handleMessages(client, lines);
+        bool waiting = handled < lines.size() || client->getInbox().isHeld();
+        if (waiting && !client->getInbox().park(lines, handled))
+        {
+            runCommands(client); // Settled meanwhile: the rest is this thread's to run
+        }
+        return false;
+    }
+    if (lines.empty())
+    {
+        return false;
+    }
 
-        // Broadcast disconnection using BroadcastClient instance
-        // Use INVALID_SOCKET since we're only using this for broadcasting
-        BroadcastClient broadcaster(INVALID_SOCKET, this);
-        broadcaster.setUsername(client->getUsername());
-        broadcaster.setAuthenticated(true);
-        broadcaster.broadcastInfo(client->getUsername() + " disconnected");
+    bool schedule;
+    bool stalled = client->getInbox().push(lines, schedule);
+    if (stalled)
+    {
+        Metrics::add(Metrics::Counter::InboxStalls);
+    }
+    if (schedule)
+    {
+        commandPool->submit(std::move(client));
+    }
+    return stalled;
+}
+
+void ChatServer::scheduleCommands(const std::shared_ptr<Client> &client)
+{
+    if (commandPool)
+    {
+        commandPool->submit(client);
+    }
+    else
+    {
+        runCommands(client);
+    }
+}
+
+void ChatServer::resumeCommands(const std::shared_ptr<Client> &client)
+{
+    bool schedule;
+    client->getInbox().release(schedule);
+    if (schedule)
+    {
+        scheduleCommands(client);
+    }
+}
+
+void ChatServer::runCommands(const std::shared_ptr<Client> &client)
+{
+    static thread_local CommandInbox::Batch batch;
+    for (int turn = 0; !commandPool || turn < COMMAND_BATCHES_PER_TURN; ++turn)
+    {
+        if (!client->getInbox().take(batch))
+        {
+            return;
+        }
+        if (batch.resume)
+        {
+            resumeReading(client);
+        }
+        if (!runBatch(client, batch))
+        {
+            return; // The inbox stays scheduled until resumeCommands(), or for good once closed
+        }
+    }
+
+    // Still busy: back of the queue, so a flood from one client cannot hold a worker
+    commandPool->submit(client);
+}
+
+bool ChatServer::runBatch(const std::shared_ptr<Client> &client, const CommandInbox::Batch &batch)
+{
+    size_t handled = batch.lines.size();
+    try
+    {
+        handled = listener->handleMessages(client, batch.lines);
+    }
+    catch (const std::exception &e)
+    {
+        Log::limited(Log::Level::Error, "client-exception", "Exception handling client: ", e.what());
+        client->shutdownConnection(); // Its I/O thread sees EOF and disconnects it
+    }
+
+    // Parked behind a LOGIN unless it was settled meanwhile; the close waits too
+    if (handled < batch.lines.size() || client->getInbox().isHeld())
+    {
+        return !client->getInbox().park(batch.lines, handled);
+    }
+    if (batch.closed)
+    {
+        finishDisconnect(client);
+        return false;
+    }
+    return true;
+}
+
+void ChatServer::resumeReading(const std::shared_ptr<Client> &client)
+{
+    // Thread-per-client readers wait on the inbox themselves
+    if (backends.empty())
+    {
+        return;
+    }
+    int owner = client->getShard(); // Epoll shards are backends in order; io_uring has one
+    backends[owner >= 0 ? owner : 0]->resumeReading(client);
+}
+
+void ChatServer::disconnectClient(std::shared_ptr<Client> client)
+{
+    // Commands already read still run first, so a queued or parked LOGIN
+    // cannot outlive the connection
+    bool schedule;
+    client->getInbox().close(schedule);
+    if (schedule)
+    {
+        scheduleCommands(client);
+    }
+}
+
+void ChatServer::finishDisconnect(const std::shared_ptr<Client> &client)
+{
+    // Client disconnected
+    if (client->markLoggedOut())
+    {
+        Log::info("User ", client->getUsername(), " disconnected");
+        announceDeparture(client.get(), "disconnected");
     }
 
     removeClient(client);
@@ -169,93 +826,163 @@ void ChatServer::handleClient(std::shared_ptr<Client> client)
 
 void ChatServer::removeClient(std::shared_ptr<Client> client)
 {
+    client->getIdleTimer().cancel();
+    releaseUsername(client->getUsername(), client.get());
+    roster.remove(client.get());
+    rooms.leaveAll(client.get()); // Normally done already when the departure was announced
+
     std::lock_guard<std::mutex> lock(clientsMutex);
-    clients.erase(
-        std::remove_if(clients.begin(), clients.end(),
-                       [&client](const std::shared_ptr<Client> &c)
-                       {
-                           return c->getSocket() == client->getSocket();
-                       }),
-        clients.end());
+    if (clients.erase(client->getId()))
+    {
+        Metrics::add(Metrics::Counter::ConnectionsClosed);
+    }
 }
 
-void ChatServer::checkIdleClients()
+void ChatServer::onIdleTimer(Client *client)
 {
-    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto idleFor = std::chrono::steady_clock::now() - client->getLastActivity();
+    auto timeout = std::chrono::seconds(idleTimeoutSeconds);
+    if (idleFor < timeout)
+    {
+        // Active since the timer was armed: sleep for the rest of the window
+        client->getIdleTimer().schedule(std::chrono::duration_cast<std::chrono::milliseconds>(timeout - idleFor).count() + 1);
+        return;
+    }
 
-    for (auto it = clients.begin(); it != clients.end();)
+    if (!client->markLoggedOut())
     {
-        auto &client = *it;
+        return; // Already disconnecting
+    }
 
-        if (client->isAuthenticated() && client->isIdle(idleTimeoutSeconds))
-        {
-            std::cout << "User " << client->getUsername() << " timed out due to inactivity" << std::endl;
-            client->sendMessage("INFO timeout-disconnect");
+    const std::string &username = client->getUsername();
+    Log::info("User ", username, " timed out due to inactivity");
+    Metrics::add(Metrics::Counter::IdleEvictions);
 
-            std::string username = client->getUsername();
+    releaseUsername(username, client);
+    roster.remove(client);
+    client->sendMessage("INFO timeout-disconnect");
+    announceDeparture(client, "disconnected (timeout)");
 
-            // Notify other users using BroadcastClient instance
-            // Use INVALID_SOCKET since we're only using this for broadcasting
-            BroadcastClient broadcaster(INVALID_SOCKET, this);
-            broadcaster.setUsername(username);
-            broadcaster.setAuthenticated(true);
-            broadcaster.broadcastInfo(username + " disconnected (timeout)");
+    // Already announced; the owning thread only has to tear down the socket
+    client->shutdownConnection();
+}
 
-            client->close();
-            it = clients.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
+void ChatServer::announceDeparture(Client *client, std::string_view event)
+{
+    std::vector<std::shared_ptr<Room>> left = rooms.leaveAll(client);
+    if (left.empty())
+    {
+        return;
+    }
+
+    WireRef payload = WireBuffer::frame({"INFO ", client->getUsername(), " ", event});
+    if (!payload)
+    {
+        return;
+    }
+
+    broadcasts.toRooms(left, payload); // The client has already left
+    if (federation)
+    {
+        federation->forwardDeparture(client->getUsername(), event, left);
+    }
+}
+
+void ChatServer::releaseUsername(const std::string &username, const Client *client)
+{
+    if (usernames.release(username, client) && federation)
+    {
+        federation->release(username);
     }
 }
+
 bool ChatServer::isUsernameTaken(const std::string &username)
 {
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    for (auto &client : clients)
+    return usernames.contains(username) || (federation && federation->isRemoteUser(username));
+}
+
+void ChatServer::claimUsername(const std::string &username, std::shared_ptr<Client> client, Federation::ClaimDone done)
+{
+    // Held here while the peers are asked, so a local LOGIN cannot take it meanwhile
+    if (!usernames.claim(username, client))
+    {
+        done(false);
+        return;
+    }
+    if (!federation)
     {
-        if (client->isAuthenticated() && client->getUsername() == username)
+        done(true);
+        return;
+    }
+    federation->claim(username, [this, username, client, done = std::move(done)](bool granted)
+                      {
+        if (!granted)
         {
-            return true;
+            usernames.release(username, client.get());
         }
-    }
-    return false;
+        done(granted); });
 }
 
 std::vector<std::shared_ptr<Client>> ChatServer::getClients()
 {
     std::lock_guard<std::mutex> lock(clientsMutex);
-    return clients;
+    std::vector<std::shared_ptr<Client>> allClients;
+    allClients.reserve(clients.size());
+    for (auto &entry : clients)
+    {
+        allClients.push_back(entry.second);
+    }
+    return allClients;
 }
 
-std::vector<std::shared_ptr<Client>> ChatServer::getAuthenticatedClients()
+const ClientRoster::Members &ChatServer::getAuthenticatedClients()
 {
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    std::vector<std::shared_ptr<Client>> authClients;
-    for (auto &client : clients)
+    return roster.snapshot();
+}
+
+void ChatServer::addAuthenticatedClient(std::shared_ptr<Client> client)
+{
+    roster.add(client);
+
+    if (idleTimeoutSeconds > 0)
     {
-        if (client->isAuthenticated())
-        {
-            authClients.push_back(client);
-        }
+        Client *raw = client.get();
+        client->getIdleTimer().bind(&timers, client, [this, raw]() { onIdleTimer(raw); });
+        client->getIdleTimer().schedule(static_cast<int64_t>(idleTimeoutSeconds) * 1000);
     }
-    return authClients;
 }
 
-std::shared_ptr<Client> ChatServer::findClientByUsername(const std::string &username)
+std::shared_ptr<Client> ChatServer::findClientByUsername(std::string_view username)
+{
+    std::shared_ptr<Client> client = usernames.find(username);
+    if (client && client->isAuthenticated())
+    {
+        return client;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Client> ChatServer::findClientById(uint64_t id)
 {
     std::lock_guard<std::mutex> lock(clientsMutex);
-    for (auto &client : clients)
+    auto it = clients.find(id);
+    if (it != clients.end() && it->second->isAuthenticated())
     {
-        if (client->isAuthenticated() && client->getUsername() == username)
-        {
-            return client;
-        }
+        return it->second;
     }
     return nullptr;
 }
 
+RoomManager::JoinResult ChatServer::joinRoom(const std::shared_ptr<Client> &client, const std::string &name, std::shared_ptr<Room> &room)
+{
+    return rooms.join(client, name, room);
+}
+
+std::shared_ptr<Room> ChatServer::partRoom(const std::shared_ptr<Client> &client, std::string_view name)
+{
+    return rooms.part(client, name);
+}
+
 void ChatServer::stop()
 {
     if (!running)
@@ -264,24 +991,251 @@ void ChatServer::stop()
     }
 
     running = false;
-    std::cout << "Shutting down server..." << std::endl;
+    bool handingOff = restart && restart->hasSuccessor();
+    Log::info(handingOff ? "Handing over to the new server..." : "Shutting down server...");
+
+    for (auto &backend : backends)
+    {
+        backend->stop();
+    }
+    if (commandPool)
+    {
+        commandPool->stop(); // Handlers touch rooms and the roster, cleared below
+    }
+    if (handingOff)
+    {
+        finishPendingWork();
+    }
+    if (federation)
+    {
+        federation->stop(); // Frames from peers touch them too
+    }
+
+    if (metricsEndpoint)
+    {
+        metricsEndpoint->stop();
+    }
+    if (history)
+    {
+        history->close(); // Later appends are refused; the object lives until ~ChatServer
+    }
+
+    timers.stop();
+    if (timerThread.joinable() && timerThread.get_id() != std::this_thread::get_id())
+    {
+        timerThread.join();
+    }
 
     {
         std::lock_guard<std::mutex> lock(clientsMutex);
-        for (auto &client : clients)
+        bool handedOff = handingOff && handOffSessions();
+        for (auto &entry : clients)
         {
-            client->sendMessage("INFO server-shutdown");
-            client->close();
+            if (!handedOff)
+            {
+                entry.second->sendMessage("INFO server-shutdown");
+            }
+            entry.second->close(); // Only this process's descriptor once handed off
         }
         clients.clear();
     }
+    roster.clear();
+    rooms.clear();
+    if (restart)
+    {
+        restart->stop();
+    }
 
     if (serverSocket != INVALID_SOCKET)
     {
         closesocket(serverSocket);
         serverSocket = INVALID_SOCKET;
     }
+    for (SOCKET listenSocket : shardListeners)
+    {
+        closesocket(listenSocket);
+    }
+    shardListeners.clear();
 
     cleanupWinsock();
-    std::cout << "Server stopped" << std::endl;
+    Log::info("Server stopped");
+}
+
+void ChatServer::takeOver()
+{
+    if (options.ioBackend == IoBackendType::Threads)
+    {
+        Log::warn("Hot restart needs the epoll or io_uring backend; --handoff-socket ignored");
+        return;
+    }
+
+    restart = std::make_unique<HotRestart>(options.handoffSocket);
+    HotRestart::State state;
+    if (!restart->takeOver(state))
+    {
+        return; // Nobody to take over from: a cold start
+    }
+
+    serverSocket = state.listeners[0];
+    shardListeners.assign(state.listeners.begin() + 1, state.listeners.end()); // createBackends uses what it needs
+    inherited = std::move(state.sessions);
+}
+
+void ChatServer::adoptSessions()
+{
+    if (inherited.empty())
+    {
+        return;
+    }
+    if (backends.empty())
+    {
+        Log::warn("Hot restart: no event loop to resume ", inherited.size(), " connection(s) on; closing them");
+        for (HotRestart::Session &session : inherited)
+        {
+            closesocket(session.socket);
+        }
+        inherited.clear();
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::string_view> lines;
+    size_t next = 0;
+    for (HotRestart::Session &session : inherited)
+    {
+        // Round-robin over the shards, as SO_REUSEPORT spreads new connections
+        std::shared_ptr<Client> client = backends[next++ % backends.size()]->adopt(session.socket);
+        if (!client)
+        {
+            continue;
+        }
+        {
+            // Binary clients were told their ids at LOGIN and address others by them
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            clients.erase(client->getId());
+            client->restoreId(session.id);
+            clients[client->getId()] = client;
+        }
+        client->setProtocol(session.protocol);
+        client->setCompression(session.compression);
+
+        if (session.authenticated)
+        {
+            // The peers are only being dialed yet, so this is settled at once
+            // but for a link that came up first; if it is denied later, the
+            // connection goes the way of any other
+            bool taken = false;
+            claimUsername(session.username, client, [&taken, client, name = session.username](bool claimed)
+                          {
+                if (!claimed)
+                {
+                    taken = true;
+                    Log::warn("Hot restart: ", name, " is logged in elsewhere; dropping the connection");
+                    client->shutdownConnection();
+                } });
+            if (taken)
+            {
+                continue;
+            }
+            client->setUsername(session.username);
+            client->setAuthenticated(true);
+            addAuthenticatedClient(client);
+            for (const std::string &name : session.rooms)
+            {
+                std::shared_ptr<Room> room;
+                joinRoom(client, name, room);
+            }
+            client->selectRoom(session.currentRoom);
+        }
+
+        // Output first: it was produced before anything the input can cause
+        client->restoreUnsentOutput(session.output);
+        for (size_t offset = 0; offset < session.input.size(); offset += MAX_BUFFER_SIZE)
+        {
+            lines.clear();
+            client->appendReceived(session.input.data() + offset,
+                                   std::min<size_t>(MAX_BUFFER_SIZE, session.input.size() - offset), lines);
+            processMessages(client, lines);
+            client->releaseLines();
+        }
+        client->setLastActivity(now - std::chrono::milliseconds(session.idleMs));
+    }
+
+    Log::info("Hot restart: resumed ", inherited.size(), " connection(s)");
+    inherited.clear();
+}
+
+void ChatServer::finishPendingWork()
+{
+    // The event loops have returned and the command pool has stopped. A busy
+    // connection's inbox can outlast the pool, which drops resubmissions once
+    // stopping, and shards may still hold deliveries posted by other threads.
+    CommandInbox::Batch batch;
+    while (true)
+    {
+        bool parked = false;
+        for (const auto &client : getClients())
+        {
+            while (client->getInbox().take(batch) && runBatch(client, batch))
+            {
+            }
+            parked = parked || client->getInbox().isHeld();
+        }
+
+        // LOGINs still waiting on the peers are granted now, which releases
+        // the commands parked behind them for another pass
+        if (!parked || !federation)
+        {
+            break;
+        }
+        federation->grantPendingClaims();
+    }
+
+    for (auto &backend : backends)
+    {
+        backend->drainPending();
+    }
+}
+
+bool ChatServer::handOffSessions()
+{
+    HotRestart::State state;
+    state.listeners.push_back(serverSocket);
+    state.listeners.insert(state.listeners.end(), shardListeners.begin(), shardListeners.end());
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto &entry : clients)
+    {
+        Client &client = *entry.second;
+        if (client.getSocket() == INVALID_SOCKET)
+        {
+            continue; // Closed, its disconnect already run
+        }
+
+        HotRestart::Session session;
+        session.socket = client.getSocket();
+        session.id = client.getId();
+        session.protocol = client.getProtocol();
+        session.compression = client.isCompressing();
+        session.authenticated = client.isAuthenticated();
+        if (session.authenticated)
+        {
+            session.username = client.getUsername();
+            for (const auto &room : client.getRooms())
+            {
+                session.rooms.push_back(room->getName());
+            }
+            if (auto current = client.getCurrentRoom())
+            {
+                session.currentRoom = current->getName();
+            }
+        }
+        auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(now - client.getLastActivity()).count();
+        session.idleMs = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(idle, 0), UINT32_MAX));
+        session.input = client.unframedInput();
+        session.output = client.unsentOutput(); // Still queued here if the handoff fails
+        state.sessions.push_back(std::move(session));
+    }
+
+    return restart->handOff(state);
 }
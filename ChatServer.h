@@ -1,46 +1,193 @@
 #ifndef CHATSERVER_H
 #define CHATSERVER_H
 
-#include <winsock2.h>
 #include <vector>
+#include <unordered_map>
+#include <string_view>
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
 #include "Client.h"
+#include "IoBackend.h"
+#include "ServerOptions.h"
+#include "UserRegistry.h"
+#include "ClientRoster.h"
+#include "RoomManager.h"
+#include "TimerWheel.h"
+#include "Metrics.h"
+#include "MessageLog.h"
+#include "MailboxStore.h"
+#include "FanoutPool.h"
+#include "CommandPool.h"
+#include "BroadcastService.h"
+#include "DMService.h"
+#include "TokenBucket.h"
+#include "Federation.h"
+#include "HotRestart.h"
+#include <thread>
 
 class ChatListener;
+class Reactor;
 
 class ChatServer
 {
 private:
     int port;
     SOCKET serverSocket;
-    std::vector<std::shared_ptr<Client>> clients;
+    TimerWheel timers; // Declared before clients: their timers unlink from it on destruction
+    std::thread timerThread;
+    std::unordered_map<uint64_t, std::shared_ptr<Client>> clients; // Keyed by Client::getId()
     std::mutex clientsMutex;
+    UserRegistry usernames; // Logged-in users; has its own striped locks
+    ClientRoster roster;    // Snapshot of logged-in clients for fan-out and WHO
+    RoomManager rooms;      // Room membership; MSG and presence INFO go to rooms
     std::atomic<bool> running;
     std::unique_ptr<ChatListener> listener;
     int idleTimeoutSeconds;
+    ServerOptions options;
+    std::vector<std::unique_ptr<IoBackend>> backends; // Empty when running thread-per-client
+    std::vector<Reactor *> shards;                     // Set when running several epoll shards
+    std::vector<SOCKET> shardListeners;                // SO_REUSEPORT listeners for shards 1..N-1
+
+    // Thread-per-client mode: clients whose socket buffer filled up, drained by the writer thread
+    std::vector<std::shared_ptr<Client>> writeWaiters;
+    std::mutex writersMutex;
+    std::condition_variable writersReady;
+
+    std::chrono::steady_clock::time_point startedAt;
+    std::unique_ptr<MetricsEndpoint> metricsEndpoint; // With --stats-port
+    std::unique_ptr<MessageLog> history;              // With --history-dir; closed, not reset, by stop()
+    std::shared_ptr<MailboxStore> mailboxes;          // With --mailbox-dir
+    TimerNode mailboxSweep;                           // Expires old mail every MAILBOX_SWEEP_MS
+    std::unique_ptr<FanoutPool> fanoutPool;           // Unsharded backends only; null with no workers
+    std::unique_ptr<CommandPool> commandPool;         // Runs commands off the I/O threads; null with --command-threads=0
+    BroadcastService broadcasts;                      // Stateless fan-out, shared by every thread
+    DMService directMessages;
+    TokenBucket fanoutBudget; // With options.fanoutBudget; guarded by fanoutBudgetMutex
+    std::mutex fanoutBudgetMutex;
+    std::unique_ptr<Federation> federation; // With --peer-port
+    std::unique_ptr<HotRestart> restart;    // With --handoff-socket
+    std::vector<HotRestart::Session> inherited; // Taken over by initialize(), resumed by start()
 
 public:
     explicit ChatServer(int serverPort = 4000, int idleTimeout = 60);
+    explicit ChatServer(const ServerOptions &serverOptions);
     ~ChatServer();
 
     bool initialize();
     void start();
     void stop();
 
+    // Both cover every linked node when federated
     bool isUsernameTaken(const std::string &username);
+    // done(false) if taken. Runs at once unless federation peers have to be
+    // asked; then on the thread that settles the claim (Federation::claim).
+    void claimUsername(const std::string &username, std::shared_ptr<Client> client, Federation::ClaimDone done);
     std::vector<std::shared_ptr<Client>> getClients();
     void removeClient(std::shared_ptr<Client> client);
 
-    std::vector<std::shared_ptr<Client>> getAuthenticatedClients(); // Get all authenticated clients
+    // Immutable snapshot of authenticated clients in login order; valid until
+    // this thread calls it again. Lock-free unless the roster changed.
+    const ClientRoster::Members &getAuthenticatedClients();
+    void addAuthenticatedClient(std::shared_ptr<Client> client); // After a successful LOGIN
+
+    std::shared_ptr<Client> findClientByUsername(std::string_view username);
+    std::shared_ptr<Client> findClientById(uint64_t id); // Logged-in clients only
+
+    // Room membership (JOIN/PART); joining also makes the room the client's current one
+    RoomManager::JoinResult joinRoom(const std::shared_ptr<Client> &client, const std::string &name, std::shared_ptr<Room> &room);
+    std::shared_ptr<Room> partRoom(const std::shared_ptr<Client> &client, std::string_view name); // null if not a member
+
+    // Connection lifecycle hooks shared by the thread-per-client loop and the
+    // event loops. With a command pool, lines are copied into the client's
+    // inbox and run by a worker, and the disconnect runs after them.
+    // processMessages() returns true when the inbox is full: the caller stops
+    // reading the client until its backend's resumeReading() is called.
+    void addClient(std::shared_ptr<Client> client);
+    bool processMessages(std::shared_ptr<Client> client, const std::vector<std::string_view> &lines);
+    void disconnectClient(std::shared_ptr<Client> client);
+
+    // A command that held the client's inbox is done: runs the commands
+    // parked behind it, on the pool or (without one) on this thread
+    void resumeCommands(const std::shared_ptr<Client> &client);
+
+    // Sharded delivery: each shard fans out to its own connections, and messages
+    // for another shard's client travel through that shard's lock-free inbox
+    bool isSharded() const;
+    void broadcastToShards(const WireRef &payload, std::string_view excludeUsername);
+    bool deliverTo(std::shared_ptr<Client> target, const WireRef &payload);
+    void broadcastToMembers(const std::shared_ptr<const ClientRoster::Members> &members, const WireRef &payload,
+                            std::string_view excludeUsername);
+
+    // Calls body(begin, end) over [0, count): on this thread alone, or split
+    // across the fan-out pool once count reaches the threshold. Returns when
+    // every index is done, so the caller's next broadcast cannot overtake it.
+    template <typename Body>
+    void fanOut(size_t count, Body &&body)
+    {
+        if (fanoutPool && count >= options.fanoutThreshold)
+        {
+            Metrics::add(Metrics::Counter::ParallelFanouts);
+            fanoutPool->run(count, body);
+        }
+        else
+        {
+            body(size_t(0), count);
+        }
+    }
+
+    const ServerOptions &getOptions() const;
 
-    std::shared_ptr<Client> findClientByUsername(const std::string &username); 
+    BroadcastService &getBroadcasts();
+    DMService &getDirectMessages();
+
+    // Takes `deliveries` from the server-wide fan-out budget; false if it is
+    // spent for now. Always true when no budget is set.
+    bool chargeFanout(size_t deliveries);
+
+    // Links to the other nodes, or null when running standalone
+    Federation *getFederation();
+
+    std::shared_ptr<Room> findRoom(std::string_view name); // Null if nobody here is in it
+
+    // Persistent MSG/DM history, or null when --history-dir is not set
+    MessageLog *getHistory();
+
+    // Offline DM mailboxes, or null when --mailbox-dir is not set
+    MailboxStore *getMailboxes();
+    // Sends the client everything waiting in its mailbox, in one batch
+    void deliverMailbox(const std::shared_ptr<Client> &client);
+
+    // Current connection, room and outbound queue figures, for STATS and the
+    // metrics endpoint; counters and histograms live in Metrics
+    std::vector<Metrics::Gauge> collectGauges();
+
+    // Hands a client with unflushed output to the writer thread (thread-per-client mode)
+    void watchWritable(std::shared_ptr<Client> client);
 
 private:
+    SOCKET createListener(bool reusePort);
+    int shardCount() const;
+    void createBackends();
+    void closeSpareListeners(size_t used); // Inherited shard listeners past the first `used`
     void acceptClients();
     void handleClient(std::shared_ptr<Client> client);
-    void checkIdleClients();
+    void scheduleCommands(const std::shared_ptr<Client> &client); // Submits it, or drains it here without a pool
+    void runCommands(const std::shared_ptr<Client> &client); // A pool worker's turn, or all of it without a pool
+    bool runBatch(const std::shared_ptr<Client> &client, const CommandInbox::Batch &batch); // False: stop here
+    void resumeReading(const std::shared_ptr<Client> &client); // Its inbox drained after a stall
+    void finishDisconnect(const std::shared_ptr<Client> &client);
+    void onIdleTimer(Client *client);
+    void releaseUsername(const std::string &username, const Client *client); // Here and on the peers
+    void announceDeparture(Client *client, std::string_view event); // Leaves every room, tells their members
+    void flushSlowConsumers();
+
+    // Hot restart: taking the previous process's connections, and handing them on
+    void takeOver();
+    void adoptSessions();
+    void finishPendingWork();
+    bool handOffSessions(); // clientsMutex held
 
     static bool initializeWinsock();
     static void cleanupWinsock();
@@ -1,10 +1,18 @@
 #include "Client.h"
-#include <iostream>
-#include <ws2tcpip.h>
+#include "ChatServer.h"
+#include "RoomManager.h"
+#include "Connect.h"
+#include "BinaryProtocol.h"
+#include "Compression.h"
+#include "Metrics.h"
+#include "Logger.h"
 
 
+static std::atomic<uint64_t> nextClientId(1);
+
 Client::Client(SOCKET socket, ChatServer *srv)
-    : clientSocket(socket), authenticated(false), username(""), server(srv)
+    : clientSocket(socket), id(nextClientId.fetch_add(1, std::memory_order_relaxed)), username(""), authenticated(false), protocol(Protocol::Negotiating), compression(false), server(srv), shard(-1),
+      outboundBytes(0), outboundOffset(0), overLimit(false), evicted(false)
 {
     updateActivity();
 }
@@ -19,7 +27,21 @@ SOCKET Client::getSocket() const
     return clientSocket;
 }
 
-std::string Client::getUsername() const
+uint64_t Client::getId() const
+{
+    return id;
+}
+
+void Client::restoreId(uint64_t previous)
+{
+    id = previous;
+    uint64_t next = nextClientId.load(std::memory_order_relaxed);
+    while (next <= previous && !nextClientId.compare_exchange_weak(next, previous + 1, std::memory_order_relaxed))
+    {
+    }
+}
+
+const std::string &Client::getUsername() const
 {
     return username;
 }
@@ -29,6 +51,11 @@ void Client::setUsername(const std::string &name)
     username = name;
 }
 
+bool Client::hasUsername(std::string_view name) const
+{
+    return username == name;
+}
+
 bool Client::isAuthenticated() const
 {
     return authenticated;
@@ -39,63 +66,563 @@ void Client::setAuthenticated(bool auth)
     authenticated = auth;
 }
 
+bool Client::markLoggedOut()
+{
+    return authenticated.exchange(false);
+}
+
 bool Client::sendMessage(const std::string &message)
 {
-    std::string fullMessage = message + "\n";
-    if(fullMessage.length() > MAX_BUFFER_SIZE)
+    WireRef payload = WireBuffer::frame(message);
+    if (!payload)
     {
-        std::cerr << "Message too long" << std::endl;
+        Log::limited(Log::Level::Warn, "message-too-long", "Message too long");
         return false; // Message too long
     }
-    int result = send(clientSocket, fullMessage.c_str(), fullMessage.length(), 0);
-    return result != SOCKET_ERROR;
+
+    return sendWire(payload);
+}
+
+bool Client::sendWire(const WireRef &payload)
+{
+    Protocol mode = protocol.load(std::memory_order_acquire);
+    if (mode != Protocol::Binary)
+    {
+        if (payload->isBinary() || payload->size() > MAX_BUFFER_SIZE)
+        {
+            return false; // Text clients take lines up to MAX_BUFFER_SIZE; larger ones come from binary senders
+        }
+        return queueWire(payload);
+    }
+
+    WireRef encoded = encodeBinary(payload);
+    return encoded && queueWire(encoded);
+}
+
+bool Client::sendBatch(const std::vector<WireRef> &payloads)
+{
+    bool binary = protocol.load(std::memory_order_acquire) == Protocol::Binary;
+    std::vector<WireRef> queued;
+    queued.reserve(payloads.size());
+    for (const WireRef &payload : payloads)
+    {
+        if (binary)
+        {
+            WireRef encoded = encodeBinary(payload);
+            if (encoded)
+            {
+                queued.push_back(std::move(encoded));
+            }
+        }
+        else if (!payload->isBinary() && payload->size() <= MAX_BUFFER_SIZE)
+        {
+            queued.push_back(payload);
+        }
+    }
+    return queued.empty() || queueWires(queued.data(), queued.size());
+}
+
+bool Client::sendEncoded(const WireRef &bytes)
+{
+    return queueWire(bytes);
+}
+
+WireRef Client::encodeBinary(const WireRef &payload)
+{
+    // Re-encoded (and compressed) once per shared buffer, not once per binary recipient
+    WireRef encoded = payload->isBinary() ? payload : BinaryProtocol::translate(payload, server);
+    if (encoded && compression.load(std::memory_order_relaxed) && encoded->size() >= DEFLATE_MIN_FRAME)
+    {
+        // The frame itself when it does not compress
+        WireRef deflated = Compression::deflateFrame(encoded);
+        if (deflated)
+        {
+            return deflated;
+        }
+    }
+    return encoded;
 }
 
-std::string Client::receiveMessage()
+bool Client::queueWire(const WireRef &payload)
 {
-    char buffer[MAX_BUFFER_SIZE + 1];
-    int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+    return queueWires(&payload, 1);
+}
 
-    if (bytesReceived > 0)
+bool Client::queueWires(const WireRef *payloads, size_t count)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < count; ++i)
     {
-        buffer[bytesReceived] = '\0';
+        length += payloads[i]->size();
+    }
+
+    Admission admission;
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        if (clientSocket == INVALID_SOCKET || evicted)
+        {
+            return false;
+        }
+
+        admission = admitOutbound(length);
+        wasEmpty = outbound.empty();
+        if (admission == Admission::Accept)
+        {
+            outboundBytes += length;
+            for (size_t i = 0; i < count; ++i)
+            {
+                outbound.push_back(payloads[i]);
+            }
+        }
+        else if (admission == Admission::Evict)
+        {
+            evicted = true;
+            outbound.clear();
+            outboundBytes = 0;
+            outboundOffset = 0;
+        }
+    }
+
+    if (admission == Admission::Evict)
+    {
+        Metrics::add(Metrics::Counter::SlowConsumerEvictions);
+        Log::limited(Log::Level::Warn, "slow-consumer", "Evicting slow consumer ", (username.empty() ? "(anonymous)" : username));
+        shutdownConnection();
+        return false;
+    }
+    if (admission == Admission::Drop)
+    {
+        Metrics::add(Metrics::Counter::SendDropped);
+        return false;
+    }
+
+    // One flush attempt for the whole batch; the writev gathers it
+    onOutboundQueued(wasEmpty);
+    return true;
+}
+
+Client::Admission Client::admitOutbound(size_t length)
+{
+    static const ServerOptions defaults;
+    const ServerOptions &limits = server ? server->getOptions() : defaults;
+
+    if (outboundBytes + length <= limits.outboundHighWatermark)
+    {
+        return Admission::Accept;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!overLimit)
+    {
+        overLimit = true;
+        overLimitSince = now;
+    }
+
+    if (limits.slowConsumerPolicy == SlowConsumerPolicy::Drop)
+    {
+        return Admission::Drop;
+    }
+
+    // Disconnect policy: tolerate a burst for the grace period, but never let
+    // the queue grow past the hard cap
+    if (outboundBytes + length > limits.outboundHighWatermark * OUTBOUND_HARD_LIMIT_FACTOR ||
+        now - overLimitSince >= std::chrono::milliseconds(limits.slowConsumerGraceMs))
+    {
+        return Admission::Evict;
+    }
+    return Admission::Accept;
+}
+
+void Client::consumeOutbound(size_t length)
+{
+    Metrics::add(Metrics::Counter::BytesOut, length);
+
+    // The queue may have been cleared (eviction, close) while a write was in flight
+    while (length > 0 && !outbound.empty())
+    {
+        size_t left = outbound.front()->size() - outboundOffset;
+        if (length < left)
+        {
+            outboundOffset += length;
+            outboundBytes -= length;
+            break;
+        }
+        length -= left;
+        outboundBytes -= left;
+        outbound.pop_front();
+        outboundOffset = 0;
+    }
+
+    static const ServerOptions defaults;
+    const ServerOptions &limits = server ? server->getOptions() : defaults;
+    if (overLimit && outboundBytes <= limits.outboundLowWatermark)
+    {
+        overLimit = false;
+    }
+}
+
+void Client::onOutboundQueued(bool wasEmpty)
+{
+    if (!wasEmpty)
+    {
+        return; // Already waiting for the socket to become writable
+    }
+
+    if (flushOutbound() && shard < 0 && server && hasPendingOutput())
+    {
+        server->watchWritable(shared_from_this());
+    }
+}
+
+bool Client::flushOutbound()
+{
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        ok = writeOutbound();
+    }
+
+    if (!ok)
+    {
+        Metrics::add(Metrics::Counter::SendErrors);
+        shutdownConnection();
+    }
+    return ok;
+}
+
+bool Client::writeOutbound()
+{
+    IoSlice slices[OUTBOUND_MAX_IOV];
+
+    while (!outbound.empty() && clientSocket != INVALID_SOCKET)
+    {
+        size_t count = outbound.size() < OUTBOUND_MAX_IOV ? outbound.size() : OUTBOUND_MAX_IOV;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const WireBuffer &buffer = *outbound.at(i);
+            size_t skip = i == 0 ? outboundOffset : 0;
+            setIoSlice(slices[i], buffer.data() + skip, buffer.size() - skip);
+        }
+
+        long written = sendVector(clientSocket, slices, count);
+        if (written == SOCKET_ERROR)
+        {
+#ifndef _WIN32
+            if (errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            return socketWouldBlock();
+        }
+
+        consumeOutbound(written);
+    }
+    return true;
+}
+
+size_t Client::getOutboundBytes()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    return outboundBytes;
+}
+
+bool Client::hasPendingOutput()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    return !outbound.empty() && clientSocket != INVALID_SOCKET;
+}
+
+bool Client::receiveLines(std::vector<std::string_view> &lines)
+{
+    while (true)
+    {
+        extractInput(lines);
+        if (!lines.empty())
+        {
+            return true;
+        }
+        receiveBuffer.release(); // No views handed out; frees bytes a large frame already spilled
+
+        size_t space;
+        char *span = receiveBuffer.writableSpan(space);
+        int bytesReceived = recv(clientSocket, span, static_cast<int>(space), 0);
+        if (bytesReceived == SOCKET_ERROR && socketWouldBlock())
+        {
+            // Sockets are non-blocking so writers never stall; wait for input here
+            pollfd pfd{clientSocket, POLLIN, 0};
+            pollSockets(&pfd, 1, -1);
+            continue;
+        }
+        if (bytesReceived <= 0)
+        {
+            return false;
+        }
+        receiveBuffer.commit(bytesReceived);
+        Metrics::add(Metrics::Counter::BytesIn, bytesReceived);
         updateActivity();
-        std::string message(buffer);
+    }
+}
+
+Client::ReadResult Client::readLines(std::vector<std::string_view> &lines)
+{
+    ReadResult result = ReadResult::WouldBlock;
 
-        // Remove trailing newline/carriage return
-        while (!message.empty() && (message.back() == '\n' || message.back() == '\r'))
+    // Edge-triggered: keep reading until the kernel buffer is empty or the ring is full
+    while (true)
+    {
+        size_t space;
+        char *span = receiveBuffer.writableSpan(space);
+        if (space == 0)
         {
-            message.pop_back();
+            result = ReadResult::More;
+            break;
         }
 
-        return message;
+        int bytesReceived = recv(clientSocket, span, static_cast<int>(space), 0);
+        if (bytesReceived > 0)
+        {
+            receiveBuffer.commit(bytesReceived);
+            Metrics::add(Metrics::Counter::BytesIn, bytesReceived);
+            updateActivity();
+            continue;
+        }
+
+        if (bytesReceived == 0)
+        {
+            result = ReadResult::Closed; // Peer closed the connection
+            break;
+        }
+
+#ifndef _WIN32
+        if (errno == EINTR)
+        {
+            continue;
+        }
+#endif
+        result = socketWouldBlock() ? ReadResult::WouldBlock : ReadResult::Closed;
+        break;
+    }
+
+    // Lines that arrived before a close are still dispatched
+    extractInput(lines);
+    return result;
+}
+
+void Client::appendReceived(const char *data, size_t length, std::vector<std::string_view> &lines)
+{
+    Metrics::add(Metrics::Counter::BytesIn, length);
+    updateActivity();
+
+    // Backend chunks are at most MAX_BUFFER_SIZE and a partial line never
+    // exceeds it either (partial binary frames spill out of the ring before
+    // they could), so a released ring always has room
+    receiveBuffer.append(data, length);
+    extractInput(lines);
+}
+
+void Client::extractInput(std::vector<std::string_view> &lines)
+{
+    if (protocol.load(std::memory_order_relaxed) == Protocol::Negotiating)
+    {
+        // The first bytes pick the text or the binary protocol
+        Connect connection(shared_from_this(), server);
+        if (!connection.performHandshake())
+        {
+            return; // Preamble incomplete
+        }
+    }
+
+    if (protocol.load(std::memory_order_relaxed) == Protocol::Binary)
+    {
+        if (!receiveBuffer.extractFrames(lines))
+        {
+            // A bad length prefix leaves no way to find the next frame
+            sendMessage("ERR frame-too-large");
+            shutdownConnection();
+        }
+        return;
+    }
+
+    if (!receiveBuffer.extractLines(lines))
+    {
+        sendMessage("ERR line-too-long");
+    }
+}
+
+Client::Protocol Client::getProtocol() const
+{
+    return protocol.load(std::memory_order_acquire);
+}
+
+void Client::setProtocol(Protocol mode)
+{
+    protocol.store(mode, std::memory_order_release);
+}
+
+void Client::setCompression(bool enabled)
+{
+    compression.store(enabled, std::memory_order_release);
+}
+
+bool Client::isCompressing() const
+{
+    return compression.load(std::memory_order_acquire);
+}
+
+size_t Client::peekReceived(char *out, size_t length) const
+{
+    return receiveBuffer.peek(out, length);
+}
+
+void Client::discardReceived(size_t length)
+{
+    receiveBuffer.discard(length);
+}
+
+std::string Client::unframedInput() const
+{
+    return receiveBuffer.unframed();
+}
+
+std::string Client::unsentOutput()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    std::string bytes;
+    bytes.reserve(outboundBytes);
+    for (size_t i = 0; i < outbound.size(); ++i)
+    {
+        const WireRef &buffer = outbound.at(i);
+        size_t skip = i == 0 ? outboundOffset : 0;
+        bytes.append(buffer->data() + skip, buffer->size() - skip);
     }
+    return bytes;
+}
 
-    return "";
+void Client::restoreUnsentOutput(std::string_view bytes)
+{
+    // Already encoded for this client, so queued as is rather than through sendWire
+    if (!bytes.empty())
+    {
+        sendEncoded(WireBuffer::raw(bytes));
+    }
+}
+
+void Client::releaseLines()
+{
+    receiveBuffer.release();
 }
 
 void Client::updateActivity()
 {
-    lastActivity = std::chrono::steady_clock::now();
+    // The idle timer is not touched here: it re-checks this when it fires
+    lastActivity.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
 }
 
 bool Client::isIdle(int timeoutSeconds) const
 {
     auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - lastActivity);
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - getLastActivity());
     return duration.count() >= timeoutSeconds;
 }
 
+std::chrono::steady_clock::time_point Client::getLastActivity() const
+{
+    return std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(lastActivity.load(std::memory_order_relaxed)));
+}
+
+void Client::setLastActivity(std::chrono::steady_clock::time_point when)
+{
+    lastActivity.store(when.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+TimerNode &Client::getIdleTimer()
+{
+    return idleTimer;
+}
+
+CommandInbox &Client::getInbox()
+{
+    return inbox;
+}
+
+TokenBucket &Client::getCommandTokens()
+{
+    return commandTokens;
+}
+
+TokenBucket &Client::getByteTokens()
+{
+    return byteTokens;
+}
+
 void Client::close()
 {
+    std::lock_guard<std::mutex> lock(sendMutex);
     if (clientSocket != INVALID_SOCKET)
     {
         closesocket(clientSocket);
         clientSocket = INVALID_SOCKET;
     }
+    outbound.clear();
+    outboundBytes = 0;
+    outboundOffset = 0;
+}
+
+void Client::shutdownConnection()
+{
+#ifdef _WIN32
+    close();
+#else
+    // Keep the descriptor so its owner (reactor or client thread) sees EOF and
+    // runs the normal disconnect path; closing here would let the fd be reused.
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (clientSocket != INVALID_SOCKET)
+    {
+        ::shutdown(clientSocket, SHUT_RDWR);
+    }
+#endif
 }
 
 ChatServer *Client::getServer() const
 {
     return server;
 }
+
+std::shared_ptr<Room> Client::getCurrentRoom()
+{
+    std::lock_guard<std::mutex> lock(roomsMutex);
+    return currentRoom;
+}
+
+std::vector<std::shared_ptr<Room>> Client::getRooms()
+{
+    std::lock_guard<std::mutex> lock(roomsMutex);
+    return rooms;
+}
+
+bool Client::selectRoom(std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(roomsMutex);
+    for (auto &room : rooms)
+    {
+        if (room->getName() == name)
+        {
+            currentRoom = room;
+            return true;
+        }
+    }
+    return false;
+}
+
+int Client::getShard() const
+{
+    return shard;
+}
+
+void Client::setShard(int index)
+{
+    shard = index;
+}
@@ -2,42 +2,179 @@
 #define CLIENT_H
 
 #include <string>
-#include <winsock2.h>
+#include <cstdint>
+#include <atomic>
 #include <chrono>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include "socketCompat.h"
 #include "serverDefaults.h"
+#include "ReceiveBuffer.h"
+#include "OutboundQueue.h"
+#include "WireBuffer.h"
+#include "TimerWheel.h"
+#include "CommandPool.h"
+#include "TokenBucket.h"
 
 class ChatServer;
+class Room;
 
-class Client
+class Client : public std::enable_shared_from_this<Client>
 {
+public:
+    enum class Protocol
+    {
+        Negotiating, // No bytes received yet
+        Text,        // Newline-delimited commands
+        Binary       // Length-prefixed frames (BinaryProtocol.h)
+    };
+
 protected:
     SOCKET clientSocket;
+    uint64_t id; // Unique per connection; keys the server's client table
     std::string username;
-    bool authenticated;
-    std::chrono::steady_clock::time_point lastActivity;
+    std::atomic<bool> authenticated;
+    std::atomic<Protocol> protocol; // Settled by Connect::performHandshake on the first bytes
+    std::atomic<bool> compression;  // Binary only: Deflated frames negotiated
+    std::atomic<int64_t> lastActivity; // steady_clock ticks; written on every read, so kept lock-free
+    TimerNode idleTimer;               // Armed at LOGIN; re-checks lastActivity when it fires
+    CommandInbox inbox;                // Framed commands waiting for the command pool
+    TokenBucket commandTokens;         // Rate limits, used only by the thread running
+    TokenBucket byteTokens;            // this client's commands (ChatListener)
     ChatServer *server; // The server
+    int shard;          // Reactor shard that owns the socket, -1 if none
+    std::mutex sendMutex; // Serializes writers and close() on the socket
+    ReceiveBuffer receiveBuffer; // Owned by the thread reading the socket
+
+    // Bounded outbound queue, guarded by sendMutex. Framed messages wait here
+    // until the socket is writable and are flushed with one vectored write.
+    OutboundQueue outbound;
+    size_t outboundBytes;  // Queued bytes not yet acknowledged by the kernel
+    size_t outboundOffset; // Bytes of outbound.front() already written
+    bool overLimit;        // Above the high watermark and not yet back under the low one
+    bool evicted;          // Dropped as a slow consumer; accepts no more output
+    std::chrono::steady_clock::time_point overLimitSince;
+
+    // Joined rooms in join order and the one MSG goes to, guarded by
+    // roomsMutex. Only RoomManager changes them.
+    std::mutex roomsMutex;
+    std::vector<std::shared_ptr<Room>> rooms;
+    std::shared_ptr<Room> currentRoom;
+    friend class RoomManager;
 
 public:
+    enum class ReadResult
+    {
+        WouldBlock, // Socket drained
+        More,       // Ring full; dispatch and release the lines, then read again
+        Closed      // Peer closed or the socket failed
+    };
+
     Client(SOCKET socket, ChatServer *srv);
     virtual ~Client();
 
     SOCKET getSocket() const;
+    uint64_t getId() const;
+    void restoreId(uint64_t previous); // Hot restart: the id from the previous process; later ones start above it
     void close();
+    void shutdownConnection();
 
-    std::string getUsername() const;
+    const std::string &getUsername() const; // Set once, at LOGIN
     void setUsername(const std::string &name);
+    bool hasUsername(std::string_view name) const; // Compares without copying the name
     bool isAuthenticated() const;
     void setAuthenticated(bool auth);
 
+    // Clears the authenticated flag; true only for the one caller that did,
+    // so a disconnect and a timeout racing each other announce the user once
+    bool markLoggedOut();
+
+    // Frames and queues the message; false if it was dropped or the client evicted
     virtual bool sendMessage(const std::string &message);
-    std::string receiveMessage();
+
+    // Queues an already framed buffer, shared with other recipients. Binary
+    // clients get its binary encoding; text clients skip lines over MAX_BUFFER_SIZE.
+    bool sendWire(const WireRef &payload);
+
+    // Queues several buffers under one lock and flushes once, so they leave
+    // in a single gathered write. Buffers this client cannot take are skipped.
+    bool sendBatch(const std::vector<WireRef> &payloads);
+
+    // Queues bytes already encoded for this connection's protocol (lines or
+    // frames, possibly many in one buffer) as they are
+    bool sendEncoded(const WireRef &bytes);
+
+    // Writes as much queued output as the socket takes without blocking.
+    // Returns false (and shuts the connection down) if the socket failed.
+    bool flushOutbound();
+    bool hasPendingOutput();
+    size_t getOutboundBytes(); // Queued and not yet written
+
+    // Line framing over the receive ring. Each call appends the complete lines
+    // received so far; the views stay valid until releaseLines().
+    bool receiveLines(std::vector<std::string_view> &lines);    // Blocking; false once closed
+    ReadResult readLines(std::vector<std::string_view> &lines); // Non-blocking (reactor)
+    void appendReceived(const char *data, size_t length, std::vector<std::string_view> &lines);
+    void releaseLines();
+
+    // Protocol negotiation (Connect::performHandshake)
+    Protocol getProtocol() const;
+    void setProtocol(Protocol mode);
+    void setCompression(bool enabled);
+    bool isCompressing() const;
+    size_t peekReceived(char *out, size_t length) const; // Bytes not yet framed
+    void discardReceived(size_t length);
+
+    // Hot restart (HotRestart.h): the raw stream state, moved to the process
+    // taking the connection over. Only once its I/O thread has stopped.
+    // Input goes back in through appendReceived.
+    std::string unframedInput() const;
+    std::string unsentOutput(); // A copy; the queue stays until close()
+    void restoreUnsentOutput(std::string_view bytes);
 
     void updateActivity();
     bool isIdle(int timeoutSeconds) const;
+    std::chrono::steady_clock::time_point getLastActivity() const;
+    void setLastActivity(std::chrono::steady_clock::time_point when);
+    TimerNode &getIdleTimer();
+    CommandInbox &getInbox();
+    TokenBucket &getCommandTokens();
+    TokenBucket &getByteTokens();
 
     ChatServer *getServer() const;
+
+    std::shared_ptr<Room> getCurrentRoom();
+    std::vector<std::shared_ptr<Room>> getRooms(); // Join order
+    bool selectRoom(std::string_view name);         // false if not a member
+
+    int getShard() const;
+    void setShard(int index);
+
+protected:
+    enum class Admission
+    {
+        Accept,
+        Drop,
+        Evict
+    };
+
+    bool queueWire(const WireRef &payload);
+    bool queueWires(const WireRef *payloads, size_t count); // Admitted as a whole
+    WireRef encodeBinary(const WireRef &payload);           // Binary form, compressed if negotiated
+    Admission admitOutbound(size_t length); // sendMutex held
+    void consumeOutbound(size_t length);    // sendMutex held; drops fully written buffers
+    bool writeOutbound();                   // sendMutex held
+
+    // Called after a message is queued; wasEmpty is true if nothing was pending.
+    // The default tries an immediate non-blocking flush and leaves the rest to
+    // EPOLLOUT (reactor) or the server's writer thread (thread-per-client).
+    virtual void onOutboundQueued(bool wasEmpty);
+
+private:
+    // Negotiates the protocol on the first bytes, then frames lines or binary frames
+    void extractInput(std::vector<std::string_view> &lines);
 };
 
 #endif
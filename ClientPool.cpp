@@ -0,0 +1,83 @@
+#include "ClientPool.h"
+#include <algorithm>
+
+namespace
+{
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<SlabPool *> pools;
+    };
+
+    // Never destroyed: slots may be released by static destructors
+    Registry &registry()
+    {
+        static Registry *instance = new Registry();
+        return *instance;
+    }
+}
+
+SlabPool::SlabPool(size_t size, size_t alignment)
+    : slotSize(size), slotAlignment(alignment)
+{
+}
+
+SlabPool &SlabPool::forSlot(size_t size, size_t alignment)
+{
+    // Every slot in a slab stays aligned, and a free one can hold a pointer
+    alignment = std::max(alignment, alignof(void *));
+    size = (std::max(size, sizeof(void *)) + alignment - 1) / alignment * alignment;
+
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (SlabPool *pool : r.pools)
+    {
+        if (pool->slotSize == size && pool->slotAlignment == alignment)
+        {
+            return *pool;
+        }
+    }
+    r.pools.push_back(new SlabPool(size, alignment));
+    return *r.pools.back();
+}
+
+size_t SlabPool::totalSlots()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t total = 0;
+    for (SlabPool *pool : r.pools)
+    {
+        std::lock_guard<std::mutex> poolLock(pool->mutex);
+        total += pool->slabs.size() * CLIENT_SLAB_SLOTS;
+    }
+    return total;
+}
+
+void *SlabPool::allocate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!freeList)
+    {
+        char *slab = static_cast<char *>(::operator new(slotSize * CLIENT_SLAB_SLOTS, std::align_val_t(slotAlignment)));
+        slabs.push_back(slab);
+        // Threaded back to front so slots are handed out in address order
+        for (size_t i = CLIENT_SLAB_SLOTS; i-- > 0;)
+        {
+            void *slot = slab + i * slotSize;
+            *static_cast<void **>(slot) = freeList;
+            freeList = slot;
+        }
+    }
+
+    void *slot = freeList;
+    freeList = *static_cast<void **>(slot);
+    return slot;
+}
+
+void SlabPool::deallocate(void *slot)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    *static_cast<void **>(slot) = freeList;
+    freeList = slot;
+}
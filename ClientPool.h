@@ -0,0 +1,85 @@
+#ifndef CLIENTPOOL_H
+#define CLIENTPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include "serverDefaults.h"
+
+// Fixed-size slots carved out of slabs of CLIENT_SLAB_SLOTS. Freed slots go
+// on a free list and are handed out again first; slabs are kept until exit,
+// so the footprint follows the peak connection count.
+class SlabPool
+{
+public:
+    // The pool for one slot size, created on first use and never destroyed
+    static SlabPool &forSlot(size_t size, size_t alignment);
+    static size_t totalSlots(); // Across every pool, in use or free
+
+    void *allocate();
+    void deallocate(void *slot);
+
+private:
+    SlabPool(size_t size, size_t alignment);
+
+    size_t slotSize;
+    size_t slotAlignment;
+    std::mutex mutex;
+    void *freeList = nullptr; // Each free slot starts with the next one's address
+    std::vector<void *> slabs;
+};
+
+// Allocator that takes single objects from the SlabPool for their size
+template <typename T>
+class ClientAllocator
+{
+public:
+    typedef T value_type;
+
+    ClientAllocator() = default;
+    template <typename U>
+    ClientAllocator(const ClientAllocator<U> &) {}
+
+    T *allocate(size_t count)
+    {
+        if (count != 1)
+        {
+            return std::allocator<T>().allocate(count);
+        }
+        static SlabPool &pool = SlabPool::forSlot(sizeof(T), alignof(T));
+        return static_cast<T *>(pool.allocate());
+    }
+
+    void deallocate(T *object, size_t count)
+    {
+        if (count != 1)
+        {
+            std::allocator<T>().deallocate(object, count);
+            return;
+        }
+        static SlabPool &pool = SlabPool::forSlot(sizeof(T), alignof(T));
+        pool.deallocate(object);
+    }
+
+    template <typename U>
+    bool operator==(const ClientAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const ClientAllocator<U> &) const { return false; }
+};
+
+// Connections are created here instead of with make_shared. The Client and
+// its reference counts share one pooled slot, so a connection costs no heap
+// allocation once a slot has been freed, and the counts sit beside the object.
+namespace ClientPool
+{
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make(Args &&...args)
+    {
+        return std::allocate_shared<T>(ClientAllocator<T>(), std::forward<Args>(args)...);
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "ClientRoster.h"
+#include "Client.h"
+
+namespace
+{
+    struct CachedSnapshot
+    {
+        const ClientRoster *owner = nullptr;
+        uint64_t version = 0;
+        std::shared_ptr<const ClientRoster::Members> members;
+    };
+
+    thread_local CachedSnapshot cached;
+}
+
+ClientRoster::ClientRoster()
+    : current(std::make_shared<const Members>()), version(1)
+{
+}
+
+void ClientRoster::publish(std::shared_ptr<const Members> members)
+{
+    current = std::move(members);
+    version.fetch_add(1, std::memory_order_release);
+}
+
+void ClientRoster::add(const std::shared_ptr<Client> &client)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto members = std::make_shared<Members>(*current);
+    members->push_back(client);
+    publish(std::move(members));
+}
+
+void ClientRoster::remove(const Client *client)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto members = std::make_shared<Members>();
+    members->reserve(current->size());
+    for (auto &member : *current)
+    {
+        if (member.get() != client)
+        {
+            members->push_back(member);
+        }
+    }
+    if (members->size() != current->size())
+    {
+        publish(std::move(members));
+    }
+}
+
+void ClientRoster::clear()
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    publish(std::make_shared<const Members>());
+}
+
+const ClientRoster::Members &ClientRoster::snapshot()
+{
+    uint64_t latest = version.load(std::memory_order_acquire);
+    if (cached.owner != this || cached.version != latest)
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        cached.owner = this;
+        cached.version = version.load(std::memory_order_relaxed);
+        cached.members = current;
+    }
+    return *cached.members;
+}
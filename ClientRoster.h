@@ -0,0 +1,40 @@
+#ifndef CLIENTROSTER_H
+#define CLIENTROSTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Client;
+
+// Copy-on-write list of logged-in clients, in login order. Writers (login,
+// logout, disconnect) copy the list and publish the copy; readers get an
+// immutable snapshot. Each thread caches the snapshot it last saw and only
+// takes the lock once after a change, so a broadcast is a version check plus
+// iteration: no lock and no per-client refcount traffic.
+class ClientRoster
+{
+public:
+    typedef std::vector<std::shared_ptr<Client>> Members;
+
+private:
+    std::mutex writeMutex;
+    std::shared_ptr<const Members> current; // Guarded by writeMutex
+    std::atomic<uint64_t> version;          // Bumped after every publish
+
+    void publish(std::shared_ptr<const Members> members); // writeMutex held
+
+public:
+    ClientRoster();
+
+    void add(const std::shared_ptr<Client> &client);
+    void remove(const Client *client);
+    void clear();
+
+    // The reference stays valid until this thread calls snapshot() again
+    const Members &snapshot();
+};
+
+#endif
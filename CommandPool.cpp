@@ -0,0 +1,247 @@
+#include "CommandPool.h"
+#include "Client.h"
+#include <chrono>
+
+namespace
+{
+    // Lets a worker's own submissions go to its own deque
+    thread_local const CommandPool *currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+bool CommandInbox::push(const std::vector<std::string_view> &lines, bool &schedule)
+{
+    bool full;
+    std::lock_guard<std::mutex> lock(mutex);
+    append(lines, full);
+    schedule = !scheduled;
+    scheduled = true;
+    return full;
+}
+
+bool CommandInbox::pushIfBusy(const std::vector<std::string_view> &lines, bool &full)
+{
+    full = false;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!scheduled)
+    {
+        return false;
+    }
+    append(lines, full);
+    return true;
+}
+
+void CommandInbox::append(const std::vector<std::string_view> &lines, bool &full)
+{
+    for (std::string_view line : lines)
+    {
+        text.append(line.data(), line.size());
+        lengths.push_back(static_cast<uint32_t>(line.size()));
+    }
+
+    // Accepted whole: the lines are already out of the receive buffer. The
+    // overshoot is at most what the I/O thread reads before it stops.
+    full = text.size() > COMMAND_INBOX_LIMIT;
+    stalled = stalled || full;
+}
+
+bool CommandInbox::waitUntilDrained(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return drained.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]
+                            { return !stalled; });
+}
+
+void CommandInbox::close(bool &schedule)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    schedule = !scheduled;
+    scheduled = true;
+}
+
+bool CommandInbox::take(Batch &batch)
+{
+    batch.text.clear();
+    batch.lines.clear();
+    std::vector<uint32_t> taken;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (held)
+        {
+            return false;
+        }
+        if (lengths.empty() && !closed)
+        {
+            scheduled = false;
+            return false;
+        }
+        batch.text.swap(text); // The inbox keeps the batch's old buffer
+        taken.swap(lengths);
+        batch.closed = closed;
+        batch.resume = stalled;
+        stalled = false;
+    }
+    if (batch.resume)
+    {
+        drained.notify_one();
+    }
+
+    size_t offset = 0;
+    for (uint32_t length : taken)
+    {
+        batch.lines.emplace_back(batch.text.data() + offset, length);
+        offset += length;
+    }
+    return true;
+}
+
+void CommandInbox::hold()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    held = true;
+}
+
+bool CommandInbox::park(const std::vector<std::string_view> &lines, size_t from)
+{
+    std::string rest;
+    std::vector<uint32_t> restLengths;
+    for (size_t i = from; i < lines.size(); ++i)
+    {
+        rest.append(lines[i].data(), lines[i].size());
+        restLengths.push_back(static_cast<uint32_t>(lines[i].size()));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    text.insert(0, rest);
+    lengths.insert(lengths.begin(), restLengths.begin(), restLengths.end());
+    scheduled = true; // Whoever runs it next is the drainer
+    parked = held;
+    return parked;
+}
+
+void CommandInbox::release(bool &schedule)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    held = false;
+    schedule = parked;
+    parked = false;
+}
+
+CommandPool::CommandPool(int threads, Runner run)
+    : runner(std::move(run))
+{
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i]->thread = std::thread(&CommandPool::work, this, i);
+    }
+}
+
+CommandPool::~CommandPool()
+{
+    stop();
+}
+
+void CommandPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        if (!running.exchange(false))
+        {
+            return;
+        }
+    }
+    idle.notify_all();
+    for (auto &worker : workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+void CommandPool::submit(std::shared_ptr<Client> client)
+{
+    if (!running.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    // Counted first, so a thief never takes a task that is not counted yet
+    queued.fetch_add(1, std::memory_order_release);
+    size_t index = currentPool == this ? currentWorker
+                                       : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(client));
+    }
+
+    // A worker about to sleep checks the count under this lock, so it cannot miss it
+    std::lock_guard<std::mutex> lock(idleMutex);
+    if (sleeping > 0)
+    {
+        idle.notify_one();
+    }
+}
+
+std::shared_ptr<Client> CommandPool::take(size_t self)
+{
+    std::shared_ptr<Client> task;
+    {
+        Worker &own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+        }
+    }
+
+    // Steal the newest task of the first busy worker after this one
+    for (size_t i = 1; !task && i < workers.size(); ++i)
+    {
+        Worker &victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+        }
+    }
+
+    if (task)
+    {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+void CommandPool::work(size_t self)
+{
+    currentPool = this;
+    currentWorker = self;
+
+    while (true)
+    {
+        if (std::shared_ptr<Client> task = take(self))
+        {
+            runner(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        if (!running.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        ++sleeping;
+        idle.wait(lock, [this]
+                  { return queued.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_relaxed); });
+        --sleeping;
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef COMMANDPOOL_H
+#define COMMANDPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "serverDefaults.h"
+
+class Client;
+
+// Commands a connection's I/O thread has framed but the command pool has
+// not run yet, embedded in the Client. The lines are copied in, so the I/O
+// thread can release its receive buffer straight away. A connection is handed
+// to the pool only when its inbox goes from idle to busy, and only one worker
+// drains it at a time, so its commands run in the order they arrived. Past
+// COMMAND_INBOX_LIMIT bytes the I/O thread stops reading that connection
+// until the worker has drained it, which leaves the sender to TCP flow
+// control; the thread's other connections carry on. Pushing never blocks.
+//
+// A command that finishes later (a LOGIN waiting on federation peers) holds
+// the inbox: the lines after it are parked back in it, take() hands nothing
+// out, and release() lets the connection run again, so its commands keep
+// their order without a thread waiting.
+class CommandInbox
+{
+public:
+    // One worker's share: views into text, valid until the next take()
+    struct Batch
+    {
+        std::string text;
+        std::vector<std::string_view> lines;
+        bool closed = false; // The connection is gone; disconnect after these lines
+        bool resume = false; // Reading stalled at the limit; the I/O thread may go on
+    };
+
+    // Copies the lines in. True if that took the inbox past the limit: the
+    // caller stops reading the connection until a take() returns a batch with
+    // resume set. schedule is set when the caller must submit the connection.
+    bool push(const std::vector<std::string_view> &lines, bool &schedule);
+
+    // For a blocking reader thread after push() returned true: true once the
+    // inbox has been drained, false if timeoutMs passed first
+    bool waitUntilDrained(int timeoutMs);
+    // Without a command pool: queues the lines, as push(), only while the
+    // inbox is busy (held, or being drained); false if the caller may run
+    // them itself. full is set as push() returns it.
+    bool pushIfBusy(const std::vector<std::string_view> &lines, bool &full);
+
+    // Queues the disconnect behind every pending line
+    void close(bool &schedule);
+
+    // Moves everything pending into batch; false, and idle again, if empty
+    // (false too while held, but left busy)
+    bool take(Batch &batch);
+
+    // From the command that will finish later, before it starts that work
+    void hold();
+    bool isHeld() const { return held.load(std::memory_order_acquire); }
+
+    // From whoever ran the holding command, once it returned: puts
+    // lines[from..] back in front. True if still held: leave the connection
+    // until release() asks for it. False if released meanwhile: go on
+    // draining, the lines are next.
+    bool park(const std::vector<std::string_view> &lines, size_t from);
+
+    // From the command's completion. schedule is set when the caller must
+    // run the connection's inbox again (submit it, or drain it).
+    void release(bool &schedule);
+
+private:
+    std::mutex mutex;
+    std::condition_variable drained; // waitUntilDrained() waits here
+    std::string text;                // Lines back to back
+    std::vector<uint32_t> lengths;
+    bool scheduled = false; // Submitted to the pool, or being drained
+    bool stalled = false;   // Past the limit; the I/O thread stopped reading
+    bool closed = false;
+    std::atomic<bool> held{false}; // Written under mutex
+    bool parked = false;           // Held, and left by its drainer
+
+    void append(const std::vector<std::string_view> &lines, bool &full); // mutex held
+};
+
+// Fixed-size pool that runs ChatListener handlers for every connection, so
+// I/O threads only read and frame. Each worker has its own deque: new work
+// goes round-robin, a worker takes from the front of its own deque, and an
+// idle worker steals from the back of another's before going to sleep.
+class CommandPool
+{
+public:
+    typedef std::function<void(const std::shared_ptr<Client> &)> Runner;
+
+    // runner drains one connection's inbox; it may submit the connection again
+    CommandPool(int threads, Runner runner);
+    ~CommandPool();
+
+    CommandPool(const CommandPool &) = delete;
+    CommandPool &operator=(const CommandPool &) = delete;
+
+    void stop(); // Joins the workers; later submissions are dropped
+    void submit(std::shared_ptr<Client> client);
+    int size() const { return static_cast<int>(workers.size()); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Client>> tasks;
+        std::thread thread;
+    };
+
+    Runner runner;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextWorker{0};
+    std::atomic<size_t> queued{0}; // Tasks in all deques
+    std::atomic<bool> running{true};
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    int sleeping = 0; // Guarded by idleMutex
+
+    std::shared_ptr<Client> take(size_t self);
+    void work(size_t self);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "CommandTable.h"
+
+#define SLOT_MASK (COMMAND_TABLE_SIZE - 1)
+
+bool CommandTable::sameName(std::string_view upper, std::string_view token)
+{
+    if (upper.size() != token.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < token.size(); ++i)
+    {
+        if (upper[i] != fold(token[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CommandTable::add(std::string_view name, Handler handler, bool requiresAuth, size_t tag)
+{
+    uint32_t h = hash(name);
+    for (size_t probe = 0; probe < COMMAND_TABLE_SIZE; ++probe)
+    {
+        Entry &slot = slots[(h + probe) & SLOT_MASK];
+        if (slot.name.empty() || (slot.hash == h && sameName(slot.name, name)))
+        {
+            if (slot.name.empty())
+            {
+                // Keep at least one free slot so failed lookups terminate
+                if (count + 1 >= COMMAND_TABLE_SIZE)
+                {
+                    return false;
+                }
+                ++count;
+                slot.name.reserve(name.size());
+                for (char c : name)
+                {
+                    slot.name.push_back(fold(c));
+                }
+            }
+            slot.hash = h;
+            slot.handler = std::move(handler);
+            slot.requiresAuth = requiresAuth;
+            slot.tag = tag;
+            return true;
+        }
+    }
+    return false;
+}
+
+const CommandTable::Entry *CommandTable::find(std::string_view token) const
+{
+    if (token.empty())
+    {
+        return nullptr;
+    }
+
+    uint32_t h = hash(token);
+    for (size_t probe = 0; probe < COMMAND_TABLE_SIZE; ++probe)
+    {
+        const Entry &slot = slots[(h + probe) & SLOT_MASK];
+        if (slot.name.empty())
+        {
+            return nullptr;
+        }
+        if (slot.hash == h && sameName(slot.name, token))
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,99 @@
+#ifndef COMMANDTABLE_H
+#define COMMANDTABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "serverDefaults.h"
+
+class Client;
+
+// Splits a command line without copying: every result is a view into the
+// line the receive ring handed out.
+namespace CommandText
+{
+    inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+    }
+
+    inline std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && isSpace(text.front()))
+            text.remove_prefix(1);
+        while (!text.empty() && isSpace(text.back()))
+            text.remove_suffix(1);
+        return text;
+    }
+
+    // Returns the first whitespace-separated token and leaves the rest, untrimmed, in text
+    inline std::string_view nextToken(std::string_view &text)
+    {
+        size_t start = 0;
+        while (start < text.size() && isSpace(text[start]))
+            ++start;
+        size_t end = start;
+        while (end < text.size() && !isSpace(text[end]))
+            ++end;
+        std::string_view token = text.substr(start, end - start);
+        text.remove_prefix(end);
+        return token;
+    }
+}
+
+// Open-addressed table from command name to handler. Names match
+// case-insensitively through a constexpr hash, so built-in names hash at
+// compile time and a lookup is one hash of the token, usually one probe and
+// one comparison. New commands are added with add().
+class CommandTable
+{
+public:
+    typedef std::function<void(const std::shared_ptr<Client> &, std::string_view)> Handler;
+
+    struct Entry
+    {
+        uint32_t hash = 0;
+        std::string name; // Upper case; empty marks a free slot
+        Handler handler;
+        bool requiresAuth = true;
+        size_t tag = 0; // Caller's data for the command, e.g. its metrics slot
+    };
+
+    static constexpr char fold(char c)
+    {
+        return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+
+    // Case-insensitive FNV-1a
+    static constexpr uint32_t hash(std::string_view name)
+    {
+        uint32_t h = 2166136261u;
+        for (char c : name)
+        {
+            h ^= static_cast<unsigned char>(fold(c));
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+private:
+    static_assert((COMMAND_TABLE_SIZE & (COMMAND_TABLE_SIZE - 1)) == 0, "COMMAND_TABLE_SIZE must be a power of two");
+
+    Entry slots[COMMAND_TABLE_SIZE];
+    size_t count = 0;
+
+    static bool sameName(std::string_view upper, std::string_view token);
+
+public:
+    // Registers or replaces a command; false if the table is full
+    bool add(std::string_view name, Handler handler, bool requiresAuth = true, size_t tag = 0);
+
+    // Null when no command has this name
+    const Entry *find(std::string_view token) const;
+};
+
+static_assert(CommandTable::hash("msg") == CommandTable::hash("MSG"), "command hash must ignore case");
+
+#endif
@@ -0,0 +1,155 @@
+#include "Compression.h"
+#include "BinaryProtocol.h"
+#include "serverDefaults.h"
+#include <vector>
+
+#ifdef CHATTCP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+    // Later bytes are cheaper to reference, so the most common material is last
+    const char presetDictionary[] =
+        "would about there their which could people think really should right "
+        "going because after before again still never always maybe sorry thanks "
+        "thank please today tomorrow tonight morning night week time work home "
+        "good great nice cool yeah okay what when where who why how this that "
+        "with have from your just like know will been they them then than "
+        "test build deploy release merge review issue error fixed done "
+        "hello everyone anyone someone here back later soon lol "
+        "disconnected (timeout) connected joined left #general #random "
+        "#lobby the and you for are not but can all out one was it is to of in on at ";
+
+#ifdef CHATTCP_HAVE_ZLIB
+    // One stream per thread, reset for every frame: frames are independent
+    struct Deflater
+    {
+        z_stream stream{};
+        bool ready = false;
+
+        Deflater()
+        {
+            ready = deflateInit2(&stream, DEFLATE_LEVEL, Z_DEFLATED, -15, 4, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+        ~Deflater()
+        {
+            if (ready)
+                deflateEnd(&stream);
+        }
+    };
+
+    struct Inflater
+    {
+        z_stream stream{};
+        bool ready = false;
+
+        Inflater()
+        {
+            ready = inflateInit2(&stream, -15) == Z_OK;
+        }
+        ~Inflater()
+        {
+            if (ready)
+                inflateEnd(&stream);
+        }
+    };
+#endif
+}
+
+bool Compression::available()
+{
+#ifdef CHATTCP_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string_view Compression::dictionary()
+{
+    return std::string_view(presetDictionary, sizeof(presetDictionary) - 1);
+}
+
+WireRef Compression::deflateFrame(const WireRef &frame)
+{
+#ifdef CHATTCP_HAVE_ZLIB
+    WireRef cached = frame->encodedForm();
+    if (cached)
+    {
+        return cached;
+    }
+
+    static thread_local Deflater deflater;
+    static thread_local std::vector<char> output;
+    if (!deflater.ready)
+    {
+        return WireRef();
+    }
+
+    z_stream &stream = deflater.stream;
+    deflateReset(&stream);
+    std::string_view dict = dictionary();
+    deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dict.data()), static_cast<uInt>(dict.size()));
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(frame->size())));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(frame->data()));
+    stream.avail_in = static_cast<uInt>(frame->size());
+    stream.next_out = reinterpret_cast<Bytef *>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        return WireRef();
+    }
+
+    size_t compressed = output.size() - stream.avail_out;
+    if (compressed + BinaryProtocol::LENGTH_SIZE + 1 >= frame->size())
+    {
+        // Would not save anything: the frame is sent as is, to every recipient
+        return frame->cacheEncodedForm(frame);
+    }
+
+    WireRef deflated = BinaryProtocol::encode(BinaryProtocol::Opcode::Deflated, {std::string_view(output.data(), compressed)});
+    if (!deflated)
+    {
+        return deflated;
+    }
+    return frame->cacheEncodedForm(std::move(deflated));
+#else
+    (void)frame;
+    return WireRef();
+#endif
+}
+
+bool Compression::inflateFrame(std::string_view body, std::string &out)
+{
+#ifdef CHATTCP_HAVE_ZLIB
+    static thread_local Inflater inflater;
+    if (!inflater.ready)
+    {
+        return false;
+    }
+
+    z_stream &stream = inflater.stream;
+    inflateReset(&stream);
+    std::string_view dict = dictionary();
+    inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dict.data()), static_cast<uInt>(dict.size()));
+
+    // Capped at the largest frame, so a small body cannot expand without limit
+    out.resize(BinaryProtocol::LENGTH_SIZE + BINARY_MAX_FRAME);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.data()));
+    stream.avail_in = static_cast<uInt>(body.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    if (inflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        return false;
+    }
+    out.resize(out.size() - stream.avail_out);
+    return true;
+#else
+    (void)body;
+    (void)out;
+    return false;
+#endif
+}
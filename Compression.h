@@ -0,0 +1,33 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <string_view>
+#include "WireBuffer.h"
+
+// Optional deflate for binary-protocol connections, negotiated by the
+// BinaryProtocol::FLAG_DEFLATE bit of the handshake. Each frame is compressed
+// on its own (raw deflate, preset dictionary) and wrapped in a Deflated
+// frame, so one compressed copy of a broadcast serves every recipient instead
+// of one per connection. Built only with CHATTCP_HAVE_ZLIB; without it the
+// server never grants the flag.
+namespace Compression
+{
+    bool available();
+
+    // Deflated frame carrying the given binary frame, made once and cached on
+    // it. The frame itself if deflating would not save bytes (cached too, so
+    // the next recipient does not try again); null if compression is
+    // unavailable.
+    WireRef deflateFrame(const WireRef &frame);
+
+    // Inflates a Deflated frame's body into a complete inner frame. False if
+    // it is corrupt or would exceed the largest frame allowed.
+    bool inflateFrame(std::string_view body, std::string &out);
+
+    // Preset dictionary both sides load before every frame: protocol words
+    // and common chat vocabulary, so even short lines find matches
+    std::string_view dictionary();
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "Connect.h"
+#include "BinaryProtocol.h"
+#include "Compression.h"
+#include <cstring>
 #include <iostream>
 
 Connect::Connect(std::shared_ptr<Client> clientObj, ChatServer *srv)
@@ -48,7 +51,54 @@ std::shared_ptr<Client> Connect::getClient() const
 
 bool Connect::performHandshake()
 {
-    // Future: Can add initial handshake protocol here
-    // For now, connection is ready for LOGIN command
+    if (client->getProtocol() != Client::Protocol::Negotiating)
+    {
+        return true;
+    }
+
+    // Text commands start with a printable character; binary clients open
+    // with BinaryProtocol::MAGIC, whose first byte is NUL
+    char preamble[BinaryProtocol::PREAMBLE_SIZE];
+    size_t received = client->peekReceived(preamble, sizeof(preamble));
+    if (received == 0)
+    {
+        return false;
+    }
+    if (preamble[0] != BinaryProtocol::MAGIC[0])
+    {
+        client->setProtocol(Client::Protocol::Text);
+        return true;
+    }
+    if (received < sizeof(preamble))
+    {
+        return false;
+    }
+
+    if (std::memcmp(preamble, BinaryProtocol::MAGIC, sizeof(BinaryProtocol::MAGIC)) != 0)
+    {
+        // Not our preamble: treat it as text, which answers with errors
+        client->setProtocol(Client::Protocol::Text);
+        return true;
+    }
+
+    client->discardReceived(sizeof(preamble));
+    client->setProtocol(Client::Protocol::Binary);
+
+    uint8_t versionByte = static_cast<unsigned char>(preamble[sizeof(BinaryProtocol::MAGIC)]);
+    if ((versionByte & BinaryProtocol::VERSION_MASK) != BINARY_PROTOCOL_VERSION)
+    {
+        client->sendMessage("ERR unsupported-version");
+        client->shutdownConnection();
+        return false;
+    }
+
+    // Grant compression only if this build has it; HELLO tells the client
+    uint8_t granted = 0;
+    if ((versionByte & BinaryProtocol::FLAG_DEFLATE) && Compression::available())
+    {
+        granted |= BinaryProtocol::FLAG_DEFLATE;
+    }
+    client->sendWire(BinaryProtocol::hello(granted));
+    client->setCompression(granted & BinaryProtocol::FLAG_DEFLATE); // After HELLO, which goes out uncompressed
     return true;
 }
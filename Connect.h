@@ -21,6 +21,9 @@ public:
     
     std::shared_ptr<Client> getClient() const; // Get the underlying client object
     
+    // Picks the client's protocol from its first bytes: the binary preamble
+    // (see BinaryProtocol.h) or anything else for text. Returns false while
+    // the preamble is still incomplete or the connection was refused.
     bool performHandshake();
 };
 
@@ -0,0 +1,86 @@
+#include "DMService.h"
+#include "ChatServer.h"
+
+DMService::DMService(ChatServer *srv)
+    : server(srv)
+{
+}
+
+DMService::Delivery DMService::send(std::string_view sender, std::string_view targetUsername, std::string_view message)
+{
+    if (targetUsername == sender)
+    {
+        return Delivery::NotFound; // Prevent sending DM to self
+    }
+
+    // Attempt to find the target client
+    auto targetClient = server->findClientByUsername(targetUsername);
+
+    if (targetClient)
+    {
+        return send(sender, targetClient, message) ? Delivery::Sent : Delivery::NotFound;
+    }
+
+    // Logged in on another node: it goes to that node only
+    Federation *federation = server->getFederation();
+    if (federation && federation->forwardDirectMessage(sender, targetUsername, message))
+    {
+        return Delivery::Sent;
+    }
+
+    // Offline: keep it for the recipient's next LOGIN
+    MailboxStore *mailboxes = server->getMailboxes();
+    if (!mailboxes || !MailboxStore::acceptsName(targetUsername))
+    {
+        return Delivery::NotFound; // Target user not found
+    }
+    if (!mailboxes->deposit(targetUsername, sender, message))
+    {
+        return Delivery::MailboxFull;
+    }
+    if (MessageLog *history = server->getHistory())
+    {
+        history->append(MessageLog::Kind::Direct, sender, targetUsername, message);
+    }
+
+    // A LOGIN that emptied the mailbox between the lookup and the deposit
+    // would otherwise leave this message there until the next one
+    targetClient = server->findClientByUsername(targetUsername);
+    if (targetClient)
+    {
+        server->deliverMailbox(targetClient);
+    }
+    return Delivery::Queued;
+}
+
+bool DMService::send(std::string_view sender, const std::shared_ptr<Client> &targetClient, std::string_view message)
+{
+    if (targetClient->hasUsername(sender))
+    {
+        return false; // Prevent sending DM to self
+    }
+
+    WireRef formattedMessage = WireBuffer::frame({"DM ", sender, " ", message});
+    if (!formattedMessage)
+    {
+        return false;
+    }
+    if (!server->deliverTo(targetClient, formattedMessage))
+    {
+        return false;
+    }
+
+    if (MessageLog *history = server->getHistory())
+    {
+        history->append(MessageLog::Kind::Direct, sender, targetClient->getUsername(), message);
+    }
+    return true;
+}
+
+void DMService::deliverFromPeer(std::string_view sender, std::string_view targetUsername, std::string_view message)
+{
+    if (auto targetClient = server->findClientByUsername(targetUsername))
+    {
+        send(sender, targetClient, message);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef DMSERVICE_H
+#define DMSERVICE_H
+
+#include <memory>
+#include <string_view>
+
+class ChatServer;
+class Client;
+
+// Direct message delivery. Like BroadcastService it holds only the server,
+// so one instance serves every thread and the sender is passed by name.
+class DMService
+{
+public:
+    explicit DMService(ChatServer *srv);
+
+    enum class Delivery
+    {
+        Sent,
+        Queued,      // Recipient offline; kept in their mailbox
+        MailboxFull, // Recipient offline and their mailbox cannot take it
+        NotFound     // No such user online (and no mailboxes), or the DM was to self
+    };
+
+    // By name; a user on a federated peer gets it through that node, and a
+    // user who is not logged in anywhere gets it on their next LOGIN when the
+    // server keeps mailboxes
+    Delivery send(std::string_view sender, std::string_view targetUsername, std::string_view message);
+    bool send(std::string_view sender, const std::shared_ptr<Client> &targetClient, std::string_view message);
+
+    // A DM a peer routed here; dropped if the target has just logged out
+    void deliverFromPeer(std::string_view sender, std::string_view targetUsername, std::string_view message);
+
+private:
+    ChatServer *server;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "FanoutPool.h"
+#include <algorithm>
+
+FanoutPool::FanoutPool(int threads)
+{
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back(&FanoutPool::work, this);
+    }
+}
+
+FanoutPool::~FanoutPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void FanoutPool::execute(Job &job)
+{
+    if (job.chunks > 1 && !workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(&job);
+        }
+        // The caller takes a chunk itself, so one worker fewer is enough
+        if (job.chunks - 1 >= workers.size())
+        {
+            wake.notify_all();
+        }
+        else
+        {
+            for (size_t i = 1; i < job.chunks; ++i)
+            {
+                wake.notify_one();
+            }
+        }
+    }
+
+    claim(job);
+
+    // Every chunk is claimed; wait for the workers still running theirs
+    std::unique_lock<std::mutex> lock(mutex);
+    auto queued = std::find(jobs.begin(), jobs.end(), &job);
+    if (queued != jobs.end())
+    {
+        jobs.erase(queued);
+    }
+    finished.wait(lock, [&job]
+                  { return job.helpers == 0; });
+}
+
+void FanoutPool::claim(Job &job)
+{
+    for (size_t chunk; (chunk = job.next.fetch_add(1, std::memory_order_relaxed)) < job.chunks;)
+    {
+        size_t begin = chunk * FANOUT_CHUNK;
+        job.invoke(job.context, begin, std::min(begin + FANOUT_CHUNK, job.count));
+    }
+}
+
+void FanoutPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this]
+                  { return stopping || !jobs.empty(); });
+        if (stopping)
+        {
+            return;
+        }
+
+        Job *job = jobs.front();
+        ++job->helpers;
+        lock.unlock();
+        claim(*job);
+        lock.lock();
+
+        // Nothing left to claim: later workers should move on to the next job
+        if (!jobs.empty() && jobs.front() == job)
+        {
+            jobs.pop_front();
+        }
+        if (--job->helpers == 0)
+        {
+            finished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef FANOUTPOOL_H
+#define FANOUTPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "serverDefaults.h"
+
+// Fork-join workers for fanning one broadcast out to a very large recipient
+// list. run() cuts [0, count) into FANOUT_CHUNK ranges; the workers and the
+// calling thread claim ranges until none are left, and run() returns only
+// once every range is done. A broadcast is therefore completely queued before
+// its sender's next one starts, so each recipient still gets one sender's
+// messages in the order they were sent.
+class FanoutPool
+{
+public:
+    explicit FanoutPool(int threads);
+    ~FanoutPool();
+
+    FanoutPool(const FanoutPool &) = delete;
+    FanoutPool &operator=(const FanoutPool &) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // Calls body(begin, end) for every chunk of [0, count), on any thread
+    template <typename Body>
+    void run(size_t count, Body &body)
+    {
+        Job job;
+        job.count = count;
+        job.chunks = (count + FANOUT_CHUNK - 1) / FANOUT_CHUNK;
+        job.context = &body;
+        job.invoke = [](void *context, size_t begin, size_t end)
+        { (*static_cast<Body *>(context))(begin, end); };
+        execute(job);
+    }
+
+private:
+    // Lives on the caller's stack; no std::function, so run() does not allocate
+    struct Job
+    {
+        size_t count;
+        size_t chunks;
+        void *context;
+        void (*invoke)(void *context, size_t begin, size_t end);
+        std::atomic<size_t> next{0}; // Next chunk to claim
+        int helpers = 0;             // Workers inside claim(); guarded by mutex
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;     // Workers: a job was posted, or stopping
+    std::condition_variable finished; // Callers: a worker left a job
+    std::deque<Job *> jobs;           // Jobs with chunks left to claim
+    bool stopping = false;
+
+    void execute(Job &job);
+    static void claim(Job &job);
+    void work();
+};
+
+#endif
@@ -0,0 +1,973 @@
+#include "Federation.h"
+#include "ChatServer.h"
+#include "BinaryProtocol.h"
+#include "CommandTable.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+
+namespace
+{
+    // Free text ends a frame; one space separates it from the fields before it
+    std::string_view restOf(std::string_view rest)
+    {
+        if (!rest.empty() && rest.front() == ' ')
+        {
+            rest.remove_prefix(1);
+        }
+        return rest;
+    }
+
+    std::string defaultNodeId(int peerPort)
+    {
+        char host[256] = {};
+        if (gethostname(host, sizeof(host) - 1) != 0 || host[0] == '\0')
+        {
+            return "node:" + std::to_string(peerPort);
+        }
+        return std::string(host) + ":" + std::to_string(peerPort);
+    }
+}
+
+Federation::Federation(ChatServer *srv, UserRegistry &localUsers, std::string id, std::string bind, int port,
+                       const std::vector<std::string> &peers)
+    : server(srv), local(localUsers), nodeId(id.empty() ? defaultNodeId(port) : std::move(id)),
+      bindAddress(std::move(bind)), peerPort(port), listener(INVALID_SOCKET), running(false)
+{
+    for (const std::string &peer : peers)
+    {
+        size_t colon = peer.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == peer.size())
+        {
+            Log::warn("Federation: ignoring peer \"", peer, "\" (use host:port)");
+            continue;
+        }
+        auto link = std::make_unique<Outbound>();
+        link->host = peer.substr(0, colon);
+        link->port = peer.substr(colon + 1);
+        outbound.push_back(std::move(link));
+    }
+}
+
+Federation::~Federation()
+{
+    stop();
+}
+
+const std::string &Federation::getNodeId() const
+{
+    return nodeId;
+}
+
+bool Federation::start()
+{
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(peerPort));
+    if (inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1)
+    {
+        Log::error("Federation: bad peer bind address ", bindAddress, " (use an IPv4 address)");
+        return false;
+    }
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+    {
+        Log::error("Federation: socket creation failed");
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&opt), sizeof(opt));
+
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(listener, SOMAXCONN) == SOCKET_ERROR)
+    {
+        Log::error("Federation: cannot listen on ", bindAddress, ":", peerPort, ": ", lastSocketError());
+        closesocket(listener);
+        listener = INVALID_SOCKET;
+        return false;
+    }
+
+    running = true;
+    acceptThread = std::thread(&Federation::acceptLinks, this);
+    for (auto &link : outbound)
+    {
+        link->thread = std::thread(&Federation::runOutbound, this, link.get());
+    }
+    Log::info("Federation: node ", nodeId, " on ", bindAddress, ":", peerPort, ", ", outbound.size(), " peer(s)");
+    return true;
+}
+
+void Federation::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+
+    for (auto &link : outbound)
+    {
+        {
+            std::lock_guard<std::mutex> lock(link->mutex);
+        }
+        link->ready.notify_all();
+    }
+
+    if (acceptThread.joinable())
+    {
+        acceptThread.join();
+    }
+    for (auto &link : outbound)
+    {
+        if (link->thread.joinable())
+        {
+            link->thread.join();
+        }
+    }
+
+    // Readers wake every PEER_POLL_MS and see running cleared
+    std::vector<std::unique_ptr<Inbound>> readers;
+    {
+        std::lock_guard<std::mutex> lock(inboundMutex);
+        readers.swap(inbound);
+    }
+    for (auto &link : readers)
+    {
+        if (link->thread.joinable())
+        {
+            link->thread.join();
+        }
+    }
+
+    closesocket(listener);
+    listener = INVALID_SOCKET;
+
+    // No answer can arrive any more
+    grantPendingClaims();
+}
+
+void Federation::claim(const std::string &username, ClaimDone done)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (directory.count(NameKey::view(username)))
+    {
+        lock.unlock();
+        done(false);
+        return;
+    }
+
+    // Only peers linked both ways can answer
+    uint64_t seq = nextClaim++;
+    PendingClaim pending;
+    std::string body = "CLAIM " + std::to_string(seq) + " " + username;
+    for (auto &link : outbound)
+    {
+        std::lock_guard<std::mutex> linkLock(link->mutex);
+        if (link->up && linkedFrom.count(link->nodeId) && pending.waiting.insert(link->nodeId).second)
+        {
+            enqueueLocked(*link, body);
+        }
+    }
+    if (pending.waiting.empty())
+    {
+        lock.unlock();
+        done(true);
+        return;
+    }
+
+    // Settled by the answers, or by the accept thread once overdue
+    pending.username = username;
+    pending.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(PEER_CLAIM_TIMEOUT_MS);
+    pending.done = std::move(done);
+    claims.emplace(seq, std::move(pending));
+}
+
+void Federation::grantPendingClaims()
+{
+    Settled settled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        settleClaims(settled, true);
+    }
+    reportClaims(settled);
+}
+
+void Federation::settleClaims(Settled &settled, bool all)
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = claims.begin(); it != claims.end();)
+    {
+        PendingClaim &pending = it->second;
+        if (pending.denied)
+        {
+            // Peers that granted it have it in their directory
+            enqueueAll("RELEASE " + pending.username);
+            settled.emplace_back(std::move(pending.done), false);
+        }
+        else if (pending.waiting.empty() || all || now >= pending.deadline)
+        {
+            if (!pending.waiting.empty())
+            {
+                Log::limited(Log::Level::Warn, "peer-claim-timeout", "Federation: ", pending.waiting.size(),
+                             " peer(s) did not answer the claim for ", pending.username);
+            }
+            settled.emplace_back(std::move(pending.done), true);
+        }
+        else
+        {
+            ++it;
+            continue;
+        }
+        it = claims.erase(it);
+    }
+}
+
+void Federation::reportClaims(Settled &settled)
+{
+    for (auto &claim : settled)
+    {
+        claim.first(claim.second);
+    }
+    settled.clear();
+}
+
+void Federation::release(const std::string &username)
+{
+    // Under the lock, so a link coming up lists the name or sees the release, never neither
+    std::lock_guard<std::mutex> lock(mutex);
+    enqueueAll("RELEASE " + username);
+}
+
+bool Federation::isRemoteUser(std::string_view username)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return directory.count(NameKey::view(username)) != 0;
+}
+
+std::vector<std::string> Federation::remoteUsers()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> names;
+    names.reserve(directory.size());
+    for (auto &entry : directory)
+    {
+        names.push_back(entry.first.str());
+    }
+    return names;
+}
+
+size_t Federation::linkedPeers()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t linked = 0;
+    for (auto &link : outbound)
+    {
+        std::lock_guard<std::mutex> linkLock(link->mutex);
+        if (link->up && linkedFrom.count(link->nodeId))
+        {
+            ++linked;
+        }
+    }
+    return linked;
+}
+
+uint64_t Federation::remoteUserId(std::string_view username)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!directory.count(NameKey::view(username)))
+    {
+        return 0;
+    }
+    auto it = remoteIds.find(NameKey::view(username));
+    if (it != remoteIds.end())
+    {
+        return it->second;
+    }
+    uint64_t id = REMOTE_USER_ID_BIT | nextRemoteId++;
+    remoteIds.emplace(std::string(username), id);
+    remoteNames.emplace(id, std::string(username));
+    return id;
+}
+
+bool Federation::remoteUserName(uint64_t id, std::string &username)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = remoteNames.find(id);
+    if (it == remoteNames.end())
+    {
+        return false;
+    }
+    username = it->second;
+    return true;
+}
+
+void Federation::forwardChat(std::string_view room, std::string_view sender, std::string_view message)
+{
+    std::string body;
+    body.reserve(6 + room.size() + sender.size() + message.size());
+    body.append("MSG ").append(room).append(" ").append(sender).append(" ").append(message);
+    enqueueAll(body);
+}
+
+void Federation::forwardInfo(std::string_view room, std::string_view user, std::string_view event,
+                             std::string_view subject)
+{
+    std::string body;
+    body.append("INFO ").append(room).append(" ").append(user).append(" ").append(event);
+    if (!subject.empty())
+    {
+        body.append(" ").append(subject);
+    }
+    enqueueAll(body);
+}
+
+void Federation::forwardDeparture(std::string_view user, std::string_view event,
+                                  const std::vector<std::shared_ptr<Room>> &rooms)
+{
+    std::string body;
+    body.append("DEPART ").append(user).append(" ").append(std::to_string(rooms.size()));
+    for (auto &room : rooms)
+    {
+        body.append(" ").append(room->getName());
+    }
+    body.append(" ").append(event);
+    enqueueAll(body);
+}
+
+bool Federation::forwardDirectMessage(std::string_view sender, std::string_view target, std::string_view message)
+{
+    std::string owner;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = directory.find(NameKey::view(target));
+        if (it == directory.end())
+        {
+            return false;
+        }
+        owner = it->second;
+    }
+
+    std::string body;
+    body.append("DM ").append(sender).append(" ").append(target).append(" ").append(message);
+    return sendToNode(owner, body);
+}
+
+void Federation::acceptLinks()
+{
+    Settled settled;
+    while (running)
+    {
+        reapInbound();
+
+        // Claims whose peers went away or never answered
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            settleClaims(settled);
+        }
+        reportClaims(settled);
+
+        pollfd pfd{listener, POLLIN, 0};
+        if (pollSockets(&pfd, 1, PEER_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        sockaddr_in from{};
+        socklen_t fromSize = sizeof(from);
+        SOCKET connection = accept(listener, reinterpret_cast<sockaddr *>(&from), &fromSize);
+        if (connection == INVALID_SOCKET)
+        {
+            continue;
+        }
+        char fromIP[INET_ADDRSTRLEN] = "unknown";
+        inet_ntop(AF_INET, &from.sin_addr, fromIP, INET_ADDRSTRLEN);
+        if (!isPeerAddress(from.sin_addr))
+        {
+            Log::limited(Log::Level::Warn, "peer-refused", "Federation: refusing a link from ", fromIP,
+                         ", which is not a --peer host");
+            closesocket(connection);
+            continue;
+        }
+        setNonBlocking(connection);
+        int nodelay = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&nodelay), sizeof(nodelay));
+
+        auto link = std::make_unique<Inbound>();
+        link->socket = connection;
+        link->address = fromIP;
+        link->thread = std::thread(&Federation::runInbound, this, link.get());
+        std::lock_guard<std::mutex> lock(inboundMutex);
+        inbound.push_back(std::move(link));
+    }
+}
+
+bool Federation::isPeerAddress(const in_addr &address) const
+{
+    // Resolved on every accept, so a peer whose address changes can still link
+    for (auto &link : outbound)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *found = nullptr;
+        if (getaddrinfo(link->host.c_str(), nullptr, &hints, &found) != 0)
+        {
+            continue;
+        }
+        bool match = false;
+        for (addrinfo *entry = found; entry && !match; entry = entry->ai_next)
+        {
+            match = reinterpret_cast<const sockaddr_in *>(entry->ai_addr)->sin_addr.s_addr == address.s_addr;
+        }
+        freeaddrinfo(found);
+        if (match)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Federation::reapInbound()
+{
+    std::vector<std::unique_ptr<Inbound>> finished;
+    {
+        std::lock_guard<std::mutex> lock(inboundMutex);
+        auto done = std::stable_partition(inbound.begin(), inbound.end(), [](const std::unique_ptr<Inbound> &link)
+                                          { return !link->finished; });
+        std::move(done, inbound.end(), std::back_inserter(finished));
+        inbound.erase(done, inbound.end());
+    }
+    for (auto &link : finished)
+    {
+        link->thread.join();
+    }
+}
+
+void Federation::runInbound(Inbound *link)
+{
+    // The dialer introduces itself and waits for our answer before sending anything else
+    std::string hello;
+    if (readFrame(link->socket, hello, PEER_HANDSHAKE_MS))
+    {
+        std::string_view rest = hello;
+        if (CommandText::nextToken(rest) == "HELLO")
+        {
+            link->nodeId = std::string(CommandText::nextToken(rest));
+        }
+    }
+    std::string holder; // Another host linked under the same id
+    if (!link->nodeId.empty())
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = linkedFrom.find(link->nodeId);
+        if (it != linkedFrom.end() && it->second->address != link->address)
+        {
+            holder = it->second->address;
+        }
+    }
+    if (!holder.empty())
+    {
+        // Taking it as a reconnect would wipe the real node's users
+        Log::limited(Log::Level::Warn, "peer-duplicate-id", "Federation: refusing ", link->address, " as ",
+                     link->nodeId, ", already linked from ", holder);
+    }
+    if (link->nodeId.empty() || link->nodeId == nodeId || !holder.empty() ||
+        !writeAll(link->socket, encode("HELLO " + nodeId)))
+    {
+        closesocket(link->socket); // The dialer reports a link to itself
+        link->finished = true;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (linkedFrom.count(link->nodeId))
+        {
+            dropNode(link->nodeId); // Reconnected, perhaps restarted: it will list its users again
+        }
+        linkedFrom[link->nodeId] = link;
+    }
+    Log::info("Federation: linked from ", link->nodeId, " (", link->address, ")");
+
+    // Frames are applied in arrival order on this thread
+    std::string buffer;
+    size_t parsed = 0;
+    char chunk[RECV_BUFFER_SIZE];
+    bool open = true;
+    while (running && open)
+    {
+        pollfd pfd{link->socket, POLLIN, 0};
+        int ready = pollSockets(&pfd, 1, PEER_POLL_MS);
+        if (ready == 0)
+        {
+            continue;
+        }
+
+        int received = ready > 0 ? recv(link->socket, chunk, sizeof(chunk), 0) : -1;
+        if (received > 0)
+        {
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+        else if (received == 0 || !socketWouldBlock())
+        {
+            break;
+        }
+
+        while (buffer.size() - parsed >= BinaryProtocol::LENGTH_SIZE)
+        {
+            uint32_t length = BinaryProtocol::getU32(buffer.data() + parsed);
+            if (length == 0 || length > PEER_MAX_FRAME)
+            {
+                Log::warn("Federation: bad frame from ", link->nodeId, ", dropping the link");
+                open = false;
+                break;
+            }
+            if (buffer.size() - parsed < BinaryProtocol::LENGTH_SIZE + length)
+            {
+                break;
+            }
+            applyFrame(link->nodeId, std::string_view(buffer).substr(parsed + BinaryProtocol::LENGTH_SIZE, length));
+            parsed += BinaryProtocol::LENGTH_SIZE + length;
+        }
+        buffer.erase(0, parsed);
+        parsed = 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = linkedFrom.find(link->nodeId);
+        if (it != linkedFrom.end() && it->second == link)
+        {
+            linkedFrom.erase(it);
+            dropNode(link->nodeId);
+        }
+    }
+    if (running)
+    {
+        Log::info("Federation: link from ", link->nodeId, " closed");
+    }
+    closesocket(link->socket);
+    link->finished = true;
+}
+
+void Federation::dropNode(const std::string &node)
+{
+    for (auto it = directory.begin(); it != directory.end();)
+    {
+        it = it->second == node ? forget(it) : std::next(it);
+    }
+    for (auto &entry : claims)
+    {
+        entry.second.waiting.erase(node); // Settled by the accept thread
+    }
+}
+
+Federation::Directory::iterator Federation::forget(Directory::iterator user)
+{
+    auto id = remoteIds.find(NameKey::view(user->first.get()));
+    if (id != remoteIds.end())
+    {
+        remoteNames.erase(id->second);
+        remoteIds.erase(id);
+    }
+    return directory.erase(user);
+}
+
+void Federation::runOutbound(Outbound *link)
+{
+    std::string peer = link->host + ":" + link->port;
+    bool warned = false;
+    while (running)
+    {
+        SOCKET socket = dial(*link);
+        std::string peerId;
+        if (socket != INVALID_SOCKET && handshake(socket, peerId))
+        {
+            warned = false;
+            linkUp(link, socket, peerId);
+            Log::info("Federation: linked to ", peerId, " (", peer, ")");
+            pump(link, socket);
+            linkDown(link);
+            if (running)
+            {
+                Log::info("Federation: link to ", peerId, " lost");
+            }
+        }
+        else
+        {
+            if (socket != INVALID_SOCKET)
+            {
+                closesocket(socket);
+            }
+            if (!warned)
+            {
+                Log::warn("Federation: cannot reach ", peer, ", retrying every ", PEER_RETRY_MS, " ms");
+                warned = true;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(link->mutex);
+        link->ready.wait_for(lock, std::chrono::milliseconds(PEER_RETRY_MS), [this]()
+                             { return !running; });
+    }
+}
+
+void Federation::pump(Outbound *link, SOCKET socket)
+{
+    std::unique_lock<std::mutex> lock(link->mutex);
+    while (running)
+    {
+        if (link->pending.empty())
+        {
+            link->ready.wait_for(lock, std::chrono::milliseconds(PEER_POLL_MS));
+            if (link->pending.empty())
+            {
+                // Nothing comes back on this link, so readable means the peer closed it
+                lock.unlock();
+                pollfd pfd{socket, POLLIN, 0};
+                bool closed = pollSockets(&pfd, 1, 0) != 0;
+                lock.lock();
+                if (closed)
+                {
+                    return;
+                }
+                continue;
+            }
+        }
+
+        std::string batch;
+        batch.swap(link->pending);
+        lock.unlock();
+        bool written = writeAll(socket, batch);
+        lock.lock();
+        if (!written)
+        {
+            return;
+        }
+    }
+}
+
+void Federation::linkUp(Outbound *link, SOCKET socket, const std::string &peerId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<std::mutex> linkLock(link->mutex);
+    link->socket = socket;
+    link->nodeId = peerId;
+    link->pending.clear();
+    link->up = true;
+
+    // Claims and releases are queued under the same lock, so none is missed
+    // or overtaken by this list
+    for (const std::string &username : local.names())
+    {
+        enqueueLocked(*link, "USER " + username);
+    }
+}
+
+void Federation::linkDown(Outbound *link)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<std::mutex> linkLock(link->mutex);
+    link->up = false;
+    link->pending.clear();
+    closesocket(link->socket);
+    link->socket = INVALID_SOCKET;
+
+    // It cannot answer claims now; the accept thread settles them
+    for (auto &entry : claims)
+    {
+        entry.second.waiting.erase(link->nodeId);
+    }
+}
+
+std::string Federation::encode(std::string_view body)
+{
+    std::string frame(BinaryProtocol::LENGTH_SIZE, '\0');
+    BinaryProtocol::putU32(&frame[0], static_cast<uint32_t>(body.size()));
+    frame.append(body);
+    return frame;
+}
+
+bool Federation::enqueueLocked(Outbound &link, std::string_view body)
+{
+    if (!link.up || body.size() > PEER_MAX_FRAME)
+    {
+        return false;
+    }
+    if (link.pending.size() + body.size() > PEER_QUEUE_LIMIT)
+    {
+        Log::limited(Log::Level::Warn, "peer-backlog", "Federation: link to ", link.nodeId,
+                     " is backed up, dropping frames");
+        return false;
+    }
+
+    bool wasEmpty = link.pending.empty();
+    char header[BinaryProtocol::LENGTH_SIZE];
+    BinaryProtocol::putU32(header, static_cast<uint32_t>(body.size()));
+    link.pending.append(header, sizeof(header)).append(body);
+    if (wasEmpty)
+    {
+        link.ready.notify_one();
+    }
+    return true;
+}
+
+void Federation::enqueueAll(std::string_view body)
+{
+    for (auto &link : outbound)
+    {
+        std::lock_guard<std::mutex> lock(link->mutex);
+        enqueueLocked(*link, body);
+    }
+}
+
+bool Federation::sendToNode(const std::string &node, std::string_view body)
+{
+    for (auto &link : outbound)
+    {
+        std::lock_guard<std::mutex> lock(link->mutex);
+        if (link->up && link->nodeId == node)
+        {
+            return enqueueLocked(*link, body);
+        }
+    }
+    return false;
+}
+
+void Federation::applyFrame(const std::string &from, std::string_view body)
+{
+    std::string_view rest = body;
+    std::string_view type = CommandText::nextToken(rest);
+
+    if (type == "MSG")
+    {
+        std::string_view room = CommandText::nextToken(rest);
+        std::string_view sender = CommandText::nextToken(rest);
+        server->getBroadcasts().chatFromPeer(room, sender, restOf(rest));
+    }
+    else if (type == "INFO")
+    {
+        std::string_view room = CommandText::nextToken(rest);
+        std::string_view user = CommandText::nextToken(rest);
+        std::string_view event = CommandText::nextToken(rest);
+        server->getBroadcasts().infoFromPeer(room, user, event, restOf(rest));
+    }
+    else if (type == "DEPART")
+    {
+        std::string_view user = CommandText::nextToken(rest);
+        std::string_view count = CommandText::nextToken(rest);
+        std::vector<std::string_view> rooms;
+        for (size_t n = std::strtoul(std::string(count).c_str(), nullptr, 10); n > 0 && !rest.empty(); --n)
+        {
+            rooms.push_back(CommandText::nextToken(rest));
+        }
+        server->getBroadcasts().departureFromPeer(user, restOf(rest), rooms);
+    }
+    else if (type == "DM")
+    {
+        std::string_view sender = CommandText::nextToken(rest);
+        std::string_view target = CommandText::nextToken(rest);
+        server->getDirectMessages().deliverFromPeer(sender, target, restOf(rest));
+    }
+    else if (type == "CLAIM")
+    {
+        std::string_view seq = CommandText::nextToken(rest);
+        std::string username(CommandText::nextToken(rest));
+        bool taken;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = directory.find(NameKey::view(username));
+            taken = local.contains(username) || (it != directory.end() && it->second != from);
+            if (!taken)
+            {
+                directory[username] = from;
+            }
+        }
+        sendToNode(from, std::string(taken ? "DENY " : "GRANT ").append(seq));
+    }
+    else if (type == "GRANT" || type == "DENY")
+    {
+        uint64_t seq = std::strtoull(std::string(CommandText::nextToken(rest)).c_str(), nullptr, 10);
+        Settled settled;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = claims.find(seq);
+            if (it != claims.end())
+            {
+                it->second.waiting.erase(from);
+                it->second.denied = it->second.denied || type == "DENY";
+                settleClaims(settled);
+            }
+        }
+        reportClaims(settled);
+    }
+    else if (type == "USER")
+    {
+        std::string username(CommandText::nextToken(rest));
+        if (local.contains(username))
+        {
+            Log::warn("Federation: ", username, " is logged in here and on ", from);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        directory[username] = from;
+    }
+    else if (type == "RELEASE")
+    {
+        std::string username(CommandText::nextToken(rest));
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = directory.find(NameKey::view(username));
+        if (it != directory.end() && it->second == from)
+        {
+            forget(it);
+        }
+    }
+    else
+    {
+        Log::limited(Log::Level::Warn, "peer-frame", "Federation: unknown frame from ", from);
+    }
+}
+
+SOCKET Federation::dial(const Outbound &link)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(link.host.c_str(), link.port.c_str(), &hints, &found) != 0 || !found)
+    {
+        return INVALID_SOCKET;
+    }
+
+    SOCKET connection = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+    bool connected = false;
+    if (connection != INVALID_SOCKET && setNonBlocking(connection))
+    {
+        // Non-blocking, so an unreachable peer cannot hold up stop()
+        if (connect(connection, found->ai_addr, static_cast<int>(found->ai_addrlen)) == 0)
+        {
+            connected = true;
+        }
+        else if (socketWouldBlock() || lastSocketError() == EINPROGRESS)
+        {
+            pollfd pfd{connection, POLLOUT, 0};
+            int error = 0;
+            socklen_t length = sizeof(error);
+            connected = pollSockets(&pfd, 1, PEER_HANDSHAKE_MS) > 0 &&
+                        getsockopt(connection, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &length) == 0 &&
+                        error == 0;
+        }
+    }
+    freeaddrinfo(found);
+
+    if (!connected)
+    {
+        if (connection != INVALID_SOCKET)
+        {
+            closesocket(connection);
+        }
+        return INVALID_SOCKET;
+    }
+    int nodelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&nodelay), sizeof(nodelay));
+    return connection;
+}
+
+bool Federation::handshake(SOCKET socket, std::string &peerId)
+{
+    std::string hello;
+    if (!writeAll(socket, encode("HELLO " + nodeId)) || !readFrame(socket, hello, PEER_HANDSHAKE_MS))
+    {
+        return false;
+    }
+    std::string_view rest = hello;
+    if (CommandText::nextToken(rest) != "HELLO")
+    {
+        return false;
+    }
+    peerId = std::string(CommandText::nextToken(rest));
+    if (peerId.empty() || peerId == nodeId)
+    {
+        if (peerId == nodeId)
+        {
+            Log::warn("Federation: a --peer address points at this node");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool Federation::readFrame(SOCKET socket, std::string &frame, int timeoutMs)
+{
+    // Reads exactly one frame and nothing past it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    auto readExact = [&](char *out, size_t length)
+    {
+        size_t done = 0;
+        while (done < length)
+        {
+            int left = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            deadline - std::chrono::steady_clock::now())
+                                            .count());
+            pollfd pfd{socket, POLLIN, 0};
+            if (left <= 0 || pollSockets(&pfd, 1, left) <= 0)
+            {
+                return false;
+            }
+            int received = recv(socket, out + done, static_cast<int>(length - done), 0);
+            if (received > 0)
+            {
+                done += static_cast<size_t>(received);
+            }
+            else if (received == 0 || !socketWouldBlock())
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    char header[BinaryProtocol::LENGTH_SIZE];
+    if (!readExact(header, sizeof(header)))
+    {
+        return false;
+    }
+    uint32_t length = BinaryProtocol::getU32(header);
+    if (length == 0 || length > PEER_MAX_FRAME)
+    {
+        return false;
+    }
+    frame.resize(length);
+    return readExact(&frame[0], length);
+}
+
+bool Federation::writeAll(SOCKET socket, std::string_view data)
+{
+    while (!data.empty())
+    {
+        int sent = send(socket, data.data(), static_cast<int>(data.size()), MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            data.remove_prefix(static_cast<size_t>(sent));
+            continue;
+        }
+        if (sent < 0 && socketWouldBlock())
+        {
+            // Waits for room in PEER_POLL_MS steps, giving up if the server stops
+            pollfd pfd{socket, POLLOUT, 0};
+            while (running && pollSockets(&pfd, 1, PEER_POLL_MS) == 0)
+            {
+            }
+            if (running)
+            {
+                continue;
+            }
+        }
+        return false;
+    }
+    return true;
+}
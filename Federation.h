@@ -0,0 +1,176 @@
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "socketCompat.h"
+#include "serverDefaults.h"
+#include "UserRegistry.h"
+#include "NameKey.h"
+
+class ChatServer;
+class Room;
+
+// Links this server ("node") to other ChatServer processes over TCP so they
+// act as one chat network.
+//
+// Every node listens on its peer port and dials every address given with
+// --peer. The peer port binds to loopback unless told otherwise and only
+// takes links from the hosts listed with --peer; frames are not
+// authenticated beyond that. Each link carries frames one way, from the node that dialed it,
+// so a pair of nodes is joined by two links; list every other node on each
+// one. Frames are a u32 big-endian length and a text body: "MSG <room>
+// <sender> <text>", "CLAIM <seq> <name>", ...
+//
+// Usernames: each node keeps a directory of the names logged in elsewhere.
+// A LOGIN is claimed locally first and then from every linked peer; a peer
+// that holds the name, or has granted it to another node, denies it. When
+// two nodes claim the same name at once both are denied, so a name is never
+// held twice while the peers are reachable. A peer that does not answer
+// within PEER_CLAIM_TIMEOUT_MS is not waited for. Nothing blocks on a claim:
+// its outcome is reported through a callback.
+//
+// Broadcasts go once to each peer, which delivers them to its own members of
+// the room. DMs go only to the node holding the recipient.
+class Federation
+{
+public:
+    // An empty nodeId defaults to "<hostname>:<peerPort>"; it must be unique in the cluster
+    Federation(ChatServer *srv, UserRegistry &localUsers, std::string nodeId, std::string bindAddress, int peerPort,
+               const std::vector<std::string> &peers);
+    ~Federation();
+
+    Federation(const Federation &) = delete;
+    Federation &operator=(const Federation &) = delete;
+
+    bool start(); // Listens on bindAddress:peerPort and starts dialing the peers
+    void stop();
+
+    const std::string &getNodeId() const;
+
+    // Called after the name was claimed locally. done(granted) runs once,
+    // never under the federation's locks: right here when no peer has to be
+    // asked, otherwise on the link thread bringing the last GRANT or a DENY,
+    // or on the accept thread once the claim times out (granted). granted is
+    // false if a peer holds the name.
+    typedef std::function<void(bool)> ClaimDone;
+    void claim(const std::string &username, ClaimDone done);
+    void grantPendingClaims(); // Shutting down or handing over: settles every open claim now
+    void release(const std::string &username); // After a local logout
+    bool isRemoteUser(std::string_view username);
+    std::vector<std::string> remoteUsers();
+    size_t linkedPeers(); // Linked both ways
+
+    // Binary clients address users by id. A remote user gets one here, with
+    // REMOTE_USER_ID_BIT set so it never matches a local connection id, and
+    // keeps it while this node knows the user. 0 if the user is not known.
+    uint64_t remoteUserId(std::string_view username);
+    bool remoteUserName(uint64_t id, std::string &username);
+
+    // Hand the message to every peer; each delivers it to its members
+    void forwardChat(std::string_view room, std::string_view sender, std::string_view message);
+    void forwardInfo(std::string_view room, std::string_view user, std::string_view event, std::string_view subject);
+    void forwardDeparture(std::string_view user, std::string_view event, const std::vector<std::shared_ptr<Room>> &rooms);
+
+    // Sends the DM to the node holding the target; false if no peer does or
+    // the link to it is down or backed up
+    bool forwardDirectMessage(std::string_view sender, std::string_view target, std::string_view message);
+
+private:
+    // A link this node dialed; frames for the peer are queued here
+    struct Outbound
+    {
+        std::string host;
+        std::string port;
+        std::mutex mutex; // Guards everything below
+        std::condition_variable ready;
+        SOCKET socket = INVALID_SOCKET;
+        bool up = false;
+        std::string nodeId; // The peer's, learned in the handshake
+        std::string pending; // Encoded frames not yet written
+        std::thread thread;
+    };
+
+    // A link a peer dialed; its frames are read and applied here
+    struct Inbound
+    {
+        SOCKET socket = INVALID_SOCKET;
+        std::string address; // The peer's IP, dotted
+        std::string nodeId;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    struct PendingClaim
+    {
+        std::string username;
+        std::unordered_set<std::string> waiting; // Peers yet to answer
+        bool denied = false;
+        std::chrono::steady_clock::time_point deadline;
+        ClaimDone done;
+    };
+
+    // Decided claims taken out under the lock, reported after it is released
+    typedef std::vector<std::pair<ClaimDone, bool>> Settled;
+
+    ChatServer *server;
+    UserRegistry &local; // This node's logged-in users
+    std::string nodeId;
+    std::string bindAddress;
+    int peerPort;
+    SOCKET listener;
+    std::atomic<bool> running;
+    std::thread acceptThread;
+    std::vector<std::unique_ptr<Outbound>> outbound; // Fixed once started
+    std::vector<std::unique_ptr<Inbound>> inbound;   // Guarded by inboundMutex
+    std::mutex inboundMutex;
+
+    // Lock order: mutex, then an Outbound's mutex
+    std::mutex mutex;
+    using Directory = std::unordered_map<NameKey, std::string, NameKey::Hash>;
+    Directory directory;                                            // Remote username -> node
+    std::unordered_map<NameKey, uint64_t, NameKey::Hash> remoteIds; // Handed out by remoteUserId
+    std::unordered_map<uint64_t, std::string> remoteNames;
+    uint64_t nextRemoteId = 1;
+    std::unordered_map<std::string, Inbound *> linkedFrom;   // Node -> its current inbound link
+    std::unordered_map<uint64_t, PendingClaim> claims;
+    uint64_t nextClaim = 1;
+
+    void acceptLinks();
+    bool isPeerAddress(const in_addr &address) const; // One of the --peer hosts
+    void reapInbound();
+    void runInbound(Inbound *link);
+    void dropNode(const std::string &node); // mutex held; forgets its users and claims
+    Directory::iterator forget(Directory::iterator user); // mutex held; erases a directory entry and its id
+    void settleClaims(Settled &settled, bool all = false); // mutex held; all: stopping, grant what is left
+    static void reportClaims(Settled &settled);            // mutex not held
+
+    void runOutbound(Outbound *link);
+    bool handshake(SOCKET socket, std::string &peerId);
+    void linkUp(Outbound *link, SOCKET socket, const std::string &peerId);
+    void pump(Outbound *link, SOCKET socket); // Writes queued frames until the link fails
+    void linkDown(Outbound *link);
+
+    static std::string encode(std::string_view body);
+    bool enqueueLocked(Outbound &link, std::string_view body); // Link mutex held; false (dropped) if down or backed up
+    void enqueueAll(std::string_view body);
+    bool sendToNode(const std::string &node, std::string_view body); // False if no link to it is up
+    void applyFrame(const std::string &from, std::string_view body);
+
+    SOCKET dial(const Outbound &link);
+    bool readFrame(SOCKET socket, std::string &frame, int timeoutMs); // One frame, blocking up to timeoutMs
+    bool writeAll(SOCKET socket, std::string_view data);
+};
+
+#endif
@@ -0,0 +1,567 @@
+#include "HotRestart.h"
+#include "Logger.h"
+
+#ifdef __linux__
+
+#include "BinaryProtocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // Message tags: the new process opens with 'H', HANDOFF_MAGIC and the u32
+    // format version; 'F' carries a batch of descriptors, 'S' is followed by
+    // the u32 length and the records, and the new process answers 'K'
+    const char TAG_HELLO = 'H';
+    const char TAG_DESCRIPTORS = 'F';
+    const char TAG_STATE = 'S';
+    const char TAG_ACK = 'K';
+
+    const char HANDOFF_MAGIC[] = {'C', 'H', 'A', 'T', 'H', 'O', 'F', 'F'};
+    const uint32_t HANDOFF_VERSION = 1; // Bump whenever encode() changes
+
+    const uint8_t FLAG_AUTHENTICATED = 1;
+    const uint8_t FLAG_COMPRESSION = 2;
+
+    void putU32(std::string &out, uint32_t value)
+    {
+        char bytes[BinaryProtocol::LENGTH_SIZE];
+        BinaryProtocol::putU32(bytes, value);
+        out.append(bytes, sizeof(bytes));
+    }
+
+    void putU64(std::string &out, uint64_t value)
+    {
+        char bytes[8];
+        BinaryProtocol::putU64(bytes, value);
+        out.append(bytes, sizeof(bytes));
+    }
+
+    void putString(std::string &out, std::string_view value)
+    {
+        putU32(out, static_cast<uint32_t>(value.size()));
+        out.append(value.data(), value.size());
+    }
+
+    // Reads the fields back in order; every read fails once the data runs out
+    struct Reader
+    {
+        std::string_view data;
+        bool ok = true;
+
+        uint8_t u8()
+        {
+            if (!ok || data.empty())
+            {
+                ok = false;
+                return 0;
+            }
+            uint8_t value = static_cast<uint8_t>(data[0]);
+            data.remove_prefix(1);
+            return value;
+        }
+
+        uint32_t u32()
+        {
+            if (!ok || data.size() < BinaryProtocol::LENGTH_SIZE)
+            {
+                ok = false;
+                return 0;
+            }
+            uint32_t value = BinaryProtocol::getU32(data.data());
+            data.remove_prefix(BinaryProtocol::LENGTH_SIZE);
+            return value;
+        }
+
+        uint64_t u64()
+        {
+            uint64_t value = 0;
+            ok = ok && BinaryProtocol::takeU64(data, value);
+            return value;
+        }
+
+        std::string string()
+        {
+            uint32_t length = u32();
+            if (!ok || data.size() < length)
+            {
+                ok = false;
+                return std::string();
+            }
+            std::string value(data.substr(0, length));
+            data.remove_prefix(length);
+            return value;
+        }
+    };
+
+    // The handover blocks both processes; a peer that stops answering fails it
+    void setTimeouts(SOCKET socket, int timeoutMs = HANDOFF_TIMEOUT_MS)
+    {
+        timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+
+    bool socketAddress(const std::string &path, sockaddr_un &address)
+    {
+        address = sockaddr_un{};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+}
+
+HotRestart::HotRestart(std::string socketPath)
+    : path(std::move(socketPath)), listener(INVALID_SOCKET), successor(INVALID_SOCKET), watching(false),
+      connected(false)
+{
+}
+
+HotRestart::~HotRestart()
+{
+    stop();
+}
+
+bool HotRestart::takeOver(State &state)
+{
+    state = State();
+
+    sockaddr_un address;
+    if (!socketAddress(path, address))
+    {
+        Log::error("Hot restart: bad socket path \"", path, "\"");
+        return false;
+    }
+    SOCKET socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket == INVALID_SOCKET)
+    {
+        return false;
+    }
+    if (connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        closesocket(socket); // Nothing to take over: a cold start
+        return false;
+    }
+    setTimeouts(socket);
+    Log::info("Hot restart: taking over from the server on ", path);
+
+    std::string hello(1, TAG_HELLO);
+    hello.append(HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC));
+    putU32(hello, HANDOFF_VERSION);
+
+    std::vector<SOCKET> descriptors;
+    std::string data;
+    bool ok = writeAll(socket, hello.data(), hello.size()) && receive(socket, descriptors, data) &&
+              decode(data, descriptors.size(), state);
+    if (ok)
+    {
+        size_t next = 0;
+        for (SOCKET &listenSocket : state.listeners)
+        {
+            listenSocket = descriptors[next++];
+        }
+        for (Session &session : state.sessions)
+        {
+            session.socket = descriptors[next++];
+        }
+        ok = writeAll(socket, &TAG_ACK, 1);
+    }
+    closesocket(socket);
+
+    if (!ok)
+    {
+        Log::error("Hot restart: takeover from ", path, " failed");
+        for (SOCKET descriptor : descriptors)
+        {
+            closesocket(descriptor);
+        }
+        state = State();
+        return false;
+    }
+    Log::info("Hot restart: took over ", state.listeners.size(), " listener(s) and ", state.sessions.size(),
+              " connection(s)");
+    return true;
+}
+
+bool HotRestart::listen(std::function<void()> onSuccessor)
+{
+    sockaddr_un address;
+    if (!socketAddress(path, address))
+    {
+        Log::error("Hot restart: bad socket path \"", path, "\"");
+        return false;
+    }
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == INVALID_SOCKET)
+    {
+        Log::error("Hot restart: socket creation failed: ", errno);
+        return false;
+    }
+
+    ::unlink(path.c_str()); // Left by the process this one took over from, or by one that crashed
+    // Whoever connects is handed every client; only this user may
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(listener, 1) != 0)
+    {
+        Log::error("Hot restart: cannot listen on ", path, ": ", errno);
+        closesocket(listener);
+        listener = INVALID_SOCKET;
+        return false;
+    }
+
+    watching = true;
+    watcher = std::thread(&HotRestart::watch, this, std::move(onSuccessor));
+    Log::info("Hot restart: listening on ", path);
+    return true;
+}
+
+void HotRestart::watch(std::function<void()> onSuccessor)
+{
+    while (watching)
+    {
+        pollfd pfd{listener, POLLIN, 0};
+        if (pollSockets(&pfd, 1, HANDOFF_POLL_MS) <= 0)
+        {
+            continue;
+        }
+        SOCKET socket = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (socket == INVALID_SOCKET)
+        {
+            continue;
+        }
+
+        if (!acceptSuccessor(socket))
+        {
+            closesocket(socket); // A probe, another user or another build; keep serving
+            continue;
+        }
+
+        setTimeouts(socket);
+        successor = socket;
+        connected = true;
+        Log::info("Hot restart: a new server connected, handing over");
+        onSuccessor();
+        return; // Only one process takes over
+    }
+}
+
+bool HotRestart::acceptSuccessor(SOCKET socket)
+{
+    ucred peer{};
+    socklen_t length = sizeof(peer);
+    if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != geteuid())
+    {
+        Log::limited(Log::Level::Warn, "handoff-peer", "Hot restart: refused a connection from uid ", peer.uid);
+        return false;
+    }
+
+    // Checked before anything stops, so a stray connection costs nothing
+    setTimeouts(socket, HANDOFF_HELLO_MS);
+    char hello[1 + sizeof(HANDOFF_MAGIC) + BinaryProtocol::LENGTH_SIZE];
+    if (!readAll(socket, hello, sizeof(hello)) || hello[0] != TAG_HELLO ||
+        std::memcmp(hello + 1, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC)) != 0)
+    {
+        Log::limited(Log::Level::Warn, "handoff-hello", "Hot restart: ignored a connection that is not a server");
+        return false;
+    }
+    uint32_t version = BinaryProtocol::getU32(hello + 1 + sizeof(HANDOFF_MAGIC));
+    if (version != HANDOFF_VERSION)
+    {
+        Log::warn("Hot restart: refused a server with handover format ", version, " (this one has ",
+                  HANDOFF_VERSION, ")");
+        return false;
+    }
+    return true;
+}
+
+void HotRestart::stop()
+{
+    watching = false;
+    if (watcher.joinable() && watcher.get_id() != std::this_thread::get_id())
+    {
+        watcher.join();
+    }
+
+    if (listener != INVALID_SOCKET)
+    {
+        closesocket(listener);
+        listener = INVALID_SOCKET;
+        if (!connected)
+        {
+            ::unlink(path.c_str()); // Once handed over, the path is the successor's
+        }
+    }
+    if (successor != INVALID_SOCKET)
+    {
+        closesocket(successor);
+        successor = INVALID_SOCKET;
+    }
+}
+
+bool HotRestart::hasSuccessor() const
+{
+    return connected;
+}
+
+bool HotRestart::handOff(const State &state)
+{
+    if (successor == INVALID_SOCKET)
+    {
+        return false;
+    }
+
+    std::vector<SOCKET> descriptors(state.listeners);
+    for (const Session &session : state.sessions)
+    {
+        descriptors.push_back(session.socket);
+    }
+    std::string data = encode(state);
+    char header[BinaryProtocol::LENGTH_SIZE];
+    BinaryProtocol::putU32(header, static_cast<uint32_t>(data.size()));
+
+    char ack = 0;
+    bool ok = sendDescriptors(successor, descriptors) && writeAll(successor, &TAG_STATE, 1) &&
+              writeAll(successor, header, sizeof(header)) && writeAll(successor, data.data(), data.size()) &&
+              readAll(successor, &ack, 1) && ack == TAG_ACK;
+    if (!ok)
+    {
+        Log::error("Hot restart: handover failed: ", errno);
+        return false;
+    }
+    Log::info("Hot restart: handed ", state.sessions.size(), " connection(s) over");
+    return true;
+}
+
+std::string HotRestart::encode(const State &state)
+{
+    std::string out;
+    putU32(out, static_cast<uint32_t>(state.listeners.size()));
+    putU32(out, static_cast<uint32_t>(state.sessions.size()));
+    for (const Session &session : state.sessions)
+    {
+        putU64(out, session.id);
+        out += static_cast<char>(session.protocol);
+        out += static_cast<char>((session.authenticated ? FLAG_AUTHENTICATED : 0) |
+                                 (session.compression ? FLAG_COMPRESSION : 0));
+        putU32(out, session.idleMs);
+        putString(out, session.username);
+        putU32(out, static_cast<uint32_t>(session.rooms.size()));
+        for (const std::string &room : session.rooms)
+        {
+            putString(out, room);
+        }
+        putString(out, session.currentRoom);
+        putString(out, session.input);
+        putString(out, session.output);
+    }
+    return out;
+}
+
+bool HotRestart::decode(std::string_view data, size_t descriptors, State &state)
+{
+    Reader in{data};
+    uint32_t listeners = in.u32();
+    uint32_t sessions = in.u32();
+    if (!in.ok || listeners == 0 || static_cast<size_t>(listeners) + sessions != descriptors)
+    {
+        return false;
+    }
+
+    state.listeners.assign(listeners, INVALID_SOCKET);
+    state.sessions.resize(sessions);
+    for (Session &session : state.sessions)
+    {
+        session.id = in.u64();
+        uint8_t protocol = in.u8();
+        if (protocol > static_cast<uint8_t>(Client::Protocol::Binary))
+        {
+            return false;
+        }
+        session.protocol = static_cast<Client::Protocol>(protocol);
+        uint8_t flags = in.u8();
+        session.authenticated = flags & FLAG_AUTHENTICATED;
+        session.compression = flags & FLAG_COMPRESSION;
+        session.idleMs = in.u32();
+        session.username = in.string();
+        uint32_t rooms = in.u32();
+        for (uint32_t i = 0; i < rooms && in.ok; ++i)
+        {
+            session.rooms.push_back(in.string());
+        }
+        session.currentRoom = in.string();
+        session.input = in.string();
+        session.output = in.string();
+    }
+    return in.ok && in.data.empty();
+}
+
+bool HotRestart::sendDescriptors(SOCKET socket, const std::vector<SOCKET> &descriptors)
+{
+    for (size_t first = 0; first < descriptors.size(); first += HANDOFF_FD_BATCH)
+    {
+        size_t count = std::min<size_t>(descriptors.size() - first, HANDOFF_FD_BATCH);
+        char control[CMSG_SPACE(sizeof(int) * HANDOFF_FD_BATCH)] = {};
+        char tag = TAG_DESCRIPTORS;
+        iovec iov{&tag, 1};
+
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        std::memcpy(CMSG_DATA(header), descriptors.data() + first, sizeof(int) * count);
+
+        if (sendmsg(socket, &message, MSG_NOSIGNAL) != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HotRestart::receive(SOCKET socket, std::vector<SOCKET> &descriptors, std::string &data)
+{
+    // One tag byte per message, so each read stops at the descriptors sent with it
+    while (true)
+    {
+        char control[CMSG_SPACE(sizeof(int) * HANDOFF_FD_BATCH)];
+        char tag = 0;
+        iovec iov{&tag, 1};
+
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+        if (received != 1)
+        {
+            return false;
+        }
+        for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+        {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+            {
+                size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                size_t first = descriptors.size();
+                descriptors.resize(first + count);
+                std::memcpy(descriptors.data() + first, CMSG_DATA(header), sizeof(int) * count);
+            }
+        }
+        if (message.msg_flags & MSG_CTRUNC)
+        {
+            Log::error("Hot restart: descriptors lost (check the open file limit)");
+            return false;
+        }
+
+        if (tag == TAG_STATE)
+        {
+            break;
+        }
+        if (tag != TAG_DESCRIPTORS)
+        {
+            return false;
+        }
+    }
+
+    char header[BinaryProtocol::LENGTH_SIZE];
+    if (!readAll(socket, header, sizeof(header)))
+    {
+        return false;
+    }
+    data.resize(BinaryProtocol::getU32(header));
+    return readAll(socket, &data[0], data.size());
+}
+
+bool HotRestart::writeAll(SOCKET socket, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(socket, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool HotRestart::readAll(SOCKET socket, char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t received = recv(socket, data, length, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+#else
+
+HotRestart::HotRestart(std::string socketPath)
+    : path(std::move(socketPath)), listener(INVALID_SOCKET), successor(INVALID_SOCKET), watching(false),
+      connected(false)
+{
+}
+
+HotRestart::~HotRestart()
+{
+}
+
+bool HotRestart::takeOver(State &state)
+{
+    state = State();
+    return false;
+}
+
+bool HotRestart::listen(std::function<void()>)
+{
+    Log::warn("Hot restart is only supported on Linux");
+    return false;
+}
+
+void HotRestart::stop()
+{
+}
+
+bool HotRestart::hasSuccessor() const
+{
+    return false;
+}
+
+bool HotRestart::handOff(const State &)
+{
+    return false;
+}
+
+#endif
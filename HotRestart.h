@@ -0,0 +1,95 @@
+#ifndef HOTRESTART_H
+#define HOTRESTART_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "socketCompat.h"
+#include "serverDefaults.h"
+#include "Client.h"
+
+// Zero-downtime upgrades. A newly started server given the same
+// --handoff-socket path takes the listening sockets and every live
+// connection over from the running one, so clients stay connected and
+// logged in instead of all reconnecting at once.
+//
+// The new process connects to the Unix socket at the path (mode 0600) and
+// opens with a magic and the handover format version. Only if those match,
+// and the process runs as the same user, does the old one stop its event
+// loops, run the commands it has already read, and send every descriptor
+// (SCM_RIGHTS, HANDOFF_FD_BATCH per message) followed by one record per
+// connection. Once the new process acknowledges them the old one closes its
+// copies and exits without a goodbye; anything that arrives in between waits
+// in the kernel for the new process. Anything else that connects is closed
+// and the server carries on.
+//
+// Linux only; elsewhere takeOver() and listen() always fail.
+class HotRestart
+{
+public:
+    // One connection's state, as the new process needs it
+    struct Session
+    {
+        SOCKET socket = INVALID_SOCKET;
+        uint64_t id = 0; // Binary clients address each other by it
+        Client::Protocol protocol = Client::Protocol::Negotiating;
+        bool compression = false;
+        bool authenticated = false;
+        std::string username;
+        uint32_t idleMs = 0;            // Since the last activity
+        std::vector<std::string> rooms; // Join order
+        std::string currentRoom;
+        std::string input;  // Received and not yet framed
+        std::string output; // Queued and not yet written, as sent on the wire
+    };
+
+    struct State
+    {
+        std::vector<SOCKET> listeners; // The main listener first, then the shards'
+        std::vector<Session> sessions;
+    };
+
+    explicit HotRestart(std::string path);
+    ~HotRestart();
+
+    HotRestart(const HotRestart &) = delete;
+    HotRestart &operator=(const HotRestart &) = delete;
+
+    // New process: takes over from the process listening on the path. False
+    // when none is, or the transfer failed; state is then left empty.
+    bool takeOver(State &state);
+
+    // Listens on the path for the next process. onSuccessor runs on the
+    // watcher thread when one connects; it should stop the event loops.
+    bool listen(std::function<void()> onSuccessor);
+    void stop();
+
+    bool hasSuccessor() const;
+
+    // Old process: sends state to the successor and waits for its
+    // acknowledgement. The caller still owns, and closes, its descriptors.
+    bool handOff(const State &state);
+
+private:
+    std::string path;
+    SOCKET listener;
+    SOCKET successor;
+    std::atomic<bool> watching;
+    std::atomic<bool> connected;
+    std::thread watcher;
+
+    void watch(std::function<void()> onSuccessor);
+    bool acceptSuccessor(SOCKET socket); // Same user, same handover format
+
+    static std::string encode(const State &state);
+    static bool decode(std::string_view data, size_t descriptors, State &state);
+    static bool sendDescriptors(SOCKET socket, const std::vector<SOCKET> &descriptors);
+    static bool receive(SOCKET socket, std::vector<SOCKET> &descriptors, std::string &data);
+    static bool writeAll(SOCKET socket, const char *data, size_t length);
+    static bool readAll(SOCKET socket, char *data, size_t length);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef IOBACKEND_H
+#define IOBACKEND_H
+
+#include <memory>
+#include "socketCompat.h"
+
+class Client;
+
+// Event loop that owns the listening socket and every connection's I/O.
+// ChatServer picks one at startup; run() blocks until stop() is called.
+class IoBackend
+{
+public:
+    virtual ~IoBackend() = default;
+
+    virtual bool initialize() = 0;
+    virtual void run() = 0;
+    virtual void stop() = 0;
+
+    virtual const char *name() const = 0;
+
+    // Thread-safe. Reading a client stops when processMessages() reports its
+    // command inbox full; a command worker calls this once it has drained it.
+    virtual void resumeReading(const std::shared_ptr<Client> &client) = 0;
+
+    // Hot restart (HotRestart.h). adopt() registers a connection inherited
+    // from the previous process, before run(). release() stops like stop(),
+    // but run() returns only once no read or write is left with the kernel,
+    // and drainPending() then delivers what other threads queued for the loop.
+    virtual std::shared_ptr<Client> adopt(SOCKET socket) = 0;
+    virtual void release() { stop(); }
+    virtual void drainPending() {}
+};
+
+#endif
@@ -0,0 +1,341 @@
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::system_clock;
+
+    const char *const levelNames[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+    constexpr unsigned NO_THREAD = ~0u; // Written synchronously, not from a ring
+
+    struct Record
+    {
+        int64_t timeNs; // Since the epoch
+        Log::Level level;
+        uint16_t length;
+        char text[LOG_RECORD_SIZE];
+    };
+
+    // Single producer (the owning thread), single consumer (the writer).
+    // head and tail only grow; a slot is free while head - tail < capacity.
+    struct Ring
+    {
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> dropped{0}; // Written by the producer only
+        uint64_t droppedReported = 0;     // Writer's side
+        std::atomic<bool> abandoned{false};
+        unsigned thread;
+        Record records[LOG_RING_RECORDS];
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<Ring *> rings;
+        unsigned nextThread = 0;
+    };
+
+    // Never destroyed: threads may still log after static destructors ran
+    Registry &registry()
+    {
+        static Registry *instance = new Registry();
+        return *instance;
+    }
+
+    // The ring outlives its thread until the writer has drained it
+    struct LocalRing
+    {
+        Ring *ring;
+
+        LocalRing() : ring(new Ring())
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            ring->thread = r.nextThread++;
+            r.rings.push_back(ring);
+        }
+
+        ~LocalRing()
+        {
+            ring->abandoned.store(true, std::memory_order_release);
+        }
+    };
+
+    struct RateSlot
+    {
+        std::atomic<int64_t> windowStart{0}; // Milliseconds since the epoch
+        std::atomic<uint32_t> admitted{0};
+        std::atomic<uint64_t> suppressed{0};
+    };
+
+    std::atomic<int> threshold{static_cast<int>(Log::Level::Info)};
+    std::atomic<bool> running{false};
+    std::thread writer;
+    std::mutex lifecycleMutex;
+    RateSlot rateSlots[LOG_RATE_SLOTS];
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void format(std::string &out, int64_t timeNs, Log::Level level, unsigned thread, std::string_view text)
+    {
+        std::time_t seconds = static_cast<std::time_t>(timeNs / 1000000000);
+        std::tm utc;
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        char stamp[48];
+        size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(stamp + length, sizeof(stamp) - length, ".%03dZ %s ",
+                      static_cast<int>(timeNs / 1000000 % 1000), levelNames[static_cast<int>(level)]);
+        out += stamp;
+        if (thread != NO_THREAD)
+        {
+            out += "[t" + std::to_string(thread) + "] ";
+        }
+        out += text;
+        out += '\n';
+    }
+
+    void writeOut(const std::string &out, const std::string &err)
+    {
+        if (!out.empty())
+        {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (!err.empty())
+        {
+            std::fwrite(err.data(), 1, err.size(), stderr);
+            std::fflush(stderr);
+        }
+    }
+
+    struct Pending
+    {
+        int64_t timeNs;
+        Log::Level level;
+        unsigned thread;
+        std::string_view text;
+    };
+
+    // Empties every ring once and writes what was there in timestamp order;
+    // rings of exited threads are freed once empty. Returns the line count.
+    size_t drain(std::vector<Record> &batch, std::vector<Pending> &pending)
+    {
+        batch.clear();
+        pending.clear();
+        std::vector<Ring *> finished;
+        std::vector<std::pair<unsigned, uint64_t>> drops;
+        std::vector<unsigned> owners;
+
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto it = r.rings.begin(); it != r.rings.end();)
+            {
+                Ring *ring = *it;
+                // Read the flag first: after it is set the producer pushes nothing more
+                bool abandoned = ring->abandoned.load(std::memory_order_acquire);
+                uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail)
+                {
+                    batch.push_back(ring->records[tail % LOG_RING_RECORDS]);
+                    owners.push_back(ring->thread);
+                }
+                ring->tail.store(tail, std::memory_order_release);
+
+                uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+                if (dropped != ring->droppedReported)
+                {
+                    drops.emplace_back(ring->thread, dropped - ring->droppedReported);
+                    ring->droppedReported = dropped;
+                }
+
+                if (abandoned)
+                {
+                    finished.push_back(ring);
+                    it = r.rings.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        for (Ring *ring : finished)
+        {
+            delete ring;
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const Record &record = batch[i];
+            pending.push_back({record.timeNs, record.level, owners[i], std::string_view(record.text, record.length)});
+        }
+        std::stable_sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b)
+                         { return a.timeNs < b.timeNs; });
+
+        std::string out, err;
+        for (const Pending &line : pending)
+        {
+            format(line.level >= Log::Level::Warn ? err : out, line.timeNs, line.level, line.thread, line.text);
+        }
+        for (auto &drop : drops)
+        {
+            std::string text = std::to_string(drop.second) + " log lines dropped, ring full";
+            format(err, nowNs(), Log::Level::Warn, drop.first, text);
+        }
+        writeOut(out, err);
+        return pending.size() + drops.size();
+    }
+
+    void runWriter()
+    {
+        std::vector<Record> batch;
+        std::vector<Pending> pending;
+        while (running.load(std::memory_order_acquire))
+        {
+            if (drain(batch, pending) == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_MS));
+            }
+        }
+        drain(batch, pending);
+    }
+}
+
+namespace Log
+{
+    bool parseLevel(std::string_view name, Level &level)
+    {
+        if (name == "debug")
+            level = Level::Debug;
+        else if (name == "info")
+            level = Level::Info;
+        else if (name == "warn")
+            level = Level::Warn;
+        else if (name == "error")
+            level = Level::Error;
+        else
+            return false;
+        return true;
+    }
+
+    void setLevel(Level level)
+    {
+        threshold.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    bool enabled(Level level)
+    {
+        return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed);
+    }
+
+    void Line::append(std::string_view part)
+    {
+        size_t room = sizeof(text) - length;
+        if (part.size() <= room)
+        {
+            std::memcpy(text + length, part.data(), part.size());
+            length += part.size();
+            return;
+        }
+        if (!truncated)
+        {
+            truncated = true;
+            length = sizeof(text) - 3;
+            std::memcpy(text + length, "...", 3);
+            length = sizeof(text);
+        }
+    }
+
+    void submit(Level level, const Line &line)
+    {
+        std::string_view text = line.view();
+        if (!running.load(std::memory_order_acquire))
+        {
+            std::string formatted;
+            format(formatted, nowNs(), level, NO_THREAD, text);
+            writeOut(level >= Level::Warn ? std::string() : formatted, level >= Level::Warn ? formatted : std::string());
+            return;
+        }
+
+        thread_local LocalRing local;
+        Ring &ring = *local.ring;
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) >= LOG_RING_RECORDS)
+        {
+            ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        Record &record = ring.records[head % LOG_RING_RECORDS];
+        record.timeNs = nowNs();
+        record.level = level;
+        record.length = static_cast<uint16_t>(text.size());
+        std::memcpy(record.text, text.data(), text.size());
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    bool admit(std::string_view key, uint64_t &suppressed)
+    {
+        // Keys hash onto a fixed table; two keys sharing a slot share a budget
+        RateSlot &slot = rateSlots[std::hash<std::string_view>()(key) % LOG_RATE_SLOTS];
+        int64_t now = nowNs() / 1000000;
+        int64_t start = slot.windowStart.load(std::memory_order_relaxed);
+        suppressed = 0;
+        if (now - start >= LOG_RATE_WINDOW_MS &&
+            slot.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed))
+        {
+            slot.admitted.store(0, std::memory_order_relaxed);
+            suppressed = slot.suppressed.exchange(0, std::memory_order_relaxed);
+        }
+
+        if (slot.admitted.fetch_add(1, std::memory_order_relaxed) < LOG_RATE_BURST)
+        {
+            return true;
+        }
+        slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> lock(lifecycleMutex);
+        if (running.load())
+        {
+            return;
+        }
+        running.store(true, std::memory_order_release);
+        writer = std::thread(runWriter);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(lifecycleMutex);
+        if (!running.load())
+        {
+            return;
+        }
+        running.store(false, std::memory_order_release);
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "serverDefaults.h"
+
+// Asynchronous logging for the server. A logging thread formats the line
+// into a fixed-size record and pushes it onto its own single-producer ring;
+// a background writer drains every ring and does the actual output. A full
+// ring drops the line and counts it, so a slow terminal never stalls a
+// connection thread. Before start() and after stop(), lines are written
+// synchronously instead.
+namespace Log
+{
+    enum class Level
+    {
+        Debug,
+        Info,
+        Warn,
+        Error
+    };
+
+    bool parseLevel(std::string_view name, Level &level);
+    void setLevel(Level level);
+    bool enabled(Level level);
+
+    // One line of text, built without allocating; parts past
+    // LOG_RECORD_SIZE are cut off and marked with "..."
+    class Line
+    {
+    private:
+        char text[LOG_RECORD_SIZE];
+        size_t length = 0;
+        bool truncated = false;
+
+    public:
+        void append(std::string_view part);
+        void append(const char *part) { append(std::string_view(part ? part : "(null)")); }
+        void append(const std::string &part) { append(std::string_view(part)); }
+        void append(char c) { append(std::string_view(&c, 1)); }
+
+        template <typename T>
+        std::enable_if_t<std::is_arithmetic_v<T>> append(T value)
+        {
+            char digits[32];
+            int written;
+            if constexpr (std::is_floating_point_v<T>)
+                written = std::snprintf(digits, sizeof(digits), "%g", static_cast<double>(value));
+            else if constexpr (std::is_signed_v<T>)
+                written = std::snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value));
+            else
+                written = std::snprintf(digits, sizeof(digits), "%llu", static_cast<unsigned long long>(value));
+            append(std::string_view(digits, written > 0 ? static_cast<size_t>(written) : 0));
+        }
+
+        std::string_view view() const { return std::string_view(text, length); }
+        bool wasTruncated() const { return truncated; }
+    };
+
+    void submit(Level level, const Line &line);
+
+    // Rate limiting for lines that can repeat without bound (failed accepts,
+    // evictions): at most LOG_RATE_BURST lines per key every
+    // LOG_RATE_WINDOW_MS. When a line is let through after some were held
+    // back, suppressed says how many.
+    bool admit(std::string_view key, uint64_t &suppressed);
+
+    template <typename... Parts>
+    void write(Level level, const Parts &...parts)
+    {
+        if (!enabled(level))
+            return;
+        Line line;
+        (line.append(parts), ...);
+        submit(level, line);
+    }
+
+    template <typename... Parts>
+    void debug(const Parts &...parts) { write(Level::Debug, parts...); }
+    template <typename... Parts>
+    void info(const Parts &...parts) { write(Level::Info, parts...); }
+    template <typename... Parts>
+    void warn(const Parts &...parts) { write(Level::Warn, parts...); }
+    template <typename... Parts>
+    void error(const Parts &...parts) { write(Level::Error, parts...); }
+
+    // Like write(), subject to admit(key)
+    template <typename... Parts>
+    void limited(Level level, std::string_view key, const Parts &...parts)
+    {
+        uint64_t suppressed = 0;
+        if (!enabled(level) || !admit(key, suppressed))
+            return;
+        Line line;
+        (line.append(parts), ...);
+        if (suppressed)
+        {
+            line.append(" (");
+            line.append(suppressed);
+            line.append(" similar suppressed)");
+        }
+        submit(level, line);
+    }
+
+    // Starts the background writer; stop() drains every ring and joins it
+    void start();
+    void stop();
+}
+
+#endif
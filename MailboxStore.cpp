@@ -0,0 +1,358 @@
+#include "MailboxStore.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+    // One record per message: this header, then sender and text. Native byte
+    // order; a record cut short by a crash ends the mailbox.
+    struct RecordHeader
+    {
+        uint32_t senderLength;
+        uint32_t textLength;
+        int64_t timeMs;
+    };
+
+    const char *const EXTENSION = ".mbox";
+
+    int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    int64_t expiredBefore()
+    {
+        return nowMs() - static_cast<int64_t>(MAILBOX_TTL_SECONDS) * 1000;
+    }
+
+    size_t recordSize(std::string_view sender, std::string_view text)
+    {
+        return sizeof(RecordHeader) + sender.size() + text.size();
+    }
+
+    // File names are the hex-encoded username, so any name is a safe path
+    std::string encodeName(std::string_view name)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string encoded;
+        encoded.reserve(name.size() * 2);
+        for (unsigned char c : name)
+        {
+            encoded += digits[c >> 4];
+            encoded += digits[c & 15];
+        }
+        return encoded;
+    }
+
+    bool decodeName(std::string_view encoded, std::string &name)
+    {
+        auto value = [](char c) -> int
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            return -1;
+        };
+        if (encoded.empty() || encoded.size() % 2 != 0)
+        {
+            return false;
+        }
+        name.clear();
+        for (size_t i = 0; i < encoded.size(); i += 2)
+        {
+            int high = value(encoded[i]), low = value(encoded[i + 1]);
+            if (high < 0 || low < 0)
+            {
+                return false;
+            }
+            name += static_cast<char>(high << 4 | low);
+        }
+        return true;
+    }
+}
+
+MailboxStore::MailboxStore(std::string dir)
+    : directory(std::move(dir))
+{
+}
+
+bool MailboxStore::acceptsName(std::string_view recipient)
+{
+    return !recipient.empty() && recipient[0] != '#' && recipient.size() <= MAILBOX_MAX_NAME;
+}
+
+std::string MailboxStore::pathFor(std::string_view recipient) const
+{
+    return directory + "/" + encodeName(recipient) + EXTENSION;
+}
+
+bool MailboxStore::open()
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        Log::error("Mailboxes: cannot create ", directory, ": ", error.message());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Message> messages;
+    std::string name;
+    std::error_code ignored;
+    for (const auto &item : std::filesystem::directory_iterator(directory, error))
+    {
+        std::string file = item.path().filename().string();
+        if (item.path().extension() != EXTENSION ||
+            !decodeName(std::string_view(file).substr(0, file.size() - std::strlen(EXTENSION)), name))
+        {
+            continue;
+        }
+
+        messages.clear();
+        readMessages(item.path().string(), messages);
+        if (messages.empty())
+        {
+            std::filesystem::remove(item.path(), ignored);
+            continue;
+        }
+
+        Summary &box = boxes[name];
+        box = summarize(messages);
+
+        // A record cut short by a crash would hide everything appended after it
+        if (std::filesystem::file_size(item.path(), ignored) != box.bytes)
+        {
+            writeMessages(item.path().string(), messages, "wb");
+        }
+    }
+    if (error)
+    {
+        Log::error("Mailboxes: cannot read ", directory, ": ", error.message());
+        return false;
+    }
+
+    Log::info("Mailboxes: ", directory, ", ", boxes.size(), " holding mail");
+    return true;
+}
+
+bool MailboxStore::deposit(std::string_view recipient, std::string_view sender, std::string_view text)
+{
+    if (!acceptsName(recipient))
+    {
+        return false;
+    }
+
+    size_t size = recordSize(sender, text);
+    std::string key(recipient);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = boxes.find(key);
+    if (it == boxes.end() && boxes.size() >= MAILBOX_MAX_USERS)
+    {
+        return false;
+    }
+    Summary current = it != boxes.end() ? it->second : Summary();
+    if (current.messages >= MAILBOX_MAX_MESSAGES || current.bytes + size > MAILBOX_MAX_BYTES)
+    {
+        return false;
+    }
+
+    Message message{nowMs(), std::string(sender), std::string(text)};
+    if (!writeMessages(pathFor(recipient), {message}, "ab"))
+    {
+        Log::limited(Log::Level::Error, "mailbox-write", "Mailboxes: cannot write to ", pathFor(recipient));
+        return false;
+    }
+
+    Summary &box = boxes[key];
+    if (box.messages == 0)
+    {
+        box.oldestMs = message.timeMs;
+    }
+    ++box.messages;
+    box.bytes += size;
+    return true;
+}
+
+std::vector<MailboxStore::Message> MailboxStore::collect(std::string_view recipient, size_t &taken)
+{
+    std::vector<Message> messages;
+    taken = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = boxes.find(std::string(recipient));
+    if (it == boxes.end() || it->second.collecting)
+    {
+        return messages; // The common case: no mail, no disk access
+    }
+    it->second.collecting = true;
+
+    readMessages(pathFor(recipient), messages);
+    taken = messages.size();
+
+    int64_t cutoff = expiredBefore();
+    messages.erase(std::remove_if(messages.begin(), messages.end(), [cutoff](const Message &message)
+                                  { return message.timeMs < cutoff; }),
+                   messages.end());
+    return messages;
+}
+
+bool MailboxStore::acknowledge(std::string_view recipient, size_t taken, bool delivered)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = boxes.find(std::string(recipient));
+    if (it == boxes.end())
+    {
+        return false;
+    }
+    it->second.collecting = false;
+    if (!delivered)
+    {
+        return false; // Kept whole for the next LOGIN
+    }
+
+    // Deposits since the collect were appended after the taken records
+    std::string path = pathFor(recipient);
+    std::vector<Message> messages;
+    readMessages(path, messages);
+    messages.erase(messages.begin(), messages.begin() + std::min(taken, messages.size()));
+    if (messages.empty())
+    {
+        std::remove(path.c_str());
+        boxes.erase(it);
+        return false;
+    }
+
+    std::string temporary = path + ".tmp";
+    std::error_code error;
+    if (writeMessages(temporary, messages, "wb"))
+    {
+        std::filesystem::rename(temporary, path, error);
+    }
+    it->second = summarize(messages);
+    return true;
+}
+
+void MailboxStore::sweep()
+{
+    int64_t cutoff = expiredBefore();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<Message> messages;
+    size_t dropped = 0;
+    for (auto it = boxes.begin(); it != boxes.end();)
+    {
+        // A collected mailbox keeps its records in place until acknowledged
+        if (it->second.oldestMs >= cutoff || it->second.collecting)
+        {
+            ++it;
+            continue;
+        }
+
+        std::string path = pathFor(it->first);
+        messages.clear();
+        readMessages(path, messages);
+        auto firstKept = std::find_if(messages.begin(), messages.end(), [cutoff](const Message &message)
+                                      { return message.timeMs >= cutoff; });
+        dropped += firstKept - messages.begin();
+        messages.erase(messages.begin(), firstKept); // Appended in time order
+
+        if (messages.empty())
+        {
+            std::remove(path.c_str());
+            it = boxes.erase(it);
+            continue;
+        }
+
+        // Rewritten beside the mailbox and renamed over it
+        std::string temporary = path + ".tmp";
+        std::error_code error;
+        if (writeMessages(temporary, messages, "wb"))
+        {
+            std::filesystem::rename(temporary, path, error);
+        }
+        it->second = summarize(messages);
+        ++it;
+    }
+
+    if (dropped > 0)
+    {
+        Log::info("Mailboxes: expired ", dropped, " message(s)");
+    }
+}
+
+size_t MailboxStore::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return boxes.size();
+}
+
+MailboxStore::Summary MailboxStore::summarize(const std::vector<Message> &messages)
+{
+    Summary box;
+    for (const Message &message : messages)
+    {
+        ++box.messages;
+        box.bytes += recordSize(message.sender, message.text);
+    }
+    box.oldestMs = messages.empty() ? 0 : messages.front().timeMs;
+    return box;
+}
+
+bool MailboxStore::readMessages(const std::string &path, std::vector<Message> &messages)
+{
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    RecordHeader header;
+    while (std::fread(&header, sizeof(header), 1, file) == 1)
+    {
+        if (header.senderLength > MAILBOX_MAX_BYTES || header.textLength > MAILBOX_MAX_BYTES)
+        {
+            break; // Corrupt
+        }
+        Message message{header.timeMs, std::string(header.senderLength, '\0'), std::string(header.textLength, '\0')};
+        if (std::fread(&message.sender[0], 1, header.senderLength, file) != header.senderLength ||
+            std::fread(&message.text[0], 1, header.textLength, file) != header.textLength)
+        {
+            break; // Cut short
+        }
+        messages.push_back(std::move(message));
+    }
+    std::fclose(file);
+    return true;
+}
+
+bool MailboxStore::writeMessages(const std::string &path, const std::vector<Message> &messages, const char *mode)
+{
+    // Encoded first so each message lands in one write
+    std::string bytes;
+    for (const Message &message : messages)
+    {
+        RecordHeader header{static_cast<uint32_t>(message.sender.size()), static_cast<uint32_t>(message.text.size()),
+                            message.timeMs};
+        bytes.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        bytes += message.sender;
+        bytes += message.text;
+    }
+
+    FILE *file = std::fopen(path.c_str(), mode);
+    if (!file)
+    {
+        return false;
+    }
+    bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,78 @@
+#ifndef MAILBOXSTORE_H
+#define MAILBOXSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "serverDefaults.h"
+
+// Store-and-forward DMs for users who are not logged in. Each recipient has
+// one append-only file in the mailbox directory; a DM to an offline user is
+// appended to it, and read when that user next logs in; the messages are
+// removed once they have been queued to the client. Mailboxes are bounded (MAILBOX_MAX_MESSAGES, MAILBOX_MAX_BYTES,
+// MAILBOX_MAX_USERS) and messages older than MAILBOX_TTL_SECONDS are dropped,
+// at delivery and by sweep().
+//
+// An in-memory summary of every mailbox means a LOGIN with no mail, and a
+// deposit into a full mailbox, never touch the disk.
+class MailboxStore
+{
+public:
+    struct Message
+    {
+        int64_t timeMs; // Unix time it was sent
+        std::string sender;
+        std::string text;
+    };
+
+    explicit MailboxStore(std::string directory);
+
+    // Creates the directory and indexes the mailboxes already in it
+    bool open();
+
+    // Usernames that can have a mailbox (LOGIN-able and short enough for a file name)
+    static bool acceptsName(std::string_view recipient);
+
+    // Appends one message; false if the mailbox is full or cannot be written
+    bool deposit(std::string_view recipient, std::string_view sender, std::string_view text);
+
+    // Reads the recipient's unexpired messages, oldest first, leaving them in
+    // the mailbox; taken is how many records were read, expired ones
+    // included. Reads nothing (taken 0) while an earlier collect for the
+    // recipient is not yet acknowledged.
+    std::vector<Message> collect(std::string_view recipient, size_t &taken);
+
+    // Ends a collect: removes the taken records once delivered, otherwise
+    // leaves them for the next LOGIN. True if the mailbox still holds mail,
+    // such as DMs deposited since the collect.
+    bool acknowledge(std::string_view recipient, size_t taken, bool delivered);
+
+    // Rewrites mailboxes holding expired messages; deletes emptied ones
+    void sweep();
+
+    size_t size(); // Mailboxes holding mail
+
+private:
+    struct Summary
+    {
+        uint32_t messages = 0;
+        size_t bytes = 0;
+        int64_t oldestMs = 0;
+        bool collecting = false; // Read by collect, not yet acknowledged
+    };
+
+    std::string directory;
+    std::mutex mutex; // Guards boxes and the files
+    std::unordered_map<std::string, Summary> boxes;
+
+    std::string pathFor(std::string_view recipient) const;
+    static Summary summarize(const std::vector<Message> &messages);
+    static bool readMessages(const std::string &path, std::vector<Message> &messages);
+    static bool writeMessages(const std::string &path, const std::vector<Message> &messages, const char *mode);
+};
+
+#endif
@@ -0,0 +1,465 @@
+#include "MessageLog.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // On-disk record header, followed by sender, scope and text and padded
+    // to 8 bytes. Native byte order: segments are not meant to move between
+    // machines.
+    struct RecordHeader
+    {
+        uint32_t length;   // Whole record, padding included; 0 marks the end
+        uint32_t checksum; // FNV-1a of everything after this field, padding excluded
+        uint64_t sequence;
+        int64_t timeMs;
+        uint32_t textLength;
+        uint16_t senderLength;
+        uint16_t scopeLength;
+        uint8_t kind;
+        uint8_t reserved[7];
+    };
+    static_assert(sizeof(RecordHeader) == 40, "RecordHeader layout");
+
+    constexpr size_t CHECKSUM_FROM = offsetof(RecordHeader, sequence);
+
+    uint32_t checksum(const char *data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    size_t unpaddedLength(const RecordHeader &header)
+    {
+        return sizeof(RecordHeader) + header.senderLength + header.scopeLength + header.textLength;
+    }
+
+    MessageLog::Entry decode(const char *record)
+    {
+        RecordHeader header;
+        std::memcpy(&header, record, sizeof(header));
+        const char *body = record + sizeof(header);
+        return {header.sequence, header.timeMs, static_cast<MessageLog::Kind>(header.kind),
+                std::string_view(body, header.senderLength),
+                std::string_view(body + header.senderLength, header.scopeLength),
+                std::string_view(body + header.senderLength + header.scopeLength, header.textLength)};
+    }
+
+    std::string segmentPath(const std::string &directory, uint64_t firstSequence)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%020llu.log", static_cast<unsigned long long>(firstSequence));
+        return directory + "/" + name;
+    }
+}
+
+MessageLog::Segment::~Segment()
+{
+#ifndef _WIN32
+    if (base)
+    {
+        munmap(base, capacity);
+    }
+#endif
+}
+
+MessageLog::MessageLog(std::string dir)
+    : directory(std::move(dir))
+{
+}
+
+MessageLog::~MessageLog()
+{
+    close();
+}
+
+#ifndef _WIN32
+std::shared_ptr<MessageLog::Segment> MessageLog::mapSegment(const std::string &path, uint64_t firstSequence, bool create)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+    if (fd == -1)
+    {
+        Log::error("History: cannot open ", path, ": ", errno);
+        return nullptr;
+    }
+
+    // Every segment has the same fixed size, with its blocks reserved up
+    // front: a store into a sparse mapping on a full disk raises SIGBUS
+    int error = posix_fallocate(fd, 0, HISTORY_SEGMENT_SIZE);
+    if (error != 0)
+    {
+        Log::error("History: cannot allocate ", path, ": ", error);
+        ::close(fd);
+        if (create)
+        {
+            unlink(path.c_str());
+        }
+        return nullptr;
+    }
+
+    void *mapped = mmap(nullptr, HISTORY_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); // The mapping keeps the file open
+    if (mapped == MAP_FAILED)
+    {
+        Log::error("History: cannot map ", path, ": ", errno);
+        return nullptr;
+    }
+
+    auto segment = std::make_shared<Segment>();
+    segment->path = path;
+    segment->firstSequence = firstSequence;
+    segment->base = static_cast<char *>(mapped);
+    segment->capacity = HISTORY_SEGMENT_SIZE;
+    return segment;
+}
+#else
+std::shared_ptr<MessageLog::Segment> MessageLog::mapSegment(const std::string &, uint64_t, bool)
+{
+    return nullptr;
+}
+#endif
+
+void MessageLog::recover(Segment &segment)
+{
+    // Valid records are contiguous and numbered consecutively; the first one
+    // that is not ends the segment (a torn write, or never written)
+    uint64_t expected = segment.firstSequence;
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= segment.capacity)
+    {
+        RecordHeader header;
+        std::memcpy(&header, segment.base + offset, sizeof(header));
+        if (header.length < sizeof(RecordHeader) || header.length > segment.capacity - offset ||
+            header.sequence != expected || unpaddedLength(header) > header.length ||
+            header.checksum != checksum(segment.base + offset + CHECKSUM_FROM, unpaddedLength(header) - CHECKSUM_FROM))
+        {
+            break;
+        }
+
+        if (segment.records % HISTORY_INDEX_INTERVAL == 0)
+        {
+            segment.index.push_back({header.sequence, static_cast<uint32_t>(offset)});
+        }
+        ++segment.records;
+        ++expected;
+        offset += header.length;
+    }
+
+    segment.committed.store(static_cast<uint32_t>(offset), std::memory_order_release);
+    segment.synced = static_cast<uint32_t>(offset);
+}
+
+bool MessageLog::open()
+{
+#ifdef _WIN32
+    Log::warn("History: memory-mapped segments are not supported on Windows");
+    return false;
+#else
+    if (mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST)
+    {
+        Log::error("History: cannot create ", directory, ": ", errno);
+        return false;
+    }
+
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        Log::error("History: cannot read ", directory, ": ", errno);
+        return false;
+    }
+    std::vector<uint64_t> found;
+    while (dirent *item = readdir(dir))
+    {
+        std::string_view name = item->d_name;
+        if (name.size() == 24 && name.substr(20) == ".log" &&
+            std::all_of(name.begin(), name.begin() + 20, [](char c)
+                        { return c >= '0' && c <= '9'; }))
+        {
+            found.push_back(std::strtoull(item->d_name, nullptr, 10));
+        }
+    }
+    closedir(dir);
+    std::sort(found.begin(), found.end());
+
+    for (uint64_t firstSequence : found)
+    {
+        auto segment = mapSegment(segmentPath(directory, firstSequence), firstSequence, false);
+        if (!segment)
+        {
+            segments.clear();
+            return false;
+        }
+        recover(*segment);
+        segments.push_back(std::move(segment));
+    }
+
+    if (!segments.empty())
+    {
+        const Segment &last = *segments.back();
+        nextSequence.store(last.firstSequence + last.records, std::memory_order_relaxed);
+    }
+    else if (!rollSegment(1))
+    {
+        return false;
+    }
+
+    Log::info("History: ", directory, ", ", segments.size(), " segment(s), last message #", lastSequence());
+    writer = std::thread(&MessageLog::run, this);
+    return true;
+#endif
+}
+
+void MessageLog::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    pendingReady.notify_one();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+
+    std::lock_guard<std::mutex> lock(segmentsMutex);
+    segments.clear();
+}
+
+bool MessageLog::append(Kind kind, std::string_view sender, std::string_view scope, std::string_view text)
+{
+    RecordHeader header{};
+    header.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    header.textLength = static_cast<uint32_t>(text.size());
+    header.senderLength = static_cast<uint16_t>(std::min<size_t>(sender.size(), UINT16_MAX));
+    header.scopeLength = static_cast<uint16_t>(std::min<size_t>(scope.size(), UINT16_MAX));
+    header.kind = static_cast<uint8_t>(kind);
+    size_t unpadded = unpaddedLength(header);
+    header.length = static_cast<uint32_t>((unpadded + 7) & ~size_t(7));
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    if (stopping || disabled || pending.size() + header.length > HISTORY_MAX_PENDING)
+    {
+        return false;
+    }
+    header.sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+
+    // Encoded in place; the writer only copies and checksums
+    size_t at = pending.size();
+    pending.resize(at + header.length);
+    char *record = &pending[at];
+    char *body = record + sizeof(header);
+    std::memcpy(body, sender.data(), header.senderLength);
+    body += header.senderLength;
+    std::memcpy(body, scope.data(), header.scopeLength);
+    body += header.scopeLength;
+    std::memcpy(body, text.data(), text.size());
+    std::memcpy(record, &header, sizeof(header));
+
+    if (at == 0)
+    {
+        pendingReady.notify_one();
+    }
+    return true;
+}
+
+std::shared_ptr<MessageLog::Segment> MessageLog::rollSegment(uint64_t firstSequence)
+{
+    auto segment = mapSegment(segmentPath(directory, firstSequence), firstSequence, true);
+    if (!segment)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(segmentsMutex);
+    segments.push_back(segment);
+    while (segments.size() > HISTORY_MAX_SEGMENTS)
+    {
+        // Replays still holding the segment keep its mapping until they finish
+#ifndef _WIN32
+        unlink(segments.front()->path.c_str());
+#endif
+        segments.erase(segments.begin());
+    }
+    return segment;
+}
+
+void MessageLog::run()
+{
+    std::string batch;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            pendingReady.wait(lock, [this]
+                              { return stopping || !pending.empty(); });
+            if (pending.empty())
+            {
+                return; // Stopping, nothing left
+            }
+            batch.swap(pending);
+        }
+
+        // Everything appended while this batch is written and synced goes
+        // out together in the next one
+        writeBatch(batch);
+        batch.clear();
+    }
+}
+
+void MessageLog::writeBatch(const std::string &batch)
+{
+    auto sync = [](Segment &segment)
+    {
+#ifndef _WIN32
+        uint32_t end = segment.committed.load(std::memory_order_relaxed);
+        if (end == segment.synced)
+        {
+            return;
+        }
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t from = segment.synced & ~(page - 1);
+        if (msync(segment.base + from, end - from, MS_SYNC) == -1)
+        {
+            Log::limited(Log::Level::Error, "history-sync", "History: msync failed: ", errno);
+        }
+        segment.synced = end;
+#else
+        (void)segment;
+#endif
+    };
+
+    if (disabled)
+    {
+        return;
+    }
+
+    std::shared_ptr<Segment> segment;
+    {
+        std::lock_guard<std::mutex> lock(segmentsMutex);
+        segment = segments.back();
+    }
+
+    size_t offset = 0;
+    while (offset < batch.size())
+    {
+        char *record = const_cast<char *>(batch.data()) + offset;
+        RecordHeader header;
+        std::memcpy(&header, record, sizeof(header));
+        offset += header.length;
+
+        uint32_t at = segment->committed.load(std::memory_order_relaxed);
+        if (header.length > segment->capacity - at)
+        {
+            sync(*segment);
+            std::shared_ptr<Segment> next = rollSegment(header.sequence);
+            if (!next)
+            {
+                // Out of disk, most likely: stop recording rather than retry per message
+                Log::error("History: disabled, dropping messages from #", header.sequence);
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                disabled = true;
+                return;
+            }
+            segment = next;
+            at = 0;
+        }
+
+        header.checksum = checksum(record + CHECKSUM_FROM, unpaddedLength(header) - CHECKSUM_FROM);
+        std::memcpy(segment->base + at, &header, sizeof(header));
+        std::memcpy(segment->base + at + sizeof(header), record + sizeof(header), header.length - sizeof(header));
+
+        if (segment->records % HISTORY_INDEX_INTERVAL == 0)
+        {
+            std::lock_guard<std::mutex> lock(segmentsMutex);
+            segment->index.push_back({header.sequence, at});
+        }
+        ++segment->records;
+        segment->committed.store(at + header.length, std::memory_order_release);
+    }
+
+    sync(*segment);
+}
+
+void MessageLog::replay(size_t limit, const std::function<bool(const Entry &)> &filter,
+                        const std::function<void(const std::vector<Entry> &)> &visit)
+{
+    struct Found
+    {
+        const Segment *segment;
+        uint32_t offset;
+    };
+
+    std::vector<std::shared_ptr<Segment>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(segmentsMutex);
+        snapshot = segments;
+    }
+
+    // Blocks between index entries are scanned newest first; within a block
+    // records can only be walked forwards, so matches are collected and then
+    // taken from the back
+    std::vector<Found> found;
+    found.reserve(limit);
+    std::vector<uint32_t> block;
+    std::vector<IndexEntry> index;
+    size_t scanned = 0;
+    for (auto it = snapshot.rbegin(); it != snapshot.rend() && found.size() < limit && scanned < HISTORY_SCAN_LIMIT; ++it)
+    {
+        const Segment &segment = **it;
+        uint32_t end = segment.committed.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> lock(segmentsMutex);
+            index = segment.index;
+        }
+
+        for (size_t i = index.size(); i-- > 0 && found.size() < limit && scanned < HISTORY_SCAN_LIMIT;)
+        {
+            uint32_t from = index[i].offset;
+            uint32_t to = i + 1 < index.size() ? std::min(index[i + 1].offset, end) : end;
+            block.clear();
+            for (uint32_t offset = from; offset < to; ++scanned)
+            {
+                const char *record = segment.base + offset;
+                if (filter(decode(record)))
+                {
+                    block.push_back(offset);
+                }
+                uint32_t length;
+                std::memcpy(&length, record, sizeof(length));
+                offset += length;
+            }
+            for (size_t j = block.size(); j-- > 0 && found.size() < limit;)
+            {
+                found.push_back({&segment, block[j]});
+            }
+        }
+    }
+
+    std::vector<Entry> entries;
+    entries.reserve(found.size());
+    for (size_t k = found.size(); k-- > 0;)
+    {
+        entries.push_back(decode(found[k].segment->base + found[k].offset));
+    }
+    visit(entries);
+}
@@ -0,0 +1,109 @@
+#ifndef MESSAGELOG_H
+#define MESSAGELOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "serverDefaults.h"
+
+// Append-only history of room messages and DMs, kept in fixed-size segment
+// files that are memory-mapped for both writing and replay.
+//
+// append() only copies the record into a pending buffer; a writer thread
+// moves whole batches into the mapped segment and then syncs them with one
+// msync (group commit), so a broadcast never waits on the disk. Each segment
+// keeps a sparse index (every HISTORY_INDEX_INTERVAL records) so replay can
+// walk the log backwards a block at a time. Records carry a checksum; on
+// open, each segment is scanned and a torn tail is ignored.
+class MessageLog
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Room = 1,  // scope is the room name
+        Direct = 2 // scope is the recipient
+    };
+
+    // Views into a mapped segment, valid for the duration of the visit
+    struct Entry
+    {
+        uint64_t sequence;
+        int64_t timeMs; // Unix time
+        Kind kind;
+        std::string_view sender;
+        std::string_view scope;
+        std::string_view text;
+    };
+
+    explicit MessageLog(std::string directory);
+    ~MessageLog();
+
+    MessageLog(const MessageLog &) = delete;
+    MessageLog &operator=(const MessageLog &) = delete;
+
+    // Maps the existing segments (or creates the first) and starts the writer
+    bool open();
+    // Writes and syncs what is pending, then unmaps everything
+    void close();
+
+    // Queues one record; false if the pending buffer is full or history was
+    // disabled, and it was dropped
+    bool append(Kind kind, std::string_view sender, std::string_view scope, std::string_view text);
+
+    // Hands visit, oldest first, the newest `limit` entries that `filter`
+    // accepts, all in one call so the caller can size its reply up front.
+    // Looks at no more than HISTORY_SCAN_LIMIT records.
+    void replay(size_t limit, const std::function<bool(const Entry &)> &filter,
+                const std::function<void(const std::vector<Entry> &)> &visit);
+
+    uint64_t lastSequence() const { return nextSequence.load(std::memory_order_relaxed) - 1; }
+
+private:
+    struct IndexEntry
+    {
+        uint64_t sequence;
+        uint32_t offset;
+    };
+
+    struct Segment
+    {
+        std::string path;
+        uint64_t firstSequence;
+        char *base = nullptr;
+        size_t capacity = 0;
+        std::atomic<uint32_t> committed{0}; // Bytes readers may look at
+        uint32_t synced = 0;                // Writer's side
+        uint32_t records = 0;               // Writer's side
+        std::vector<IndexEntry> index;      // Guarded by segmentsMutex
+
+        ~Segment();
+    };
+
+    std::string directory;
+    std::vector<std::shared_ptr<Segment>> segments; // Oldest first; the last one is written
+    std::mutex segmentsMutex;
+
+    std::string pending; // Encoded records waiting for the writer
+    std::mutex pendingMutex;
+    std::condition_variable pendingReady;
+    std::atomic<uint64_t> nextSequence{1};
+    bool stopping = false;
+    bool disabled = false; // A new segment could not be allocated; appends are refused
+    std::thread writer;
+
+    std::shared_ptr<Segment> mapSegment(const std::string &path, uint64_t firstSequence, bool create);
+    void recover(Segment &segment);
+    std::shared_ptr<Segment> rollSegment(uint64_t firstSequence);
+    void run();
+    void writeBatch(const std::string &batch);
+};
+
+#endif
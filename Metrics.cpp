@@ -0,0 +1,400 @@
+#include "Metrics.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+    constexpr size_t COUNTERS = static_cast<size_t>(Metrics::Counter::Count);
+    constexpr size_t HISTOGRAMS = static_cast<size_t>(Metrics::Histogram::Count);
+    constexpr size_t BUCKETS = 40; // Bucket i holds durations in [2^i, 2^(i+1)) ns
+
+    struct Description
+    {
+        const char *name;
+        const char *help;
+    };
+
+    const Description counterNames[COUNTERS] = {
+        {"connections_opened", "Connections accepted"},
+        {"connections_closed", "Connections closed"},
+        {"logins", "Successful LOGINs"},
+        {"login_failures", "Refused LOGINs"},
+        {"bytes_in", "Bytes received from clients"},
+        {"bytes_out", "Bytes written to clients"},
+        {"send_dropped", "Messages refused by a full outbound queue"},
+        {"send_errors", "Socket writes that failed"},
+        {"slow_consumer_evictions", "Clients disconnected for not reading their output"},
+        {"idle_evictions", "Clients disconnected by the idle timeout"},
+        {"parallel_fanouts", "Broadcasts split across the fan-out pool"},
+        {"inbox_stalls", "Reads held back until the command pool caught up with a client"},
+        {"rate_limited", "Commands refused because a rate limit or the fan-out budget was exhausted"},
+    };
+
+    const Description histogramNames[HISTOGRAMS] = {
+        {"handle_message", "Time to parse and run one command"},
+        {"broadcast", "Time to fan one message out to its recipients"},
+    };
+
+    // One thread's counts. Only the owning thread writes, so updates are a
+    // relaxed load and store rather than a locked read-modify-write.
+    struct Slab
+    {
+        std::atomic<uint64_t> counters[COUNTERS] = {};
+        std::atomic<uint64_t> commands[Metrics::MAX_COMMANDS] = {};
+        std::atomic<uint64_t> buckets[HISTOGRAMS][BUCKETS] = {};
+        std::atomic<uint64_t> sums[HISTOGRAMS] = {}; // Nanoseconds
+    };
+
+    struct Totals
+    {
+        uint64_t counters[COUNTERS] = {};
+        uint64_t commands[Metrics::MAX_COMMANDS] = {};
+        uint64_t buckets[HISTOGRAMS][BUCKETS] = {};
+        uint64_t sums[HISTOGRAMS] = {};
+
+        void add(const Slab &slab)
+        {
+            for (size_t i = 0; i < COUNTERS; ++i)
+                counters[i] += slab.counters[i].load(std::memory_order_relaxed);
+            for (size_t i = 0; i < Metrics::MAX_COMMANDS; ++i)
+                commands[i] += slab.commands[i].load(std::memory_order_relaxed);
+            for (size_t h = 0; h < HISTOGRAMS; ++h)
+            {
+                for (size_t b = 0; b < BUCKETS; ++b)
+                    buckets[h][b] += slab.buckets[h][b].load(std::memory_order_relaxed);
+                sums[h] += slab.sums[h].load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<const Slab *> live;
+        Totals retired; // Threads that have exited
+        std::vector<std::string> commandNames{"unknown"};
+    };
+
+    // Never destroyed: threads may still exit after static destructors ran
+    Registry &registry()
+    {
+        static Registry *instance = new Registry();
+        return *instance;
+    }
+
+    struct LocalSlab
+    {
+        Slab slab;
+
+        LocalSlab()
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.live.push_back(&slab);
+        }
+
+        ~LocalSlab()
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.retired.add(slab);
+            r.live.erase(std::find(r.live.begin(), r.live.end(), &slab));
+        }
+    };
+
+    Slab &localSlab()
+    {
+        thread_local LocalSlab local;
+        return local.slab;
+    }
+
+    inline void bump(std::atomic<uint64_t> &cell, uint64_t amount)
+    {
+        cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    size_t bucketFor(uint64_t ns)
+    {
+        size_t bucket = 0;
+        while (ns > 1 && bucket < BUCKETS - 1)
+        {
+            ns >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    Totals collect(std::vector<std::string> &commandNames)
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        Totals totals = r.retired;
+        for (const Slab *slab : r.live)
+        {
+            totals.add(*slab);
+        }
+        commandNames = r.commandNames;
+        return totals;
+    }
+
+    // Upper bound of the bucket holding the given fraction of samples, in ns
+    double percentile(const uint64_t (&buckets)[BUCKETS], uint64_t count, double fraction)
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = std::min(static_cast<uint64_t>(fraction * count), count - 1);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            seen += buckets[b];
+            if (seen > rank)
+            {
+                return static_cast<double>(uint64_t(1) << (b + 1));
+            }
+        }
+        return static_cast<double>(uint64_t(1) << BUCKETS);
+    }
+
+    uint64_t countOf(const uint64_t (&buckets)[BUCKETS])
+    {
+        uint64_t count = 0;
+        for (uint64_t n : buckets)
+            count += n;
+        return count;
+    }
+}
+
+void Metrics::add(Counter counter, uint64_t amount)
+{
+    bump(localSlab().counters[static_cast<size_t>(counter)], amount);
+}
+
+void Metrics::observe(Histogram histogram, std::chrono::steady_clock::duration elapsed)
+{
+    uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    Slab &slab = localSlab();
+    size_t h = static_cast<size_t>(histogram);
+    bump(slab.buckets[h][bucketFor(ns)], 1);
+    bump(slab.sums[h], ns);
+}
+
+size_t Metrics::commandSlot(std::string_view name)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t i = 1; i < r.commandNames.size(); ++i)
+    {
+        if (r.commandNames[i] == name)
+        {
+            return i;
+        }
+    }
+    if (r.commandNames.size() == MAX_COMMANDS)
+    {
+        return 0;
+    }
+    r.commandNames.emplace_back(name);
+    return r.commandNames.size() - 1;
+}
+
+void Metrics::countCommand(size_t slot)
+{
+    bump(localSlab().commands[slot < MAX_COMMANDS ? slot : 0], 1);
+}
+
+std::string Metrics::renderText(const std::vector<Gauge> &gauges)
+{
+    std::vector<std::string> commandNames;
+    Totals totals = collect(commandNames);
+    std::ostringstream out;
+
+    for (size_t i = 0; i < COUNTERS; ++i)
+    {
+        out << "# HELP chattcp_" << counterNames[i].name << "_total " << counterNames[i].help << "\n"
+            << "# TYPE chattcp_" << counterNames[i].name << "_total counter\n"
+            << "chattcp_" << counterNames[i].name << "_total " << totals.counters[i] << "\n";
+    }
+
+    out << "# HELP chattcp_commands_total Commands received, by name\n"
+        << "# TYPE chattcp_commands_total counter\n";
+    for (size_t i = 0; i < commandNames.size(); ++i)
+    {
+        out << "chattcp_commands_total{command=\"" << commandNames[i] << "\"} " << totals.commands[i] << "\n";
+    }
+
+    for (size_t h = 0; h < HISTOGRAMS; ++h)
+    {
+        std::string name = std::string("chattcp_") + histogramNames[h].name + "_seconds";
+        out << "# HELP " << name << " " << histogramNames[h].help << "\n"
+            << "# TYPE " << name << " histogram\n";
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            cumulative += totals.buckets[h][b];
+            out << name << "_bucket{le=\"" << static_cast<double>(uint64_t(1) << (b + 1)) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n"
+            << name << "_sum " << totals.sums[h] / 1e9 << "\n"
+            << name << "_count " << cumulative << "\n";
+    }
+
+    for (const Gauge &gauge : gauges)
+    {
+        out << "# HELP chattcp_" << gauge.name << " " << gauge.help << "\n"
+            << "# TYPE chattcp_" << gauge.name << " gauge\n"
+            << "chattcp_" << gauge.name << " " << gauge.value << "\n";
+    }
+    return out.str();
+}
+
+std::vector<std::string> Metrics::renderStatLines(const std::vector<Gauge> &gauges)
+{
+    std::vector<std::string> commandNames;
+    Totals totals = collect(commandNames);
+    std::vector<std::string> lines;
+
+    auto stat = [&lines](const std::string &name, double value)
+    {
+        std::ostringstream line;
+        line << "STAT " << name << " " << value;
+        lines.push_back(line.str());
+    };
+
+    for (const Gauge &gauge : gauges)
+    {
+        stat(gauge.name, gauge.value);
+    }
+    for (size_t i = 0; i < COUNTERS; ++i)
+    {
+        stat(counterNames[i].name, static_cast<double>(totals.counters[i]));
+    }
+    for (size_t i = 0; i < commandNames.size(); ++i)
+    {
+        std::string name = commandNames[i];
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        stat("command_" + name, static_cast<double>(totals.commands[i]));
+    }
+    for (size_t h = 0; h < HISTOGRAMS; ++h)
+    {
+        std::string name = histogramNames[h].name;
+        uint64_t count = countOf(totals.buckets[h]);
+        stat(name + "_count", static_cast<double>(count));
+        stat(name + "_p50_us", percentile(totals.buckets[h], count, 0.50) / 1000);
+        stat(name + "_p99_us", percentile(totals.buckets[h], count, 0.99) / 1000);
+        stat(name + "_max_us", percentile(totals.buckets[h], count, 1.0) / 1000);
+    }
+    return lines;
+}
+
+MetricsEndpoint::MetricsEndpoint(int listenPort, std::function<std::string()> renderer)
+    : port(listenPort), render(std::move(renderer)), listener(INVALID_SOCKET), running(false)
+{
+}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    stop();
+}
+
+bool MetricsEndpoint::start()
+{
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+    {
+        Log::error("Metrics endpoint: socket creation failed");
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&opt), sizeof(opt));
+
+    // Loopback only: the numbers are for local scrapers, not the chat network
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(listener, SOMAXCONN) == SOCKET_ERROR)
+    {
+        Log::error("Metrics endpoint: cannot listen on 127.0.0.1:", port, ": ", lastSocketError());
+        closesocket(listener);
+        listener = INVALID_SOCKET;
+        return false;
+    }
+
+    running = true;
+    thread = std::thread(&MetricsEndpoint::run, this);
+    Log::info("Metrics on 127.0.0.1:", port);
+    return true;
+}
+
+void MetricsEndpoint::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    closesocket(listener);
+    listener = INVALID_SOCKET;
+}
+
+void MetricsEndpoint::run()
+{
+    while (running)
+    {
+        // Wakes up regularly so stop() does not wait on accept()
+        pollfd pfd{listener, POLLIN, 0};
+        if (pollSockets(&pfd, 1, METRICS_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        SOCKET connection = accept(listener, nullptr, nullptr);
+        if (connection != INVALID_SOCKET)
+        {
+            serve(connection);
+            closesocket(connection);
+        }
+    }
+}
+
+void MetricsEndpoint::serve(SOCKET connection)
+{
+    char request[1024];
+    int received = 0;
+    pollfd pfd{connection, POLLIN, 0};
+    if (pollSockets(&pfd, 1, METRICS_POLL_MS) > 0)
+    {
+        received = recv(connection, request, sizeof(request), 0);
+    }
+
+    std::string body = render();
+    std::string response;
+    if (received >= 3 && std::string_view(request, 3) == "GET")
+    {
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    }
+    response += body;
+
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+        int n = send(connection, response.data() + sent, static_cast<int>(response.size() - sent), MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
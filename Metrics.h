@@ -0,0 +1,112 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "socketCompat.h"
+#include "serverDefaults.h"
+
+// Process-wide counters and latency histograms. Every thread records into
+// its own slab with plain relaxed stores, so instrumenting a hot path costs
+// an increment and never contends; readers (STATS, the scrape endpoint) add
+// the slabs up. A thread's totals are folded in when it exits.
+namespace Metrics
+{
+    enum class Counter
+    {
+        ConnectionsOpened,
+        ConnectionsClosed,
+        Logins,
+        LoginFailures,
+        BytesIn,
+        BytesOut,
+        SendDropped,           // Refused by a full outbound queue
+        SendErrors,            // Socket writes that failed
+        SlowConsumerEvictions, // Disconnected for not reading their output
+        IdleEvictions,         // Disconnected by the idle timeout
+        ParallelFanouts,       // Broadcasts split across the fan-out pool
+        InboxStalls,           // Reads held back until the command pool caught up
+        RateLimited,           // Commands refused with ERR rate-limited
+        Count
+    };
+
+    enum class Histogram
+    {
+        HandleMessage, // Parsing and running one command line or frame
+        Broadcast,     // Fanning one message out to its recipients
+        Count
+    };
+
+    // Per-command counts; slot 0 collects unknown commands
+    constexpr size_t MAX_COMMANDS = COMMAND_TABLE_SIZE + 1;
+
+    void add(Counter counter, uint64_t amount = 1);
+    void observe(Histogram histogram, std::chrono::steady_clock::duration elapsed);
+
+    // Slot for a command name, registered on first use; 0 once all are taken
+    size_t commandSlot(std::string_view name);
+    void countCommand(size_t slot);
+
+    // Records the lifetime of the scope into a histogram
+    class ScopedTimer
+    {
+    private:
+        Histogram histogram;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit ScopedTimer(Histogram target)
+            : histogram(target), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer()
+        {
+            observe(histogram, std::chrono::steady_clock::now() - start);
+        }
+    };
+
+    // Point-in-time values the caller computes when metrics are read
+    struct Gauge
+    {
+        std::string name;
+        std::string help;
+        double value;
+    };
+
+    // Prometheus text exposition format, for the scrape endpoint
+    std::string renderText(const std::vector<Gauge> &gauges);
+
+    // "STAT <name> <value>" lines for the STATS command; histograms are
+    // summarized as count, p50, p99 and max in microseconds
+    std::vector<std::string> renderStatLines(const std::vector<Gauge> &gauges);
+}
+
+// Serves the metrics text on a loopback-only port, one connection at a time.
+// A request starting with "GET" gets an HTTP/1.0 response, anything else
+// (or nothing, within a short wait) the bare text.
+class MetricsEndpoint
+{
+private:
+    int port;
+    std::function<std::string()> render;
+    SOCKET listener;
+    std::atomic<bool> running;
+    std::thread thread;
+
+    void run();
+    void serve(SOCKET connection);
+
+public:
+    MetricsEndpoint(int listenPort, std::function<std::string()> renderer);
+    ~MetricsEndpoint();
+
+    bool start();
+    void stop();
+};
+
+#endif
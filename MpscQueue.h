@@ -0,0 +1,68 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Lock-free multi-producer / single-consumer queue (Vyukov's intrusive design).
+// Any thread may push(); only the owning thread may pop(). A push that is still
+// linking its node can make pop() report empty briefly, so producers must wake
+// the consumer after pushing rather than relying on it to spin.
+template <typename T>
+class MpscQueue
+{
+private:
+    struct Node
+    {
+        std::atomic<Node *> next;
+        T value;
+
+        Node() : next(nullptr), value() {}
+        explicit Node(T &&v) : next(nullptr), value(std::move(v)) {}
+    };
+
+    std::atomic<Node *> head; // Producers append here
+    Node *tail;               // Consumer-owned; always points at a spent node
+
+public:
+    MpscQueue()
+    {
+        Node *stub = new Node();
+        head.store(stub, std::memory_order_relaxed);
+        tail = stub;
+    }
+
+    ~MpscQueue()
+    {
+        T discarded;
+        while (pop(discarded))
+        {
+        }
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(T value)
+    {
+        Node *node = new Node(std::move(value));
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T &out)
+    {
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            return false;
+        }
+        out = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+};
+
+#endif
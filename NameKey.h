@@ -0,0 +1,50 @@
+#ifndef NAMEKEY_H
+#define NAMEKEY_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Key for the username-indexed hash maps that lets them be searched with a
+// string_view. C++17 unordered containers have no transparent lookup, so the
+// key carries both forms: a stored key owns its name, while NameKey::view()
+// wraps the caller's bytes for find() and count() without copying them.
+class NameKey
+{
+private:
+    std::string owned;
+    std::string_view name; // Into owned, or the caller's bytes for a probe
+    bool owning;
+
+    NameKey(std::string_view probe, bool) : name(probe), owning(false) {}
+
+public:
+    NameKey(std::string value) : owned(std::move(value)), name(owned), owning(true) {}
+    NameKey(const NameKey &other)
+        : owned(other.owned), name(other.owning ? std::string_view(owned) : other.name), owning(other.owning)
+    {
+    }
+    NameKey(NameKey &&other) noexcept
+        : owned(std::move(other.owned)), name(other.owning ? std::string_view(owned) : other.name), owning(other.owning)
+    {
+        other.name = other.owned;
+    }
+    NameKey &operator=(const NameKey &) = delete;
+
+    // A lookup key; valid only as long as the viewed bytes
+    static NameKey view(std::string_view probe) { return NameKey(probe, false); }
+
+    const std::string &str() const { return owned; } // Stored keys only
+    std::string_view get() const { return name; }
+
+    bool operator==(const NameKey &other) const { return name == other.name; }
+
+    struct Hash
+    {
+        size_t operator()(const NameKey &key) const noexcept { return std::hash<std::string_view>()(key.name); }
+    };
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "WireBuffer.h"
+
+// FIFO of shared wire buffers backed by a power-of-two ring. It only allocates
+// when a client's backlog outgrows every earlier one, so steady-state fan-out
+// queues a message without touching the heap. Not thread-safe; Client guards
+// it with sendMutex.
+class OutboundQueue
+{
+private:
+    std::vector<WireRef> slots;
+    size_t head;
+    size_t count;
+
+public:
+    OutboundQueue() : head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    const WireRef &front() const { return slots[head]; }
+    const WireRef &at(size_t index) const { return slots[(head + index) & (slots.size() - 1)]; }
+
+    void push_back(const WireRef &ref)
+    {
+        if (count == slots.size())
+        {
+            grow();
+        }
+        slots[(head + count) & (slots.size() - 1)] = ref;
+        ++count;
+    }
+
+    void pop_front()
+    {
+        slots[head] = WireRef();
+        head = (head + 1) & (slots.size() - 1);
+        --count;
+    }
+
+    void clear()
+    {
+        while (count > 0)
+        {
+            pop_front();
+        }
+        head = 0;
+    }
+
+private:
+    void grow()
+    {
+        std::vector<WireRef> larger(slots.empty() ? 8 : slots.size() * 2);
+        for (size_t i = 0; i < count; ++i)
+        {
+            larger[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+        }
+        slots.swap(larger);
+        head = 0;
+    }
+};
+
+#endif
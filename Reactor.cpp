@@ -0,0 +1,409 @@
+#include "Reactor.h"
+
+#ifdef __linux__
+
+#include "ChatServer.h"
+#include "ClientPool.h"
+#include "Logger.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+
+static thread_local int runningShard = -1;
+
+static const uint32_t CLIENT_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+Reactor::Reactor(ChatServer *srv, SOCKET listener, int shard, int cpu)
+    : server(srv), listenSocket(listener), shardIndex(shard), pinnedCpu(cpu),
+      epollFd(-1), wakeFd(-1), running(false), wakePending(false)
+{
+}
+
+Reactor::~Reactor()
+{
+    if (wakeFd != -1)
+    {
+        ::close(wakeFd);
+    }
+    if (epollFd != -1)
+    {
+        ::close(epollFd);
+    }
+}
+
+bool Reactor::initialize()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1)
+    {
+        Log::error("epoll_create1 failed: ", errno);
+        return false;
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd == -1)
+    {
+        Log::error("eventfd failed: ", errno);
+        return false;
+    }
+
+    if (!setNonBlocking(listenSocket))
+    {
+        Log::error("Failed to make listening socket non-blocking: ", errno);
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listenSocket;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &ev) == -1)
+    {
+        Log::error("epoll_ctl(listener) failed: ", errno);
+        return false;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) == -1)
+    {
+        Log::error("epoll_ctl(eventfd) failed: ", errno);
+        return false;
+    }
+
+    return true;
+}
+
+int Reactor::currentShard()
+{
+    return runningShard;
+}
+
+void Reactor::run()
+{
+    running = true;
+    runningShard = shardIndex;
+    epoll_event events[REACTOR_MAX_EVENTS];
+
+    if (pinnedCpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(pinnedCpu, &cpus);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0)
+        {
+            Log::warn("Shard ", shardIndex, ": CPU pinning failed: ", result);
+        }
+    }
+
+    while (running)
+    {
+        // Connections cut short last turn are still readable: only poll
+        int count = epoll_wait(epollFd, events, REACTOR_MAX_EVENTS, readyList.empty() ? -1 : 0);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Log::limited(Log::Level::Error, "epoll-wait", "epoll_wait failed: ", errno);
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            SOCKET fd = events[i].data.fd;
+
+            if (fd == listenSocket)
+            {
+                acceptConnections();
+            }
+            else if (fd == wakeFd)
+            {
+                uint64_t value;
+                (void)!::read(wakeFd, &value, sizeof(value));
+                wakePending = false;
+                drainInbox();
+            }
+            else
+            {
+                if (events[i].events & EPOLLOUT)
+                {
+                    handleWritable(fd);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                {
+                    handleReadable(fd);
+                }
+            }
+        }
+
+        serveReadyList();
+    }
+
+    running = false;
+    runningShard = -1;
+}
+
+void Reactor::stop()
+{
+    running = false;
+    if (wakeFd != -1)
+    {
+        uint64_t one = 1;
+        (void)!::write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void Reactor::post(ShardTask task)
+{
+    inbox.push(std::move(task));
+
+    // One eventfd write per batch of posts; cleared by the shard before draining
+    if (!wakePending.exchange(true))
+    {
+        uint64_t one = 1;
+        (void)!::write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void Reactor::drainInbox()
+{
+    ShardTask task;
+    while (inbox.pop(task))
+    {
+        if (task.resumeReading)
+        {
+            continueReading(task.target);
+        }
+        else if (task.target)
+        {
+            task.target->sendWire(task.payload);
+        }
+        else if (task.members)
+        {
+            deliverLocal(*task.members, task.payload, task.excludeUsername);
+        }
+        else
+        {
+            broadcastLocal(task.payload, task.excludeUsername);
+        }
+    }
+}
+
+void Reactor::broadcastLocal(const WireRef &payload, std::string_view excludeUsername)
+{
+    for (auto &entry : connections)
+    {
+        Client &client = *entry.second;
+        if (client.isAuthenticated() && !client.hasUsername(excludeUsername))
+        {
+            client.sendWire(payload);
+        }
+    }
+}
+
+void Reactor::deliverLocal(const ClientRoster::Members &members, const WireRef &payload, std::string_view excludeUsername)
+{
+    for (auto &client : members)
+    {
+        if (client->getShard() == shardIndex && client->isAuthenticated() && !client->hasUsername(excludeUsername))
+        {
+            client->sendWire(payload);
+        }
+    }
+}
+
+void Reactor::acceptConnections()
+{
+    // Edge-triggered listener: accept until the backlog is empty
+    while (true)
+    {
+        sockaddr_in clientAddr;
+        socklen_t clientAddrSize = sizeof(clientAddr);
+        SOCKET clientSocket = accept4(listenSocket, (sockaddr *)&clientAddr, &clientAddrSize,
+                                      SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (clientSocket == INVALID_SOCKET)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (!socketWouldBlock() && running)
+            {
+                Log::limited(Log::Level::Error, "accept", "Accept failed: ", errno);
+            }
+            return;
+        }
+
+        char clientIP[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
+        Log::info("New connection from ", clientIP);
+
+        addConnection(clientSocket);
+    }
+}
+
+std::shared_ptr<Client> Reactor::adopt(SOCKET socket)
+{
+    // io_uring leaves its sockets blocking
+    if (!setNonBlocking(socket))
+    {
+        closesocket(socket);
+        return nullptr;
+    }
+    return addConnection(socket);
+}
+
+void Reactor::drainPending()
+{
+    drainInbox();
+}
+
+std::shared_ptr<Client> Reactor::addConnection(SOCKET socket)
+{
+    auto client = ClientPool::make<Client>(socket, server);
+    client->setShard(shardIndex);
+
+    epoll_event ev{};
+    // EPOLLOUT edges only arrive after a write hit EAGAIN, so it costs nothing
+    // until a client falls behind. Data already waiting raises EPOLLIN at once.
+    ev.events = CLIENT_EVENTS;
+    ev.data.fd = socket;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, socket, &ev) == -1)
+    {
+        Log::limited(Log::Level::Error, "epoll-add-client", "epoll_ctl(client) failed: ", errno);
+        return nullptr; // client's destructor closes the socket
+    }
+
+    connections[socket] = client;
+    server->addClient(client);
+    return client;
+}
+
+void Reactor::handleReadable(SOCKET fd)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end() || stalledReads.count(fd))
+    {
+        return; // A stalled connection's hangup waits until it is read again
+    }
+
+    std::shared_ptr<Client> client = it->second;
+    Client::ReadResult result;
+    bool stalled = false;
+    int reads = 0;
+
+    // Bounded, so a client that never pauses cannot hold the shard
+    do
+    {
+        lineBatch.clear();
+        result = client->readLines(lineBatch);
+
+        try
+        {
+            stalled = server->processMessages(client, lineBatch);
+        }
+        catch (const std::exception &e)
+        {
+            Log::limited(Log::Level::Error, "client-exception", "Exception handling client: ", e.what());
+            result = Client::ReadResult::Closed;
+        }
+
+        client->releaseLines();
+    } while (result == Client::ReadResult::More && !stalled && ++reads < REACTOR_READS_PER_EVENT);
+
+    if (result == Client::ReadResult::Closed)
+    {
+        closeConnection(fd);
+    }
+    else if (stalled)
+    {
+        stallReading(fd);
+    }
+    else if (result == Client::ReadResult::More)
+    {
+        // Edge-triggered: no new event comes for data already waiting
+        readyList.push_back(fd);
+    }
+}
+
+void Reactor::serveReadyList()
+{
+    // Connections added while serving this turn wait for the next one
+    readyTurn.swap(readyList);
+    for (SOCKET fd : readyTurn)
+    {
+        handleReadable(fd); // Ignores connections closed since
+    }
+    readyTurn.clear();
+}
+
+void Reactor::stallReading(SOCKET fd)
+{
+    // Left in the kernel, the input pushes back on the sender through TCP
+    if (watch(fd, false))
+    {
+        stalledReads.insert(fd);
+    }
+}
+
+void Reactor::resumeReading(const std::shared_ptr<Client> &client)
+{
+    post(ShardTask{WireRef(), client, "", nullptr, true});
+}
+
+void Reactor::continueReading(const std::shared_ptr<Client> &client)
+{
+    SOCKET fd = client->getSocket();
+    auto it = connections.find(fd);
+    if (it == connections.end() || it->second != client || stalledReads.erase(fd) == 0)
+    {
+        return; // Closed since, or never stalled (input replayed by a hot restart)
+    }
+    watch(fd, true);
+    readyList.push_back(fd); // What arrived meanwhile raised no edge
+}
+
+bool Reactor::watch(SOCKET fd, bool readable)
+{
+    epoll_event ev{};
+    ev.events = readable ? CLIENT_EVENTS : CLIENT_EVENTS & ~EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == -1)
+    {
+        Log::limited(Log::Level::Error, "epoll-mod-client", "epoll_ctl(client) failed: ", errno);
+        return false;
+    }
+    return true;
+}
+
+void Reactor::handleWritable(SOCKET fd)
+{
+    auto it = connections.find(fd);
+    if (it != connections.end())
+    {
+        it->second->flushOutbound(); // A failed write shuts the socket; EPOLLIN then closes it
+    }
+}
+
+void Reactor::closeConnection(SOCKET fd)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end())
+    {
+        return;
+    }
+
+    std::shared_ptr<Client> client = it->second;
+    connections.erase(it);
+    stalledReads.erase(fd);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+    server->disconnectClient(client);
+    client->close();
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#ifdef __linux__
+
+#include "Client.h"
+#include "IoBackend.h"
+#include "MpscQueue.h"
+#include "WireBuffer.h"
+#include "ClientRoster.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <atomic>
+#include <string>
+
+class ChatServer;
+
+// Work handed to a shard by another thread through its inbox
+struct ShardTask
+{
+    WireRef payload;                // Framed once, shared by every recipient
+    std::shared_ptr<Client> target; // Deliver to this client only when set
+    std::string excludeUsername;    // Otherwise broadcast, skipping this user
+    std::shared_ptr<const ClientRoster::Members> members; // Limits a broadcast to these clients (a room)
+    bool resumeReading;             // No payload: start reading target again
+};
+
+// Edge-triggered epoll event loop. Each Reactor is one shard: it owns a
+// listening socket (SO_REUSEPORT when there are several), its connection
+// table and a lock-free inbox for deliveries coming from other shards.
+class Reactor : public IoBackend
+{
+private:
+    ChatServer *server;
+    SOCKET listenSocket;
+    int shardIndex;
+    int pinnedCpu; // -1 when not pinned
+    int epollFd;
+    int wakeFd; // eventfd used to interrupt epoll_wait for stop() and posted tasks
+    std::atomic<bool> running;
+    std::atomic<bool> wakePending;
+    std::unordered_map<SOCKET, std::shared_ptr<Client>> connections;
+    MpscQueue<ShardTask> inbox;
+    std::vector<std::string_view> lineBatch; // Reused for every read
+
+    // Connections that still had input when they used up their reads for
+    // one turn; served again after every other ready connection
+    std::vector<SOCKET> readyList;
+    std::vector<SOCKET> readyTurn;
+
+    // Connections not read, with EPOLLIN disarmed, until the command pool
+    // drains their inbox
+    std::unordered_set<SOCKET> stalledReads;
+
+public:
+    Reactor(ChatServer *srv, SOCKET listener, int shard = 0, int cpu = -1);
+    ~Reactor() override;
+
+    bool initialize() override;
+    void run() override;
+    void stop() override;
+
+    const char *name() const override { return "epoll"; }
+
+    // Reads happen on the loop thread only, so stop() already releases
+    std::shared_ptr<Client> adopt(SOCKET socket) override;
+    void drainPending() override;
+
+    void resumeReading(const std::shared_ptr<Client> &client) override; // Posted to the shard
+
+    // Thread-safe: queue a task for this shard's thread
+    void post(ShardTask task);
+
+    // Shard thread only: send to every authenticated local client
+    void broadcastLocal(const WireRef &payload, std::string_view excludeUsername);
+
+    // Shard thread only: send to the members owned by this shard
+    void deliverLocal(const ClientRoster::Members &members, const WireRef &payload, std::string_view excludeUsername);
+
+    // Index of the shard running on the calling thread, or -1
+    static int currentShard();
+
+private:
+    void drainInbox();
+    void acceptConnections();
+    std::shared_ptr<Client> addConnection(SOCKET socket); // null if epoll refused it
+    void handleReadable(SOCKET fd); // Up to REACTOR_READS_PER_EVENT ring-fulls
+    void serveReadyList();
+    void stallReading(SOCKET fd);
+    void continueReading(const std::shared_ptr<Client> &client);
+    bool watch(SOCKET fd, bool readable); // EPOLL_CTL_MOD
+    void handleWritable(SOCKET fd);
+    void closeConnection(SOCKET fd);
+};
+
+#endif
+
+#endif
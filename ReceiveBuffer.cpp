@@ -0,0 +1,284 @@
+#include "ReceiveBuffer.h"
+#include <cstring>
+
+#define RING_MASK (RECV_BUFFER_SIZE - 1)
+#define FRAME_LENGTH_SIZE 4 // Big-endian u32 before every binary frame
+
+// A partial frame larger than this is moved out of the ring as it arrives.
+// Keeping one backend chunk of headroom means append() always finds room
+// after release().
+#define FRAME_SPILL_THRESHOLD (RECV_BUFFER_SIZE - MAX_BUFFER_SIZE)
+
+ReceiveBuffer::ReceiveBuffer()
+    : head(0), tail(0), scan(0), lineStart(0), discarding(false), spillRemaining(0)
+{
+}
+
+char *ReceiveBuffer::writableSpan(size_t &length)
+{
+    size_t used = tail - head;
+    size_t offset = tail & RING_MASK;
+    length = RECV_BUFFER_SIZE - used;
+    if (length > RECV_BUFFER_SIZE - offset)
+    {
+        length = RECV_BUFFER_SIZE - offset; // Stop at the physical end; the rest is reached next call
+    }
+    return storage + offset;
+}
+
+void ReceiveBuffer::commit(size_t length)
+{
+    tail += length;
+}
+
+size_t ReceiveBuffer::append(const char *data, size_t length)
+{
+    size_t copied = 0;
+    while (copied < length)
+    {
+        size_t space;
+        char *span = writableSpan(space);
+        if (space == 0)
+        {
+            break;
+        }
+        size_t chunk = length - copied < space ? length - copied : space;
+        std::memcpy(span, data + copied, chunk);
+        commit(chunk);
+        copied += chunk;
+    }
+    return copied;
+}
+
+bool ReceiveBuffer::extractLines(std::vector<std::string_view> &lines)
+{
+    bool ok = true;
+
+    while (scan < tail)
+    {
+        // Search the contiguous run up to the tail or the ring's physical end
+        size_t offset = scan & RING_MASK;
+        size_t run = tail - scan;
+        if (run > RECV_BUFFER_SIZE - offset)
+        {
+            run = RECV_BUFFER_SIZE - offset;
+        }
+
+        const char *newline = static_cast<const char *>(std::memchr(storage + offset, '\n', run));
+        if (!newline)
+        {
+            scan += run;
+            if (!discarding && scan - lineStart > MAX_BUFFER_SIZE)
+            {
+                discarding = true;
+                ok = false;
+            }
+            if (discarding)
+            {
+                lineStart = scan; // Nothing of this line is kept
+            }
+            continue;
+        }
+
+        size_t end = scan + (newline - (storage + offset));
+        if (!discarding)
+        {
+            if (end - lineStart > MAX_BUFFER_SIZE)
+            {
+                ok = false;
+            }
+            else
+            {
+                emitLine(lineStart, end, lines);
+            }
+        }
+        discarding = false;
+        scan = end + 1;
+        lineStart = scan;
+    }
+
+    return ok;
+}
+
+void ReceiveBuffer::emitLine(size_t start, size_t end, std::vector<std::string_view> &lines)
+{
+    size_t length = end - start;
+    if (length > 0 && storage[(end - 1) & RING_MASK] == '\r')
+    {
+        --length;
+    }
+    if (length == 0)
+    {
+        return;
+    }
+
+    size_t offset = start & RING_MASK;
+    if (offset + length <= RECV_BUFFER_SIZE)
+    {
+        lines.emplace_back(storage + offset, length);
+        return;
+    }
+
+    // The line wraps the end of the ring. At most one line per batch can, so a
+    // single scratch buffer is enough.
+    size_t first = RECV_BUFFER_SIZE - offset;
+    std::memcpy(scratch, storage + offset, first);
+    std::memcpy(scratch + first, storage, length - first);
+    lines.emplace_back(scratch, length);
+}
+
+bool ReceiveBuffer::extractFrames(std::vector<std::string_view> &frames)
+{
+    if (discarding)
+    {
+        scan = lineStart = tail;
+        return true;
+    }
+
+    while (scan < tail)
+    {
+        size_t available = tail - scan;
+
+        if (spillRemaining > 0)
+        {
+            // Move what has arrived of an oversized frame out of the ring
+            size_t take = available < spillRemaining ? available : spillRemaining;
+            std::string &frame = spilled.back();
+            size_t filled = frame.size();
+            frame.resize(filled + take);
+            copyOut(scan, take, &frame[filled]);
+            scan += take;
+            lineStart = scan;
+            spillRemaining -= take;
+            if (spillRemaining == 0)
+            {
+                frames.emplace_back(frame);
+            }
+            continue;
+        }
+
+        if (available < FRAME_LENGTH_SIZE)
+        {
+            break;
+        }
+
+        char header[FRAME_LENGTH_SIZE];
+        copyOut(scan, sizeof(header), header);
+        size_t length = 0;
+        for (char byte : header)
+        {
+            length = (length << 8) | static_cast<unsigned char>(byte);
+        }
+        if (length == 0 || length > BINARY_MAX_FRAME)
+        {
+            discarding = true;
+            scan = lineStart = tail;
+            return false;
+        }
+
+        size_t total = FRAME_LENGTH_SIZE + length;
+        if (total > FRAME_SPILL_THRESHOLD)
+        {
+            scan += FRAME_LENGTH_SIZE;
+            lineStart = scan;
+            spilled.emplace_back();
+            spilled.back().reserve(length);
+            spillRemaining = length;
+            continue;
+        }
+        if (available < total)
+        {
+            break; // Wait for the rest; it fits in the ring
+        }
+
+        size_t start = scan + FRAME_LENGTH_SIZE;
+        size_t offset = start & RING_MASK;
+        if (offset + length <= RECV_BUFFER_SIZE)
+        {
+            frames.emplace_back(storage + offset, length);
+        }
+        else
+        {
+            spilled.emplace_back(length, '\0');
+            copyOut(start, length, &spilled.back()[0]);
+            frames.emplace_back(spilled.back());
+        }
+        scan += total;
+        lineStart = scan;
+    }
+
+    return true;
+}
+
+size_t ReceiveBuffer::peek(char *out, size_t length) const
+{
+    size_t available = tail - scan;
+    if (length > available)
+    {
+        length = available;
+    }
+    copyOut(scan, length, out);
+    return length;
+}
+
+void ReceiveBuffer::discard(size_t length)
+{
+    scan += length;
+    lineStart = scan;
+}
+
+std::string ReceiveBuffer::unframed() const
+{
+    std::string bytes;
+    if (discarding)
+    {
+        return bytes; // The rest of a dropped line, or a broken frame stream
+    }
+    if (spillRemaining > 0)
+    {
+        // The oversized frame's prefix was consumed when it started spilling
+        const std::string &frame = spilled.back();
+        bytes.resize(FRAME_LENGTH_SIZE);
+        size_t length = frame.size() + spillRemaining;
+        for (int i = FRAME_LENGTH_SIZE - 1; i >= 0; --i, length >>= 8)
+        {
+            bytes[i] = static_cast<char>(length & 0xff);
+        }
+        bytes += frame;
+    }
+    size_t start = bytes.size();
+    bytes.resize(start + (tail - lineStart));
+    copyOut(lineStart, tail - lineStart, &bytes[start]);
+    return bytes;
+}
+
+void ReceiveBuffer::copyOut(size_t start, size_t length, char *out) const
+{
+    size_t offset = start & RING_MASK;
+    size_t first = RECV_BUFFER_SIZE - offset;
+    if (first >= length)
+    {
+        std::memcpy(out, storage + offset, length);
+        return;
+    }
+    std::memcpy(out, storage + offset, first);
+    std::memcpy(out + first, storage, length - first);
+}
+
+void ReceiveBuffer::release()
+{
+    head = lineStart;
+    if (spillRemaining == 0)
+    {
+        spilled.clear();
+    }
+    else if (spilled.size() > 1)
+    {
+        spilled.erase(spilled.begin(), spilled.end() - 1); // Keep the frame still being assembled
+    }
+}
+
+bool ReceiveBuffer::empty() const
+{
+    return tail == head;
+}
@@ -0,0 +1,75 @@
+#ifndef RECEIVEBUFFER_H
+#define RECEIVEBUFFER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "serverDefaults.h"
+
+// Per-connection receive ring that reassembles newline-terminated lines (or,
+// for binary-protocol connections, length-prefixed frames) from an arbitrary
+// byte stream. Complete lines are returned as string_views into the ring
+// (only a line that wraps the ring's end is copied, into scratch), so they
+// stay valid until release() is called.
+class ReceiveBuffer
+{
+private:
+    static_assert((RECV_BUFFER_SIZE & (RECV_BUFFER_SIZE - 1)) == 0, "RECV_BUFFER_SIZE must be a power of two");
+    static_assert(RECV_BUFFER_SIZE >= 2 * MAX_BUFFER_SIZE, "ring must hold a full line plus a partial one");
+
+    char storage[RECV_BUFFER_SIZE];
+    char scratch[MAX_BUFFER_SIZE];
+
+    // Monotonic stream offsets; masked to index storage
+    size_t head;      // First byte still referenced by the caller
+    size_t tail;      // One past the last byte received
+    size_t scan;      // Next byte to search for '\n'
+    size_t lineStart; // Start of the line being assembled
+    bool discarding;  // Dropping an over-long line until its newline (or a broken frame stream)
+
+    // Binary frames that wrap the ring's end, or are too big to wait in it,
+    // are assembled here; cleared by release()
+    std::deque<std::string> spilled;
+    size_t spillRemaining; // Bytes still missing from spilled.back()
+
+public:
+    ReceiveBuffer();
+
+    // Contiguous free space to receive into; length is 0 when the ring is full
+    char *writableSpan(size_t &length);
+    void commit(size_t length);
+
+    // Copies bytes in (for backends that receive into their own buffers).
+    // Returns how many bytes fit.
+    size_t append(const char *data, size_t length);
+
+    // Appends every newly completed, non-empty line (without "\r\n").
+    // Returns false if a line longer than MAX_BUFFER_SIZE had to be dropped.
+    bool extractLines(std::vector<std::string_view> &lines);
+
+    // Binary protocol: appends every newly completed frame as opcode + body
+    // (without the length prefix). Returns false, once, when a frame length is
+    // out of range; the stream cannot be resynchronized and is dropped.
+    bool extractFrames(std::vector<std::string_view> &frames);
+
+    // Unconsumed bytes, for protocol negotiation before any line is framed
+    size_t peek(char *out, size_t length) const;
+    void discard(size_t length);
+
+    // Every received byte not yet returned as a line or frame, including the
+    // length prefix of a partial frame, so another process can resume the stream
+    std::string unframed() const;
+
+    // Frees the space of all extracted lines; invalidates their views
+    void release();
+
+    bool empty() const;
+
+private:
+    void emitLine(size_t start, size_t end, std::vector<std::string_view> &lines);
+    void copyOut(size_t start, size_t length, char *out) const;
+};
+
+#endif
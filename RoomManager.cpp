@@ -0,0 +1,184 @@
+#include "RoomManager.h"
+#include "Client.h"
+#include <algorithm>
+
+Room::Room(std::string roomName)
+    : name(std::move(roomName)), members(std::make_shared<const Members>())
+{
+}
+
+const std::string &Room::getName() const
+{
+    return name;
+}
+
+std::shared_ptr<const Room::Members> Room::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return members;
+}
+
+size_t Room::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return members->size();
+}
+
+bool Room::add(const std::shared_ptr<Client> &client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &member : *members)
+    {
+        if (member == client)
+        {
+            return false;
+        }
+    }
+    auto updated = std::make_shared<Members>(*members);
+    updated->push_back(client);
+    members = std::move(updated);
+    return true;
+}
+
+bool Room::remove(const Client *client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto updated = std::make_shared<Members>();
+    updated->reserve(members->size());
+    for (auto &member : *members)
+    {
+        if (member.get() != client)
+        {
+            updated->push_back(member);
+        }
+    }
+    if (updated->size() == members->size())
+    {
+        return false;
+    }
+    members = std::move(updated);
+    return true;
+}
+
+bool RoomManager::isValidName(std::string_view name)
+{
+    if (name.size() < 2 || name.size() > ROOM_NAME_MAX_LENGTH || name[0] != '#')
+    {
+        return false;
+    }
+    return std::all_of(name.begin() + 1, name.end(), [](char c)
+                       { return c > ' ' && c != 0x7f; });
+}
+
+size_t RoomManager::count()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return rooms.size();
+}
+
+std::shared_ptr<Room> RoomManager::find(std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = rooms.find(std::string(name));
+    return it != rooms.end() ? it->second : nullptr;
+}
+
+void RoomManager::releaseIfEmpty(const std::shared_ptr<Room> &room)
+{
+    if (room->size() == 0)
+    {
+        rooms.erase(room->getName());
+    }
+}
+
+RoomManager::JoinResult RoomManager::join(const std::shared_ptr<Client> &client, const std::string &name, std::shared_ptr<Room> &room)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Checked under the lock: leaveAll() runs after the flag is cleared, so a
+    // JOIN racing a disconnect either lands before it or is refused here
+    if (!client->isAuthenticated())
+    {
+        return JoinResult::Closed;
+    }
+
+    std::lock_guard<std::mutex> clientLock(client->roomsMutex);
+    for (auto &joined : client->rooms)
+    {
+        if (joined->getName() == name)
+        {
+            room = joined;
+            return JoinResult::AlreadyMember;
+        }
+    }
+    if (client->rooms.size() >= MAX_ROOMS_PER_CLIENT)
+    {
+        return JoinResult::TooManyRooms;
+    }
+
+    auto &slot = rooms[name];
+    if (!slot)
+    {
+        slot = std::make_shared<Room>(name);
+    }
+    room = slot;
+    room->add(client);
+    client->rooms.push_back(room);
+    client->currentRoom = room;
+    return JoinResult::Joined;
+}
+
+std::shared_ptr<Room> RoomManager::part(const std::shared_ptr<Client> &client, std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<std::mutex> clientLock(client->roomsMutex);
+
+    auto &joined = client->rooms;
+    auto it = std::find_if(joined.begin(), joined.end(), [name](const std::shared_ptr<Room> &room)
+                           { return room->getName() == name; });
+    if (it == joined.end())
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<Room> room = *it;
+    joined.erase(it);
+    if (client->currentRoom == room)
+    {
+        // Fall back to the most recently joined room still open, if any
+        client->currentRoom = joined.empty() ? nullptr : joined.back();
+    }
+
+    room->remove(client.get());
+    releaseIfEmpty(room);
+    return room;
+}
+
+std::vector<std::shared_ptr<Room>> RoomManager::leaveAll(Client *client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<std::mutex> clientLock(client->roomsMutex);
+
+    std::vector<std::shared_ptr<Room>> left;
+    left.swap(client->rooms);
+    client->currentRoom = nullptr;
+
+    for (auto &room : left)
+    {
+        room->remove(client);
+        releaseIfEmpty(room);
+    }
+    return left;
+}
+
+void RoomManager::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : rooms)
+    {
+        // Members and their rooms point at each other; empty the rooms to free both
+        std::lock_guard<std::mutex> roomLock(entry.second->mutex);
+        entry.second->members = std::make_shared<const Room::Members>();
+    }
+    rooms.clear();
+}
@@ -0,0 +1,81 @@
+#ifndef ROOMMANAGER_H
+#define ROOMMANAGER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ClientRoster.h"
+
+class Client;
+
+// A chat room: a named, copy-on-write member list. Fan-out takes the room's
+// lock only long enough to copy the snapshot pointer, then iterates the
+// members without it, so a message costs O(room size) whatever the number
+// of users on the server.
+class Room
+{
+public:
+    typedef ClientRoster::Members Members;
+
+private:
+    std::string name;
+    mutable std::mutex mutex;
+    std::shared_ptr<const Members> members; // Guarded by mutex, in join order
+
+    friend class RoomManager;
+    bool add(const std::shared_ptr<Client> &client); // false if already a member
+    bool remove(const Client *client);               // false if not a member
+
+public:
+    explicit Room(std::string roomName);
+
+    const std::string &getName() const;
+    std::shared_ptr<const Members> snapshot() const;
+    size_t size() const;
+};
+
+// Owns every room and keeps room membership and each client's list of joined
+// rooms in step. Joins and parts are rare next to messages, so they serialize
+// on one lock; sending to a room never takes it.
+class RoomManager
+{
+public:
+    enum class JoinResult
+    {
+        Joined,
+        AlreadyMember,
+        TooManyRooms,
+        Closed // The client is logging out
+    };
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Room>> rooms;
+
+    void releaseIfEmpty(const std::shared_ptr<Room> &room); // mutex held
+
+public:
+    // "#" followed by 1..ROOM_NAME_MAX_LENGTH-1 printable, non-space characters
+    static bool isValidName(std::string_view name);
+
+    size_t count(); // Open rooms
+    std::shared_ptr<Room> find(std::string_view name); // Null if nobody here is in it
+
+    // Adds the client to the room (creating it) and makes it the current room
+    JoinResult join(const std::shared_ptr<Client> &client, const std::string &name, std::shared_ptr<Room> &room);
+
+    // Removes the client from a room it joined; the room goes away with its
+    // last member. Returns null if the client was not in the room.
+    std::shared_ptr<Room> part(const std::shared_ptr<Client> &client, std::string_view name);
+
+    // On disconnect: leaves every room and returns them, so the caller can
+    // tell the remaining members
+    std::vector<std::shared_ptr<Room>> leaveAll(Client *client);
+
+    void clear();
+};
+
+#endif
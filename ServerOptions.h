@@ -0,0 +1,101 @@
+#ifndef SERVEROPTIONS_H
+#define SERVEROPTIONS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "serverDefaults.h"
+
+enum class IoBackendType
+{
+    Threads, // One blocking thread per client (portable)
+    Epoll,   // Edge-triggered epoll reactor (Linux)
+    Uring    // io_uring with multishot accept/recv (Linux 6.0+)
+};
+
+// What happens to a client whose outbound queue stays above the high watermark
+enum class SlowConsumerPolicy
+{
+    Disconnect, // Evict once over the limit for the grace period (or past the hard cap)
+    Drop        // Keep the connection, drop new messages until it drains
+};
+
+// Startup configuration parsed from the command line in main.cpp
+struct ServerOptions
+{
+    int port = DEFAULT_PORT;
+    int idleTimeoutSeconds = DEFAULT_IDLE_TIMEOUT;
+#ifdef __linux__
+    IoBackendType ioBackend = IoBackendType::Epoll;
+#else
+    IoBackendType ioBackend = IoBackendType::Threads;
+#endif
+    int shards = 0;       // epoll reactor shards; 0 = one per core
+    bool pinCpus = false; // Pin shard N to CPU N
+
+    // Unsharded backends split broadcasts to at least fanoutThreshold
+    // recipients across fanoutThreads workers; -1 = one per core but one
+    int fanoutThreads = -1;
+    size_t fanoutThreshold = DEFAULT_FANOUT_THRESHOLD;
+
+    // Workers running command handlers; -1 = one per core, 0 = on the I/O threads
+    int commandThreads = -1;
+
+    // Per-connection token buckets: commands and received bytes a second,
+    // and how many may arrive at once. A rate of 0 turns that limit off.
+    size_t commandRate = DEFAULT_COMMAND_RATE;
+    size_t commandBurst = DEFAULT_COMMAND_BURST;
+    size_t byteRate = DEFAULT_BYTE_RATE;
+    size_t byteBurst = DEFAULT_BYTE_BURST;
+
+    // Room message deliveries a second, shared by every MSG on the server,
+    // with one second's worth as the burst; 0 = unlimited
+    size_t fanoutBudget = 0;
+
+    // Per-client outbound queue limits, in bytes
+    size_t outboundHighWatermark = DEFAULT_OUTBOUND_HIGH_WATERMARK;
+    size_t outboundLowWatermark = DEFAULT_OUTBOUND_LOW_WATERMARK;
+    SlowConsumerPolicy slowConsumerPolicy = SlowConsumerPolicy::Disconnect;
+    int slowConsumerGraceMs = DEFAULT_SLOW_CONSUMER_GRACE_MS;
+
+    int statsPort = 0;      // Loopback port serving metrics as text; 0 = off
+    std::string adminToken; // Required by STATS; empty disables the command
+    std::string historyDir; // Message log segments for HISTORY; empty = no history
+    std::string mailboxDir; // Offline DM mailboxes; empty = DMs to offline users fail
+
+    // Federation: links to other servers on their peer ports; 0 = standalone
+    int peerPort = 0;
+    std::string peerBind = DEFAULT_PEER_BIND; // Address the peer port listens on
+    std::vector<std::string> peers;           // host:port of every other node
+    std::string nodeId;             // Unique per node; empty = <hostname>:<peerPort>
+
+    // Unix socket for hot restarts: a new process started with the same path
+    // takes the connections over from this one; empty = off
+    std::string handoffSocket;
+};
+
+inline bool parseIoBackend(const std::string &name, IoBackendType &type)
+{
+    if (name == "threads")
+        type = IoBackendType::Threads;
+    else if (name == "epoll")
+        type = IoBackendType::Epoll;
+    else if (name == "uring")
+        type = IoBackendType::Uring;
+    else
+        return false;
+    return true;
+}
+
+inline bool parseSlowConsumerPolicy(const std::string &name, SlowConsumerPolicy &policy)
+{
+    if (name == "disconnect")
+        policy = SlowConsumerPolicy::Disconnect;
+    else if (name == "drop")
+        policy = SlowConsumerPolicy::Drop;
+    else
+        return false;
+    return true;
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include "TimerWheel.h"
+
+TimerNode::TimerNode()
+    : wheel(nullptr), prev(this), next(this), expiry(0), armed(false)
+{
+}
+
+TimerNode::~TimerNode()
+{
+    cancel();
+}
+
+void TimerNode::bind(TimerWheel *timerWheel, std::weak_ptr<void> timerOwner, std::function<void()> onExpire)
+{
+    cancel();
+    wheel = timerWheel;
+    owner = std::move(timerOwner);
+    callback = std::move(onExpire);
+}
+
+void TimerNode::schedule(int64_t delayMs)
+{
+    if (wheel)
+    {
+        wheel->schedule(this, delayMs);
+    }
+}
+
+void TimerNode::cancel()
+{
+    if (wheel)
+    {
+        wheel->cancel(this);
+    }
+}
+
+TimerWheel::TimerWheel()
+    : currentTick(0), armedCount(0), start(std::chrono::steady_clock::now()), running(true)
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+    // Detach anything still armed so late cancels from owners are harmless
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &level : slots)
+    {
+        for (TimerNode &head : level)
+        {
+            while (head.next != &head)
+            {
+                TimerNode *node = head.next;
+                unlink(node);
+                node->wheel = nullptr;
+            }
+        }
+    }
+}
+
+uint64_t TimerWheel::tickAt(std::chrono::steady_clock::time_point time) const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time - start).count();
+    return elapsed > 0 ? static_cast<uint64_t>(elapsed) / TIMER_TICK_MS : 0;
+}
+
+void TimerWheel::link(TimerNode *node)
+{
+    uint64_t delta = node->expiry > currentTick ? node->expiry - currentTick : 0;
+
+    // Pick the lowest level whose span covers the delay
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (uint64_t(1) << (TIMER_WHEEL_BITS * (level + 1))))
+    {
+        ++level;
+    }
+    uint64_t maxDelta = (uint64_t(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    if (delta > maxDelta)
+    {
+        node->expiry = currentTick + maxDelta; // Fires early; owners re-check and re-arm
+    }
+
+    TimerNode &head = slots[level][(node->expiry >> (TIMER_WHEEL_BITS * level)) & MASK];
+    node->prev = head.prev;
+    node->next = &head;
+    head.prev->next = node;
+    head.prev = node;
+    node->armed = true;
+    ++armedCount;
+}
+
+void TimerWheel::unlink(TimerNode *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node;
+    node->next = node;
+    node->armed = false;
+    --armedCount;
+}
+
+void TimerWheel::schedule(TimerNode *node, int64_t delayMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (node->armed)
+        {
+            unlink(node);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (armedCount == 0)
+        {
+            currentTick = tickAt(now); // The idle wheel skipped ticks; nothing to replay
+        }
+
+        // Round up so a timer never fires early, and never into the slot already expired
+        auto due = now + std::chrono::milliseconds(delayMs > 0 ? delayMs : 0);
+        node->expiry = tickAt(due + std::chrono::milliseconds(TIMER_TICK_MS - 1));
+        if (node->expiry <= currentTick)
+        {
+            node->expiry = currentTick + 1;
+        }
+        link(node);
+    }
+    wakeup.notify_one();
+}
+
+void TimerWheel::cancel(TimerNode *node)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node->armed)
+    {
+        unlink(node);
+    }
+}
+
+void TimerWheel::advance(uint64_t targetTick, std::vector<std::shared_ptr<void>> &owners, std::vector<TimerNode *> &expired)
+{
+    while (currentTick < targetTick)
+    {
+        ++currentTick;
+
+        // Every time a level wraps, move the matching slot of the level above down
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+        {
+            if ((currentTick & ((uint64_t(1) << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+            {
+                break;
+            }
+            TimerNode &head = slots[level][(currentTick >> (TIMER_WHEEL_BITS * level)) & MASK];
+            while (head.next != &head)
+            {
+                TimerNode *node = head.next;
+                unlink(node);
+                link(node);
+            }
+        }
+
+        TimerNode &head = slots[0][currentTick & MASK];
+        while (head.next != &head)
+        {
+            TimerNode *node = head.next;
+            unlink(node);
+
+            // Pinning the owner keeps the node alive while its callback runs unlocked
+            std::shared_ptr<void> pinned = node->owner.lock();
+            if (pinned)
+            {
+                owners.push_back(std::move(pinned));
+                expired.push_back(node);
+            }
+        }
+    }
+}
+
+void TimerWheel::run()
+{
+    std::vector<std::shared_ptr<void>> owners;
+    std::vector<TimerNode *> expired;
+
+    while (running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (armedCount == 0)
+            {
+                wakeup.wait(lock, [this]() { return armedCount > 0 || !running; });
+            }
+            else
+            {
+                wakeup.wait_until(lock, start + std::chrono::milliseconds((currentTick + 1) * TIMER_TICK_MS),
+                                  [this]() { return !running.load(); });
+            }
+            advance(tickAt(std::chrono::steady_clock::now()), owners, expired);
+        }
+
+        // Callbacks may send, broadcast or re-arm, so they run without the lock
+        for (TimerNode *node : expired)
+        {
+            node->callback();
+        }
+        expired.clear();
+        owners.clear();
+    }
+}
+
+void TimerWheel::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wakeup.notify_all();
+}
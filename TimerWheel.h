@@ -0,0 +1,84 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "serverDefaults.h"
+
+class TimerWheel;
+
+// One timer, embedded in the object it belongs to (a Client's idle timer, a
+// future heartbeat timer, ...). The callback and owner are set once; arming
+// and re-arming only relink the node, so they never allocate. The owner is
+// held weakly: a timer whose owner is being destroyed is skipped.
+class TimerNode
+{
+private:
+    TimerWheel *wheel;
+    TimerNode *prev;
+    TimerNode *next;
+    uint64_t expiry; // Absolute tick
+    bool armed;
+
+    std::weak_ptr<void> owner;
+    std::function<void()> callback;
+
+    friend class TimerWheel;
+
+public:
+    TimerNode();
+    ~TimerNode();
+
+    TimerNode(const TimerNode &) = delete;
+    TimerNode &operator=(const TimerNode &) = delete;
+
+    // The callback runs on the wheel's thread with no wheel lock held
+    void bind(TimerWheel *timerWheel, std::weak_ptr<void> timerOwner, std::function<void()> onExpire);
+
+    void schedule(int64_t delayMs); // Arms or re-arms; O(1)
+    void cancel();                  // O(1); no-op if not armed
+};
+
+// Hierarchical timing wheel: TIMER_WHEEL_LEVELS levels of 2^TIMER_WHEEL_BITS
+// slots, TIMER_TICK_MS per level-0 slot. Scheduling and cancelling are O(1)
+// list operations; each tick expires one level-0 slot and, every 64 ticks,
+// cascades one slot of the next level down. run() drives it on its own thread.
+class TimerWheel
+{
+private:
+    static const unsigned SLOTS = 1u << TIMER_WHEEL_BITS;
+    static const unsigned MASK = SLOTS - 1;
+
+    TimerNode slots[TIMER_WHEEL_LEVELS][SLOTS]; // List heads (sentinels)
+    uint64_t currentTick;
+    size_t armedCount;
+    std::chrono::steady_clock::time_point start;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> running;
+
+    uint64_t tickAt(std::chrono::steady_clock::time_point time) const;
+    void link(TimerNode *node);   // mutex held
+    void unlink(TimerNode *node); // mutex held
+    void advance(uint64_t targetTick, std::vector<std::shared_ptr<void>> &owners, std::vector<TimerNode *> &expired);
+
+    friend class TimerNode;
+    void schedule(TimerNode *node, int64_t delayMs);
+    void cancel(TimerNode *node);
+
+public:
+    TimerWheel();
+    ~TimerWheel();
+
+    void run();
+    void stop();
+};
+
+#endif
@@ -0,0 +1,23 @@
+#include "TokenBucket.h"
+#include <algorithm>
+
+bool TokenBucket::take(double cost, double rate, double burst, Clock::time_point now)
+{
+    if (!started)
+    {
+        tokens = burst;
+        started = true;
+    }
+    else if (now > refilled)
+    {
+        tokens = std::min(burst, tokens + std::chrono::duration<double>(now - refilled).count() * rate);
+    }
+    refilled = std::max(refilled, now);
+
+    if (tokens < std::min(cost, burst))
+    {
+        return false;
+    }
+    tokens -= cost;
+    return true;
+}
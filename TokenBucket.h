@@ -0,0 +1,26 @@
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <chrono>
+
+// Rate limiter that refills at `rate` tokens a second and holds at most
+// `burst`. The rate and burst are passed to every take(), so the buckets
+// embedded in each client carry only their state, not a copy of the
+// configuration. A cost larger than the burst is let through once the bucket
+// is full and leaves it in debt, so it is slowed down rather than refused
+// for good. Not thread-safe.
+class TokenBucket
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // false (and nothing taken) if the bucket cannot cover the cost yet
+    bool take(double cost, double rate, double burst, Clock::time_point now);
+
+private:
+    double tokens = 0;
+    bool started = false; // Full on first use
+    Clock::time_point refilled;
+};
+
+#endif
@@ -0,0 +1,793 @@
+#include "UringBackend.h"
+
+#ifdef CHATTCP_HAVE_IO_URING
+
+#include "ChatServer.h"
+#include "ClientPool.h"
+#include "Logger.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+
+#define URING_BUFFER_GROUP 0
+
+struct UringOperation
+{
+    enum Type
+    {
+        Accept,
+        Recv,
+        Send,
+        Wake
+    } type;
+
+    std::shared_ptr<UringClient> client; // For sends, set only while in flight
+
+    // Send state, reused for every send of one client: the references keep the
+    // shared wire buffers alive until the kernel has consumed them
+    std::vector<WireRef> buffers;
+    iovec iov[URING_MAX_IOV];
+    msghdr msg;
+
+    explicit UringOperation(Type t) : type(t), msg{} {}
+};
+
+static int ioUringSetup(unsigned entries, io_uring_params *params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned count)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+UringClient::UringClient(SOCKET socket, ChatServer *srv, UringBackend *owner)
+    : Client(socket, srv), backend(owner), sendInFlight(false),
+      sendOp(std::make_unique<UringOperation>(UringOperation::Send))
+{
+    sendOp->buffers.reserve(URING_MAX_IOV);
+}
+
+UringClient::~UringClient()
+{
+}
+
+void UringClient::onOutboundQueued(bool wasEmpty)
+{
+    if (!wasEmpty)
+    {
+        return;
+    }
+
+    bool schedule;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        schedule = !sendInFlight;
+    }
+
+    if (schedule)
+    {
+        backend->scheduleSend(clientSocket);
+    }
+}
+
+UringBackend::UringBackend(ChatServer *srv, SOCKET listener)
+    : server(srv), listenSocket(listener), ringFd(-1), wakeFd(-1), running(false), releasing(false),
+      wakePending(false), cancelled(false), sendsInFlight(0),
+      sqRing(nullptr), sqRingSize(0), sqes(nullptr), sqesSize(0),
+      sqHead(nullptr), sqTail(nullptr), sqMask(nullptr), sqArray(nullptr), sqEntries(0), sqLocalTail(0),
+      cqRing(nullptr), cqRingSize(0), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), cqes(nullptr),
+      bufferRing(nullptr), bufferRingSize(0), bufferTail(0), wakeValue(0)
+{
+}
+
+UringBackend::~UringBackend()
+{
+    // Closing the ring cancels every outstanding operation
+    if (ringFd != -1)
+    {
+        ::close(ringFd);
+    }
+    if (bufferRing)
+    {
+        munmap(bufferRing, bufferRingSize);
+    }
+    if (sqes)
+    {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing && cqRing != sqRing)
+    {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing)
+    {
+        munmap(sqRing, sqRingSize);
+    }
+    if (wakeFd != -1)
+    {
+        ::close(wakeFd);
+    }
+}
+
+bool UringBackend::isSupported()
+{
+    // Multishot recv with provided buffer rings needs Linux 6.0
+    utsname info;
+    if (uname(&info) != 0)
+    {
+        return false;
+    }
+    int major = 0, minor = 0;
+    if (sscanf(info.release, "%d.%d", &major, &minor) != 2)
+    {
+        return false;
+    }
+    return major > 6 || (major == 6 && minor >= 0);
+}
+
+bool UringBackend::initialize()
+{
+    if (!isSupported())
+    {
+        Log::warn("io_uring: kernel too old for multishot recv");
+        return false;
+    }
+
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_QUEUE_DEPTH * 4; // Multishot ops post many completions per submission
+
+    ringFd = ioUringSetup(URING_QUEUE_DEPTH, &params);
+    if (ringFd < 0)
+    {
+        Log::error("io_uring_setup failed: ", errno);
+        ringFd = -1;
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        sqRing = nullptr;
+        Log::error("io_uring: mmap(sq) failed: ", errno);
+        return false;
+    }
+
+    if (singleMmap)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            cqRing = nullptr;
+            Log::error("io_uring: mmap(cq) failed: ", errno);
+            return false;
+        }
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqeMemory == MAP_FAILED)
+    {
+        Log::error("io_uring: mmap(sqes) failed: ", errno);
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+    char *sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+    sqLocalTail = *sqTail;
+
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // Provided buffer ring: the kernel picks a free buffer for each recv completion
+    bufferRingSize = URING_BUFFER_COUNT * sizeof(io_uring_buf);
+    void *ringMemory = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ringMemory == MAP_FAILED)
+    {
+        Log::error("io_uring: buffer ring allocation failed: ", errno);
+        return false;
+    }
+    bufferRing = static_cast<io_uring_buf *>(ringMemory);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    reg.ring_entries = URING_BUFFER_COUNT;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (ioUringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        Log::warn("io_uring: provided buffer rings unsupported: ", errno);
+        return false;
+    }
+
+    bufferPool.resize(static_cast<size_t>(URING_BUFFER_COUNT) * MAX_BUFFER_SIZE);
+    for (unsigned i = 0; i < URING_BUFFER_COUNT; ++i)
+    {
+        recycleBuffer(static_cast<unsigned short>(i));
+    }
+
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd == -1)
+    {
+        Log::error("eventfd failed: ", errno);
+        return false;
+    }
+
+    acceptOp = std::make_unique<Operation>(Operation::Accept);
+    wakeOp = std::make_unique<Operation>(Operation::Wake);
+    return true;
+}
+
+io_uring_sqe *UringBackend::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= sqEntries)
+    {
+        // Queue full: push what we have to the kernel first
+        submit(0);
+        head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (sqLocalTail - head >= sqEntries)
+        {
+            return nullptr;
+        }
+    }
+
+    unsigned index = sqLocalTail & *sqMask;
+    sqArray[index] = index;
+    ++sqLocalTail;
+
+    io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int UringBackend::submit(unsigned waitFor)
+{
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    if (toSubmit == 0 && waitFor == 0)
+    {
+        return 0;
+    }
+    return ioUringEnter(ringFd, toSubmit, waitFor, flags);
+}
+
+void UringBackend::recycleBuffer(unsigned short bufferId)
+{
+    io_uring_buf &buf = bufferRing[bufferTail & (URING_BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(bufferPool.data() + static_cast<size_t>(bufferId) * MAX_BUFFER_SIZE);
+    buf.len = MAX_BUFFER_SIZE;
+    buf.bid = bufferId;
+    ++bufferTail;
+    __atomic_store_n(&bufferRing[0].resv, static_cast<unsigned short>(bufferTail), __ATOMIC_RELEASE);
+}
+
+void UringBackend::armAccept()
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSocket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = reinterpret_cast<uint64_t>(acceptOp.get());
+}
+
+void UringBackend::armRecv(const std::shared_ptr<UringClient> &client)
+{
+    SOCKET fd = client->getSocket();
+    auto &op = recvOps[fd];
+    if (!op)
+    {
+        op = std::make_unique<Operation>(Operation::Recv);
+        op->client = client;
+    }
+
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = reinterpret_cast<uint64_t>(op.get());
+}
+
+void UringBackend::armWake()
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeValue);
+    sqe->len = sizeof(wakeValue);
+    sqe->user_data = reinterpret_cast<uint64_t>(wakeOp.get());
+}
+
+void UringBackend::cancelAll()
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+    {
+        return; // Tried again next turn
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = 0; // Its own completion is ignored
+    cancelled = true;
+}
+
+void UringBackend::scheduleSend(SOCKET socket)
+{
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        readySends.push_back(socket);
+    }
+
+    // Sends queued from the loop thread go out with its next submission;
+    // anyone else has to interrupt the wait
+    if (std::this_thread::get_id() != loopThread)
+    {
+        wake();
+    }
+}
+
+void UringBackend::resumeReading(const std::shared_ptr<Client> &client)
+{
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        resumedReads.push_back(client);
+    }
+    if (std::this_thread::get_id() != loopThread)
+    {
+        wake();
+    }
+}
+
+void UringBackend::wake()
+{
+    // One eventfd write per batch of sends and resumes; cleared by the loop
+    // before it takes them
+    if (!wakePending.exchange(true))
+    {
+        uint64_t one = 1;
+        (void)!::write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void UringBackend::flushResumedReads()
+{
+    std::vector<std::shared_ptr<Client>> resumed;
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        resumed.swap(resumedReads);
+    }
+
+    for (auto &client : resumed)
+    {
+        SOCKET fd = client->getSocket();
+        auto it = connections.find(fd);
+        if (it == connections.end() || it->second != client || stalledReads.erase(fd) == 0)
+        {
+            continue; // Closed since, or never stalled
+        }
+        if (!recvOps.count(fd))
+        {
+            armRecv(it->second);
+        }
+        // Otherwise the cancel has not completed yet; its completion re-arms
+    }
+}
+
+void UringBackend::stallRecv(SOCKET fd, bool armed)
+{
+    auto op = recvOps.find(fd);
+    if (!stalledReads.insert(fd).second || !armed || op == recvOps.end())
+    {
+        return; // A finished recv is simply not re-armed
+    }
+
+    // Multishot would go on reading; left in the kernel, the input pushes
+    // back on the sender through TCP
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+    {
+        return; // Still read, and stalled again, until a cancel goes through
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(op->second.get());
+    sqe->user_data = 0; // Its own completion is ignored
+}
+
+void UringBackend::flushReadySends()
+{
+    std::vector<SOCKET> ready;
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        ready.swap(readySends);
+    }
+
+    for (SOCKET fd : ready)
+    {
+        auto it = connections.find(fd);
+        if (it != connections.end())
+        {
+            submitSend(it->second);
+        }
+    }
+}
+
+void UringBackend::submitSend(const std::shared_ptr<UringClient> &client)
+{
+    Operation *op = client->sendOp.get();
+
+    {
+        std::lock_guard<std::mutex> lock(client->sendMutex);
+        if (client->sendInFlight || client->outbound.empty() || client->clientSocket == INVALID_SOCKET)
+        {
+            return;
+        }
+
+        // Coalesce everything queued so far into one sendmsg. Buffers stay in
+        // the queue until the completion says how much was written.
+        size_t count = client->outbound.size() < URING_MAX_IOV ? client->outbound.size() : URING_MAX_IOV;
+        op->buffers.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const WireRef &buffer = client->outbound.at(i);
+            size_t skip = i == 0 ? client->outboundOffset : 0;
+            op->buffers.push_back(buffer);
+            op->iov[i] = iovec{const_cast<char *>(buffer->data() + skip), buffer->size() - skip};
+        }
+        op->msg.msg_iov = op->iov;
+        op->msg.msg_iovlen = count;
+
+        io_uring_sqe *sqe = getSqe();
+        if (!sqe)
+        {
+            op->buffers.clear();
+            scheduleSend(client->clientSocket); // Retry after the next submission
+            return;
+        }
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = client->clientSocket;
+        sqe->addr = reinterpret_cast<uint64_t>(&op->msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+        client->sendInFlight = true;
+        op->client = client; // Keeps the client alive until the completion
+        ++sendsInFlight;
+    }
+}
+
+void UringBackend::run()
+{
+    running = true;
+    loopThread = std::this_thread::get_id();
+
+    armAccept();
+    armWake();
+
+    while (running)
+    {
+        if (releasing)
+        {
+            // Multishot recvs would keep taking data the next process must read,
+            // and a send stuck on a full socket would never finish
+            if (!cancelled)
+            {
+                cancelAll();
+            }
+            else if (recvOps.empty() && sendsInFlight == 0)
+            {
+                break;
+            }
+        }
+        else
+        {
+            wakePending = false;
+            flushResumedReads();
+            flushReadySends();
+        }
+
+        int result = submit(1);
+        if (result < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+        {
+            Log::limited(Log::Level::Error, "uring-enter", "io_uring_enter failed: ", errno);
+            break;
+        }
+
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            // Copy out so the slot can be released before handlers run
+            io_uring_cqe cqe = cqes[head & *cqMask];
+            ++head;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            handleCompletion(cqe);
+        }
+    }
+
+    running = false;
+}
+
+void UringBackend::release()
+{
+    releasing = true;
+    if (wakeFd != -1)
+    {
+        uint64_t one = 1;
+        (void)!::write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void UringBackend::stop()
+{
+    running = false;
+    if (wakeFd != -1)
+    {
+        uint64_t one = 1;
+        (void)!::write(wakeFd, &one, sizeof(one));
+    }
+}
+
+void UringBackend::handleCompletion(const io_uring_cqe &cqe)
+{
+    auto *op = reinterpret_cast<Operation *>(cqe.user_data);
+    if (!op)
+    {
+        return;
+    }
+
+    switch (op->type)
+    {
+    case Operation::Accept:
+        handleAccept(cqe);
+        break;
+    case Operation::Recv:
+        handleRecv(op, cqe);
+        break;
+    case Operation::Send:
+        handleSend(op, cqe);
+        break;
+    case Operation::Wake:
+        if (running)
+        {
+            armWake();
+        }
+        break;
+    }
+}
+
+void UringBackend::handleAccept(const io_uring_cqe &cqe)
+{
+    if (!(cqe.flags & IORING_CQE_F_MORE) && running && !releasing)
+    {
+        armAccept(); // Multishot accept terminated; re-arm it
+    }
+
+    if (cqe.res < 0)
+    {
+        // A release cancels the accept with -ECANCELED; nothing failed
+        if (running && !releasing)
+        {
+            Log::limited(Log::Level::Error, "accept", "Accept failed: ", -cqe.res);
+        }
+        return;
+    }
+
+    SOCKET clientSocket = cqe.res;
+
+    sockaddr_in clientAddr;
+    socklen_t clientAddrSize = sizeof(clientAddr);
+    char clientIP[INET_ADDRSTRLEN] = "unknown";
+    if (getpeername(clientSocket, (sockaddr *)&clientAddr, &clientAddrSize) == 0)
+    {
+        inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
+    }
+    Log::info("New connection from ", clientIP);
+
+    auto client = ClientPool::make<UringClient>(clientSocket, server, this);
+    connections[clientSocket] = client;
+    server->addClient(client);
+    if (!releasing)
+    {
+        armRecv(client); // Otherwise its input waits for the next process
+    }
+}
+
+std::shared_ptr<Client> UringBackend::adopt(SOCKET socket)
+{
+    auto client = ClientPool::make<UringClient>(socket, server, this);
+    connections[socket] = client;
+    server->addClient(client);
+    armRecv(client); // Submitted with run()'s first io_uring_enter; data already waiting completes it
+    return client;
+}
+
+void UringBackend::handleRecv(Operation *op, const io_uring_cqe &cqe)
+{
+    std::shared_ptr<UringClient> client = op->client;
+    SOCKET fd = client->getSocket();
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER))
+    {
+        unsigned short bufferId = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        const char *data = bufferPool.data() + static_cast<size_t>(bufferId) * MAX_BUFFER_SIZE;
+
+        lineBatch.clear();
+        client->appendReceived(data, cqe.res, lineBatch);
+        recycleBuffer(bufferId);
+
+        bool stalled = false;
+        try
+        {
+            stalled = server->processMessages(client, lineBatch);
+        }
+        catch (const std::exception &e)
+        {
+            Log::limited(Log::Level::Error, "client-exception", "Exception handling client: ", e.what());
+            client->shutdownConnection();
+        }
+        client->releaseLines();
+
+        if (stalled)
+        {
+            stallRecv(fd, more);
+        }
+        if (!more)
+        {
+            rearmRecv(client);
+        }
+        return;
+    }
+
+    if (cqe.res == -ENOBUFS)
+    {
+        // Ran out of provided buffers; they have been recycled by now
+        if (!more)
+        {
+            rearmRecv(client);
+        }
+        return;
+    }
+
+    if (cqe.res == -ECANCELED && releasing)
+    {
+        recvOps.erase(fd); // The connection itself goes to the next process
+        return;
+    }
+
+    if (cqe.res == -ECANCELED)
+    {
+        // Stalled by a full command inbox; re-armed here if it was drained since
+        if (!more)
+        {
+            rearmRecv(client);
+        }
+        return;
+    }
+
+    // EOF or error: the multishot recv is finished
+    if (!more)
+    {
+        closeConnection(fd);
+    }
+}
+
+void UringBackend::rearmRecv(const std::shared_ptr<UringClient> &client)
+{
+    if (releasing || stalledReads.count(client->getSocket()))
+    {
+        recvOps.erase(client->getSocket()); // flushResumedReads() arms it again
+        return;
+    }
+    armRecv(client);
+}
+
+void UringBackend::handleSend(Operation *op, const io_uring_cqe &cqe)
+{
+    std::shared_ptr<UringClient> client = std::move(op->client);
+    bool resubmit = false;
+    bool cancelled = cqe.res == -ECANCELED && releasing;
+    --sendsInFlight;
+
+    {
+        std::lock_guard<std::mutex> lock(client->sendMutex);
+        client->sendInFlight = false;
+        op->buffers.clear();
+
+        if (cancelled)
+        {
+            // Nothing was written; the queue goes to the next process as it is
+        }
+        else if (cqe.res < 0)
+        {
+            client->outbound.clear();
+            client->outboundBytes = 0;
+            client->outboundOffset = 0;
+        }
+        else
+        {
+            // A short write leaves the rest at the front of the queue
+            client->consumeOutbound(cqe.res);
+        }
+
+        resubmit = !client->outbound.empty() && client->clientSocket != INVALID_SOCKET && !releasing;
+    }
+
+    if (cqe.res < 0 && !cancelled)
+    {
+        Metrics::add(Metrics::Counter::SendErrors);
+        client->shutdownConnection();
+    }
+    else if (resubmit)
+    {
+        submitSend(client);
+    }
+}
+
+void UringBackend::closeConnection(SOCKET fd)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end())
+    {
+        return;
+    }
+
+    std::shared_ptr<UringClient> client = it->second;
+    connections.erase(it);
+    recvOps.erase(fd);
+    stalledReads.erase(fd);
+
+    server->disconnectClient(client);
+    client->close();
+}
+
+#endif
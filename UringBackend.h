@@ -0,0 +1,155 @@
+#ifndef URINGBACKEND_H
+#define URINGBACKEND_H
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define CHATTCP_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef CHATTCP_HAVE_IO_URING
+
+#include "Client.h"
+#include "IoBackend.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class ChatServer;
+class UringBackend;
+struct UringOperation;
+
+// Client whose outbound queue is drained by the io_uring thread, which submits
+// it as batched sendmsg operations instead of writing from the caller.
+class UringClient : public Client
+{
+private:
+    UringBackend *backend;
+    bool sendInFlight; // Guarded by sendMutex; in-flight buffers stay queued until completion
+    std::unique_ptr<UringOperation> sendOp; // Reused by every send of this client
+
+    friend class UringBackend;
+
+public:
+    UringClient(SOCKET socket, ChatServer *srv, UringBackend *owner);
+    ~UringClient() override;
+
+protected:
+    void onOutboundQueued(bool wasEmpty) override;
+};
+
+// io_uring event loop: multishot accept, multishot recv from a provided buffer
+// ring, and every queued send submitted together with a single io_uring_enter.
+// Talks to the kernel through raw syscalls so no liburing is required.
+class UringBackend : public IoBackend
+{
+private:
+    using Operation = UringOperation;
+
+    ChatServer *server;
+    SOCKET listenSocket;
+    int ringFd;
+    int wakeFd;
+    std::atomic<bool> running;
+    std::atomic<bool> releasing;   // release(): cancel everything, then leave run()
+    std::atomic<bool> wakePending; // An eventfd write is on its way to the loop
+    bool cancelled;                // The cancel for release() was submitted
+    size_t sendsInFlight;          // Loop thread only
+    std::thread::id loopThread;
+
+    // Submission queue
+    void *sqRing;
+    size_t sqRingSize;
+    io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+    unsigned sqLocalTail;
+
+    // Completion queue
+    void *cqRing;
+    size_t cqRingSize;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    io_uring_cqe *cqes;
+
+    // Provided buffers for multishot recv. The ring tail overlays entry 0's
+    // resv field; io_uring_buf_ring's flexible array is not usable from C++.
+    io_uring_buf *bufferRing;
+    size_t bufferRingSize;
+    std::vector<char> bufferPool;
+    unsigned bufferTail;
+
+    std::unique_ptr<Operation> acceptOp;
+    std::unique_ptr<Operation> wakeOp;
+    uint64_t wakeValue;
+
+    std::unordered_map<SOCKET, std::shared_ptr<UringClient>> connections;
+    std::unordered_map<SOCKET, std::unique_ptr<Operation>> recvOps;
+
+    std::mutex readyMutex;
+    std::vector<SOCKET> readySends; // Sockets with queued output and no send in flight
+    std::vector<std::shared_ptr<Client>> resumedReads; // Inboxes drained after a stall
+
+    // Connections whose recv is cancelled, and not re-armed, until the
+    // command pool drains their inbox. Loop thread only.
+    std::unordered_set<SOCKET> stalledReads;
+
+    std::vector<std::string_view> lineBatch; // Reused for every recv completion
+
+public:
+    UringBackend(ChatServer *srv, SOCKET listener);
+    ~UringBackend() override;
+
+    // True when the running kernel supports every feature this backend uses
+    static bool isSupported();
+
+    bool initialize() override;
+    void run() override;
+    void stop() override;
+
+    const char *name() const override { return "io_uring"; }
+
+    std::shared_ptr<Client> adopt(SOCKET socket) override;
+    void release() override;
+    void resumeReading(const std::shared_ptr<Client> &client) override;
+
+    // Called by UringClient when it has output and no send in flight
+    void scheduleSend(SOCKET socket);
+
+private:
+    io_uring_sqe *getSqe();
+    int submit(unsigned waitFor);
+
+    void armAccept();
+    void armRecv(const std::shared_ptr<UringClient> &client);
+    void rearmRecv(const std::shared_ptr<UringClient> &client); // Unless releasing or stalled
+    void stallRecv(SOCKET fd, bool armed); // armed: the multishot recv is still going
+    void flushResumedReads();
+    void armWake();
+    void wake(); // From other threads; coalesced until the loop flushes
+    void cancelAll();
+    void submitSend(const std::shared_ptr<UringClient> &client);
+    void flushReadySends();
+    void recycleBuffer(unsigned short bufferId);
+
+    void handleCompletion(const io_uring_cqe &cqe);
+    void handleAccept(const io_uring_cqe &cqe);
+    void handleRecv(Operation *op, const io_uring_cqe &cqe);
+    void handleSend(Operation *op, const io_uring_cqe &cqe);
+    void closeConnection(SOCKET fd);
+};
+
+#endif
+
+#endif
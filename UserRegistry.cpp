@@ -0,0 +1,56 @@
+#include "UserRegistry.h"
+#include "Client.h"
+
+UserRegistry::Stripe &UserRegistry::stripeFor(std::string_view username)
+{
+    return stripes[std::hash<std::string_view>()(username) % USER_REGISTRY_STRIPES];
+}
+
+bool UserRegistry::claim(const std::string &username, const std::shared_ptr<Client> &client)
+{
+    Stripe &stripe = stripeFor(username);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.users.emplace(username, client).second;
+}
+
+bool UserRegistry::release(const std::string &username, const Client *client)
+{
+    Stripe &stripe = stripeFor(username);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.users.find(NameKey::view(username));
+    if (it != stripe.users.end() && it->second.get() == client)
+    {
+        stripe.users.erase(it);
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<Client> UserRegistry::find(std::string_view username)
+{
+    Stripe &stripe = stripeFor(username);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.users.find(NameKey::view(username));
+    return it != stripe.users.end() ? it->second : nullptr;
+}
+
+bool UserRegistry::contains(std::string_view username)
+{
+    Stripe &stripe = stripeFor(username);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.users.count(NameKey::view(username)) != 0;
+}
+
+std::vector<std::string> UserRegistry::names()
+{
+    std::vector<std::string> all;
+    for (Stripe &stripe : stripes)
+    {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (auto &entry : stripe.users)
+        {
+            all.push_back(entry.first.str());
+        }
+    }
+    return all;
+}
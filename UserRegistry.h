@@ -0,0 +1,44 @@
+#ifndef USERREGISTRY_H
+#define USERREGISTRY_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "serverDefaults.h"
+#include "NameKey.h"
+
+class Client;
+
+// Concurrent username -> client index. Names hash to one of a fixed number of
+// independently locked stripes, so LOGIN and DM lookups are O(1) and only
+// contend when they land on the same stripe. Lookups take a string_view and
+// never copy the name.
+class UserRegistry
+{
+private:
+    struct alignas(64) Stripe
+    {
+        std::mutex mutex;
+        std::unordered_map<NameKey, std::shared_ptr<Client>, NameKey::Hash> users;
+    };
+
+    Stripe stripes[USER_REGISTRY_STRIPES];
+
+    Stripe &stripeFor(std::string_view username);
+
+public:
+    // Atomically registers the name; false if another client already holds it
+    bool claim(const std::string &username, const std::shared_ptr<Client> &client);
+
+    // Removes the name if it is still held by this client; true if it was
+    bool release(const std::string &username, const Client *client);
+
+    std::shared_ptr<Client> find(std::string_view username);
+    bool contains(std::string_view username);
+    std::vector<std::string> names(); // Every registered name, one stripe at a time
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "WireBuffer.h"
+#include "serverDefaults.h"
+#include <cstring>
+#include <new>
+
+WireBuffer::WireBuffer(size_t size, bool isBinary)
+    : refs(1), length(static_cast<uint32_t>(size)), binary(isBinary), encoding(nullptr)
+{
+}
+
+WireRef WireBuffer::frame(std::string_view message)
+{
+    return frame({message});
+}
+
+WireRef WireBuffer::frame(std::initializer_list<std::string_view> parts)
+{
+    return build(std::string_view(), parts, false);
+}
+
+WireRef WireBuffer::binaryFrame(std::string_view header, std::initializer_list<std::string_view> body)
+{
+    return build(header, body, true);
+}
+
+WireRef WireBuffer::raw(std::string_view bytes)
+{
+    WireRef wire = allocate(bytes.size(), true);
+    std::memcpy(reinterpret_cast<char *>(wire.buffer + 1), bytes.data(), bytes.size());
+    return wire;
+}
+
+WireRef WireBuffer::allocate(size_t size, bool isBinary)
+{
+    void *memory = ::operator new(sizeof(WireBuffer) + size);
+    return WireRef(new (memory) WireBuffer(size, isBinary));
+}
+
+WireRef WireBuffer::build(std::string_view prefix, std::initializer_list<std::string_view> parts, bool isBinary)
+{
+    size_t size = prefix.size() + (isBinary ? 0 : 1);
+    for (std::string_view part : parts)
+    {
+        size += part.size();
+    }
+    // Text lines count their '\n'; binary frames add a 4-byte length prefix
+    size_t limit = isBinary ? BINARY_MAX_FRAME + 4 : BINARY_MAX_FRAME;
+    if (size > limit)
+    {
+        return WireRef();
+    }
+
+    WireRef wire = allocate(size, isBinary);
+    char *bytes = reinterpret_cast<char *>(wire.buffer + 1);
+    std::memcpy(bytes, prefix.data(), prefix.size());
+    bytes += prefix.size();
+    for (std::string_view part : parts)
+    {
+        std::memcpy(bytes, part.data(), part.size());
+        bytes += part.size();
+    }
+    if (!isBinary)
+    {
+        *bytes = '\n';
+    }
+    return wire;
+}
+
+WireRef WireBuffer::encodedForm() const
+{
+    WireBuffer *cached = encoding.load(std::memory_order_acquire);
+    if (!cached)
+    {
+        return WireRef();
+    }
+    cached->retain();
+    return WireRef(cached);
+}
+
+WireRef WireBuffer::cacheEncodedForm(WireRef form) const
+{
+    // A buffer cached as its own encoding holds no reference to itself, or it
+    // would never be freed
+    bool self = form.buffer == this;
+    WireBuffer *expected = nullptr;
+    if (!self)
+    {
+        form.buffer->retain(); // The reference the cache slot keeps
+    }
+    if (encoding.compare_exchange_strong(expected, form.buffer, std::memory_order_acq_rel))
+    {
+        return form;
+    }
+
+    // Lost the race: use the winner's encoding
+    if (!self)
+    {
+        form.buffer->release();
+    }
+    expected->retain();
+    return WireRef(expected);
+}
+
+void WireBuffer::retain()
+{
+    refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WireBuffer::release()
+{
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        WireBuffer *cached = encoding.load(std::memory_order_relaxed);
+        this->~WireBuffer();
+        ::operator delete(this);
+        if (cached && cached != this)
+        {
+            cached->release();
+        }
+    }
+}
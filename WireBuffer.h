@@ -0,0 +1,115 @@
+#ifndef WIREBUFFER_H
+#define WIREBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <utility>
+
+class WireRef;
+
+// Immutable, framed ("...\n") message bytes shared by every recipient of a
+// broadcast. Header and payload live in one allocation; the reference count is
+// intrusive, so handing the buffer to another outbound queue is an atomic
+// increment rather than an allocation and copy.
+//
+// A buffer can carry its next encoding alongside (a text line its binary
+// frame, a binary frame its compressed form), made by the first recipient
+// that needs it and reused by the rest.
+class WireBuffer
+{
+private:
+    std::atomic<uint32_t> refs;
+    uint32_t length;
+    bool binary;                                // Binary-protocol frame rather than a text line
+    mutable std::atomic<WireBuffer *> encoding; // Cached re-encoding; owns one reference
+
+    WireBuffer(size_t size, bool isBinary);
+    static WireRef allocate(size_t size, bool isBinary); // Contents left for the caller to write
+    static WireRef build(std::string_view prefix, std::initializer_list<std::string_view> parts, bool isBinary);
+
+    friend class WireRef;
+    void retain();
+    void release();
+
+public:
+    WireBuffer(const WireBuffer &) = delete;
+    WireBuffer &operator=(const WireBuffer &) = delete;
+
+    // Frames the message once; returns a null ref if it exceeds BINARY_MAX_FRAME.
+    // Text clients only accept lines up to MAX_BUFFER_SIZE; Client::sendWire
+    // enforces that per recipient.
+    static WireRef frame(std::string_view message);
+
+    // Same, concatenating the parts directly into the buffer ("MSG ", user, " ", text)
+    static WireRef frame(std::initializer_list<std::string_view> parts);
+
+    // A binary-protocol frame: its encoded header followed by the body parts
+    static WireRef binaryFrame(std::string_view header, std::initializer_list<std::string_view> body);
+
+    // Bytes already encoded for one connection, copied as they are: no
+    // framing, no size limit, never re-encoded for another recipient
+    static WireRef raw(std::string_view bytes);
+
+    // Same, written in place: fill(char *) stores exactly `size` bytes. For a
+    // reply of many lines or frames that should cost one allocation.
+    template <typename Fill>
+    static WireRef raw(size_t size, Fill fill);
+
+    const char *data() const { return reinterpret_cast<const char *>(this + 1); }
+    size_t size() const { return length; }
+    bool isBinary() const { return binary; }
+
+    // The cached re-encoding of this buffer, or a null ref
+    WireRef encodedForm() const;
+
+    // Caches form unless another thread got there first; returns the cached one.
+    // Caching the buffer itself records that it has no better encoding.
+    WireRef cacheEncodedForm(WireRef form) const;
+};
+
+// Owning handle to a WireBuffer
+class WireRef
+{
+private:
+    WireBuffer *buffer;
+
+    friend class WireBuffer;
+
+public:
+    WireRef() : buffer(nullptr) {}
+    explicit WireRef(WireBuffer *adopted) : buffer(adopted) {}
+    WireRef(const WireRef &other) : buffer(other.buffer)
+    {
+        if (buffer)
+            buffer->retain();
+    }
+    WireRef(WireRef &&other) noexcept : buffer(other.buffer) { other.buffer = nullptr; }
+    ~WireRef()
+    {
+        if (buffer)
+            buffer->release();
+    }
+
+    WireRef &operator=(WireRef other) noexcept
+    {
+        std::swap(buffer, other.buffer);
+        return *this;
+    }
+
+    explicit operator bool() const { return buffer != nullptr; }
+    const WireBuffer *operator->() const { return buffer; }
+    const WireBuffer &operator*() const { return *buffer; }
+};
+
+template <typename Fill>
+WireRef WireBuffer::raw(size_t size, Fill fill)
+{
+    WireRef wire = allocate(size, true);
+    fill(reinterpret_cast<char *>(wire.buffer + 1));
+    return wire;
+}
+
+#endif
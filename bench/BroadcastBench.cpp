@@ -0,0 +1,167 @@
+// Broadcast benchmark: logs in N receivers and one sender, then sends M chat
+// messages one after another and measures how long each takes to reach the
+// last receiver. Run it against the server started with each --io backend
+// (threads, epoll, uring) to compare them.
+//
+// Usage: ./BroadcastBench [port] [receivers] [messages]
+
+#include "../socketCompat.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+using Clock = std::chrono::steady_clock;
+
+static SOCKET openConnection(int port)
+{
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET)
+    {
+        return INVALID_SOCKET;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    if (connect(s, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return s;
+}
+
+static bool sendLine(SOCKET s, const std::string &line)
+{
+    std::string framed = line + "\n";
+    return send(s, framed.c_str(), framed.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(framed.size());
+}
+
+// Discards everything currently readable on the given sockets
+static void drain(std::vector<pollfd> &fds, int quietMs)
+{
+    char buffer[65536];
+    while (poll(fds.data(), fds.size(), quietMs) > 0)
+    {
+        for (auto &pfd : fds)
+        {
+            if (pfd.revents & POLLIN)
+            {
+                (void)!recv(pfd.fd, buffer, sizeof(buffer), 0);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int port = argc >= 2 ? std::atoi(argv[1]) : 4000;
+    int receivers = argc >= 3 ? std::atoi(argv[2]) : 1000;
+    int messages = argc >= 4 ? std::atoi(argv[3]) : 200;
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    SOCKET sender = openConnection(port);
+    if (sender == INVALID_SOCKET || !sendLine(sender, "LOGIN bench-sender"))
+    {
+        std::cerr << "Cannot connect sender to port " << port << std::endl;
+        return 1;
+    }
+
+    std::vector<pollfd> fds;
+    for (int i = 0; i < receivers; ++i)
+    {
+        SOCKET s = openConnection(port);
+        if (s == INVALID_SOCKET)
+        {
+            std::cerr << "connect failed after " << i << " receivers: " << strerror(errno) << std::endl;
+            return 1;
+        }
+        sendLine(s, "LOGIN bench-rx" + std::to_string(i));
+        fds.push_back(pollfd{s, POLLIN, 0});
+    }
+
+    // Swallow the login notifications before measuring
+    fds.push_back(pollfd{sender, POLLIN, 0});
+    drain(fds, 500);
+    fds.pop_back();
+
+    std::vector<double> latenciesUs;
+    latenciesUs.reserve(messages);
+    std::vector<int> pendingLines(receivers);
+    char buffer[65536];
+
+    auto benchStart = Clock::now();
+    for (int m = 0; m < messages; ++m)
+    {
+        std::fill(pendingLines.begin(), pendingLines.end(), 1);
+        int outstanding = receivers;
+
+        auto start = Clock::now();
+        sendLine(sender, "MSG bench payload " + std::to_string(m));
+
+        while (outstanding > 0)
+        {
+            if (poll(fds.data(), fds.size(), 5000) <= 0)
+            {
+                std::cerr << "Timed out waiting for message " << m << " (" << outstanding << " receivers missing)" << std::endl;
+                return 1;
+            }
+
+            for (size_t i = 0; i < fds.size(); ++i)
+            {
+                if (!(fds[i].revents & POLLIN))
+                {
+                    continue;
+                }
+                ssize_t n = recv(fds[i].fd, buffer, sizeof(buffer), 0);
+                if (n <= 0)
+                {
+                    std::cerr << "Receiver " << i << " disconnected" << std::endl;
+                    return 1;
+                }
+                int lines = static_cast<int>(std::count(buffer, buffer + n, '\n'));
+                int counted = std::min(lines, pendingLines[i]);
+                pendingLines[i] -= counted;
+                outstanding -= counted;
+            }
+        }
+
+        latenciesUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    double totalSeconds = std::chrono::duration<double>(Clock::now() - benchStart).count();
+
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    auto percentile = [&](double p)
+    {
+        return latenciesUs[std::min(latenciesUs.size() - 1, static_cast<size_t>(p * latenciesUs.size()))];
+    };
+
+    double deliveries = static_cast<double>(messages) * receivers;
+    std::cout << "receivers,messages,deliveries_per_sec,p50_us,p99_us,max_us" << std::endl;
+    std::cout << receivers << "," << messages << "," << static_cast<long>(deliveries / totalSeconds) << ","
+              << percentile(0.50) << "," << percentile(0.99) << "," << latenciesUs.back() << std::endl;
+
+    for (auto &pfd : fds)
+    {
+        closesocket(pfd.fd);
+    }
+    closesocket(sender);
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Command parsing benchmark: parses and dispatches a mix of MSG, DM, WHO and
+// PING lines the old way (trimmed copy, istringstream, std::transform and an
+// if/else chain) and through CommandTable, and reports ns and heap
+// allocations per command. Handlers are no-ops, so only parsing and dispatch
+// are measured.
+//
+// Usage: ./CommandBench [iterations]
+
+#include "../CommandTable.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<long> allocations(0);
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+static size_t sink = 0; // Keeps the parsed fields observable
+
+static std::string trim(const std::string &str)
+{
+    size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+        return "";
+    size_t last = str.find_last_not_of(" \t\r\n");
+    return str.substr(first, (last - first + 1));
+}
+
+// The parser ChatListener used before CommandTable
+static void parseLegacy(std::string_view line)
+{
+    std::string trimmedMessage = trim(std::string(line));
+    std::istringstream iss(trimmedMessage);
+    std::string command;
+    iss >> command;
+    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+
+    if (command == "LOGIN")
+    {
+        std::string username;
+        iss >> username;
+        sink += username.size();
+    }
+    else if (command == "PING")
+    {
+        ++sink;
+    }
+    else if (command == "MSG")
+    {
+        std::string msg;
+        std::getline(iss, msg);
+        sink += trim(msg).size();
+    }
+    else if (command == "WHO")
+    {
+        ++sink;
+    }
+    else if (command == "DM")
+    {
+        std::string remainingMessage;
+        std::getline(iss, remainingMessage);
+        std::istringstream dm(trim(remainingMessage));
+        std::string target;
+        dm >> target;
+        std::string text;
+        std::getline(dm, text);
+        sink += target.size() + trim(text).size();
+    }
+}
+
+static double run(const std::vector<std::string> &lines, int iterations, bool legacy, const CommandTable &table, double &allocsPerCommand)
+{
+    std::shared_ptr<Client> client;
+    long before = allocations.load();
+    auto start = Clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (const std::string &line : lines)
+        {
+            if (legacy)
+            {
+                parseLegacy(line);
+                continue;
+            }
+            std::string_view args = line;
+            std::string_view name = CommandText::nextToken(args);
+            if (const CommandTable::Entry *command = table.find(name))
+            {
+                command->handler(client, args);
+            }
+        }
+    }
+
+    double commands = static_cast<double>(iterations) * lines.size();
+    allocsPerCommand = (allocations.load() - before) / commands;
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / commands;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    CommandTable table;
+    table.add("LOGIN", [](const std::shared_ptr<Client> &, std::string_view args)
+              { sink += CommandText::nextToken(args).size(); }, false);
+    table.add("PING", [](const std::shared_ptr<Client> &, std::string_view)
+              { ++sink; }, false);
+    table.add("MSG", [](const std::shared_ptr<Client> &, std::string_view args)
+              { sink += CommandText::trim(args).size(); });
+    table.add("WHO", [](const std::shared_ptr<Client> &, std::string_view)
+              { ++sink; });
+    table.add("DM", [](const std::shared_ptr<Client> &, std::string_view args)
+              {
+                  std::string_view target = CommandText::nextToken(args);
+                  sink += target.size() + CommandText::trim(args).size(); });
+
+    std::vector<std::string> lines = {
+        "MSG hello everyone, this is a typical chat line of moderate length",
+        "msg short",
+        "DM bob are you around for a quick call later today?",
+        "WHO",
+        "PING",
+    };
+
+    double legacyAllocs, tableAllocs;
+    double legacyNs = run(lines, iterations, true, table, legacyAllocs);
+    double tableNs = run(lines, iterations, false, table, tableAllocs);
+
+    std::cout << "parser,ns_per_command,allocs_per_command" << std::endl;
+    std::cout << "legacy," << legacyNs << "," << legacyAllocs << std::endl;
+    std::cout << "table," << tableNs << "," << tableAllocs << std::endl;
+    return sink == 0; // Never true; stops the work being optimized away
+}
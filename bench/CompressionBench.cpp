@@ -0,0 +1,194 @@
+// Compression benchmark: builds a synthetic stream of binary-protocol MSG
+// frames (Zipf-distributed words, a few dozen senders and rooms) and
+// compresses it four ways:
+//
+//   none    frames sent as they are
+//   frame   raw deflate per frame, no dictionary
+//   dict    Compression::deflateFrame: per frame with the preset dictionary,
+//           frames under DEFLATE_MIN_FRAME left alone (what the server sends)
+//   stream  one deflate stream per connection, Z_SYNC_FLUSH after each frame
+//
+// A per-frame result is shared by every recipient of a broadcast; a
+// per-connection stream has to compress the frame again for each of them.
+// For each fan-out it reports wire bytes per recipient and CPU per broadcast.
+//
+// Usage: ./CompressionBench [messages] [seed]
+
+#include "../BinaryProtocol.h"
+#include "../Compression.h"
+#include "../serverDefaults.h"
+#include <zlib.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const char *vocabulary[] = {
+    "the", "to", "and", "a", "i", "you", "it", "is", "that", "of", "in", "for", "on", "this", "we",
+    "be", "with", "have", "just", "not", "but", "so", "are", "can", "if", "was", "at", "what", "do",
+    "lol", "yeah", "ok", "think", "know", "like", "get", "one", "will", "all", "there", "now",
+    "build", "test", "deploy", "release", "merge", "review", "fixed", "broken", "branch", "server",
+    "client", "latency", "thanks", "sure", "later", "today", "tomorrow", "meeting", "anyone", "here",
+    "morning", "night", "coffee", "lunch", "weekend", "issue", "ticket", "logs", "error", "works",
+    "again", "maybe", "really", "should", "could", "would", "because", "about", "people", "time",
+    "queue", "socket", "buffer", "thread", "kernel", "packet", "timeout", "retry", "config", "cache"};
+
+static const char *rooms[] = {DEFAULT_ROOM, "#general", "#random", "#ops", "#dev", "#release", "#support", "#offtopic"};
+
+static std::vector<std::string> makeMessages(size_t count, unsigned seed)
+{
+    const size_t words = sizeof(vocabulary) / sizeof(vocabulary[0]);
+    std::vector<double> weights(words);
+    for (size_t i = 0; i < words; ++i)
+    {
+        weights[i] = 1.0 / std::pow(static_cast<double>(i + 1), 1.1); // Zipf-like
+    }
+
+    std::mt19937 rng(seed);
+    std::discrete_distribution<size_t> word(weights.begin(), weights.end());
+    std::geometric_distribution<int> extraWords(0.08); // Mean line ~12 words, a long tail
+    std::uniform_int_distribution<uint64_t> sender(1, 40);
+    std::discrete_distribution<size_t> room({40, 15, 10, 8, 8, 5, 5, 4});
+
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::string text;
+        int length = 1 + extraWords(rng);
+        for (int w = 0; w < length; ++w)
+        {
+            if (w)
+                text += ' ';
+            text += vocabulary[word(rng)];
+        }
+
+        std::string_view roomName = rooms[room(rng)];
+        char id[8];
+        BinaryProtocol::putU64(id, sender(rng));
+        char roomLength = static_cast<char>(roomName.size());
+        WireRef frame = BinaryProtocol::encode(BinaryProtocol::Opcode::Message,
+                                               {std::string_view(id, sizeof(id)), std::string_view(&roomLength, 1), roomName, text});
+        frames.emplace_back(frame->data(), frame->size());
+    }
+    return frames;
+}
+
+struct Result
+{
+    const char *name;
+    bool perConnection; // Work repeats for every recipient
+    double bytesPerMessage;
+    double nsPerMessage;
+};
+
+static Result runNone(const std::vector<std::string> &frames)
+{
+    size_t bytes = 0;
+    for (const std::string &frame : frames)
+    {
+        bytes += frame.size();
+    }
+    return {"none", false, static_cast<double>(bytes) / frames.size(), 0.0};
+}
+
+static Result runFrame(const std::vector<std::string> &frames)
+{
+    z_stream stream{};
+    deflateInit2(&stream, DEFLATE_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    std::vector<char> output;
+    size_t bytes = 0;
+
+    auto start = Clock::now();
+    for (const std::string &frame : frames)
+    {
+        deflateReset(&stream);
+        output.resize(deflateBound(&stream, static_cast<uLong>(frame.size())));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(frame.data()));
+        stream.avail_in = static_cast<uInt>(frame.size());
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        deflate(&stream, Z_FINISH);
+        size_t compressed = output.size() - stream.avail_out + BinaryProtocol::LENGTH_SIZE + 1;
+        bytes += compressed < frame.size() ? compressed : frame.size();
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    deflateEnd(&stream);
+    return {"frame", false, static_cast<double>(bytes) / frames.size(), ns / frames.size()};
+}
+
+static Result runDictionary(const std::vector<std::string> &frames)
+{
+    // Fresh buffers, as the server would have: deflateFrame caches on them
+    std::vector<WireRef> buffers;
+    buffers.reserve(frames.size());
+    for (const std::string &frame : frames)
+    {
+        buffers.push_back(WireBuffer::binaryFrame(std::string_view(frame.data(), BinaryProtocol::LENGTH_SIZE + 1),
+                                                  {std::string_view(frame).substr(BinaryProtocol::LENGTH_SIZE + 1)}));
+    }
+
+    size_t bytes = 0;
+    auto start = Clock::now();
+    for (const WireRef &buffer : buffers)
+    {
+        WireRef deflated = buffer->size() >= DEFLATE_MIN_FRAME ? Compression::deflateFrame(buffer) : WireRef();
+        bytes += deflated ? deflated->size() : buffer->size();
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return {"dict", false, static_cast<double>(bytes) / frames.size(), ns / frames.size()};
+}
+
+static Result runStream(const std::vector<std::string> &frames)
+{
+    z_stream stream{};
+    deflateInit2(&stream, DEFLATE_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    std::string_view dict = Compression::dictionary();
+    deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dict.data()), static_cast<uInt>(dict.size()));
+    std::vector<char> output;
+    size_t bytes = 0;
+
+    auto start = Clock::now();
+    for (const std::string &frame : frames)
+    {
+        output.resize(deflateBound(&stream, static_cast<uLong>(frame.size())) + 16);
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(frame.data()));
+        stream.avail_in = static_cast<uInt>(frame.size());
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        deflate(&stream, Z_SYNC_FLUSH);
+        bytes += output.size() - stream.avail_out; // A stream needs no per-frame header
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    deflateEnd(&stream);
+    return {"stream", true, static_cast<double>(bytes) / frames.size(), ns / frames.size()};
+}
+
+int main(int argc, char *argv[])
+{
+    size_t messages = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 200000;
+    unsigned seed = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 1;
+
+    std::vector<std::string> frames = makeMessages(messages, seed);
+    std::vector<Result> results = {runNone(frames), runFrame(frames), runDictionary(frames), runStream(frames)};
+    double baseline = results[0].bytesPerMessage;
+
+    std::cout << "mode,fanout,bytes_per_recipient,ratio,ns_per_broadcast" << std::endl;
+    for (int fanout : {1, 10, 100})
+    {
+        for (const Result &result : results)
+        {
+            double ns = result.perConnection ? result.nsPerMessage * fanout : result.nsPerMessage;
+            std::cout << result.name << "," << fanout << "," << result.bytesPerMessage << ","
+                      << result.bytesPerMessage / baseline << "," << ns << std::endl;
+        }
+    }
+    return 0;
+}
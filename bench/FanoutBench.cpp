@@ -0,0 +1,124 @@
+// Fan-out microbenchmark: queues one broadcast for N recipients the old way
+// (a framed std::string copy per recipient) and the shared way (one framed
+// WireBuffer, a reference per recipient), and reports time and heap
+// allocations per recipient. No sockets are involved; it measures only the
+// work the server does before the write syscalls.
+//
+// Usage: ./FanoutBench [messages]
+
+#include "../OutboundQueue.h"
+#include "../WireBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<long> allocations(0);
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+struct Result
+{
+    double nsPerRecipient;
+    double allocationsPerRecipient;
+};
+
+// Old path: Client::sendMessage built message + "\n" for every recipient
+static Result runCopies(size_t recipients, int messages, const std::string &message)
+{
+    std::vector<std::deque<std::string>> queues(recipients);
+    for (auto &queue : queues)
+    {
+        queue.push_back(message); // Warm up: let every deque allocate its first block
+        queue.pop_front();
+    }
+    long before = allocations.load();
+    auto start = Clock::now();
+
+    for (int m = 0; m < messages; ++m)
+    {
+        for (auto &queue : queues)
+        {
+            std::string fullMessage = message + "\n";
+            queue.push_back(std::move(fullMessage));
+        }
+        for (auto &queue : queues)
+        {
+            queue.pop_front(); // Written to the socket
+        }
+    }
+
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    double total = static_cast<double>(recipients) * messages;
+    return Result{elapsed / total, (allocations.load() - before) / total};
+}
+
+// New path: frame once, queue a reference per recipient
+static Result runShared(size_t recipients, int messages, const std::string &message)
+{
+    std::vector<OutboundQueue> queues(recipients);
+    for (auto &queue : queues)
+    {
+        queue.push_back(WireBuffer::frame(message)); // Warm up: let every ring allocate its slots
+        queue.pop_front();
+    }
+    long before = allocations.load();
+    auto start = Clock::now();
+
+    for (int m = 0; m < messages; ++m)
+    {
+        WireRef payload = WireBuffer::frame(message);
+        for (auto &queue : queues)
+        {
+            queue.push_back(payload);
+        }
+        for (auto &queue : queues)
+        {
+            queue.pop_front();
+        }
+    }
+
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    double total = static_cast<double>(recipients) * messages;
+    return Result{elapsed / total, (allocations.load() - before) / total};
+}
+
+int main(int argc, char *argv[])
+{
+    int messages = argc > 1 ? std::atoi(argv[1]) : 200;
+    std::string message = "MSG alice " + std::string(100, 'x'); // Past the small-string buffer, like real chat lines
+
+    std::cout << "recipients,path,ns_per_recipient,allocs_per_recipient" << std::endl;
+    for (size_t recipients : {10, 1000, 10000})
+    {
+        Result copies = runCopies(recipients, messages, message);
+        Result shared = runShared(recipients, messages, message);
+        std::cout << recipients << ",copy," << copies.nsPerRecipient << "," << copies.allocationsPerRecipient << std::endl;
+        std::cout << recipients << ",shared," << shared.nsPerRecipient << "," << shared.allocationsPerRecipient << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Connection-count benchmark: opens N idle (optionally logged-in) connections
+// against a running ChatServer and samples the server's resident memory and
+// thread count from /proc as the connection count grows.
+//
+// Usage: ./IdleConnections <server-pid> [port] [connections] [step] [--login]
+
+#include "../socketCompat.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+
+static long readStatusField(int pid, const std::string &field)
+{
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size(), field) == 0)
+        {
+            return std::atol(line.c_str() + field.size());
+        }
+    }
+    return -1;
+}
+
+static SOCKET openConnection(int port)
+{
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET)
+    {
+        return INVALID_SOCKET;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    if (connect(s, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+    {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <server-pid> [port] [connections] [step] [--login]" << std::endl;
+        return 1;
+    }
+
+    int pid = std::atoi(argv[1]);
+    int port = argc >= 3 ? std::atoi(argv[2]) : 4000;
+    int total = argc >= 4 ? std::atoi(argv[3]) : 5000;
+    int step = argc >= 5 ? std::atoi(argv[4]) : 500;
+    bool login = argc >= 6 && std::strcmp(argv[5], "--login") == 0;
+
+    // Each connection costs one descriptor here and one in the server
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    long baseRss = readStatusField(pid, "VmRSS:");
+    if (baseRss < 0)
+    {
+        std::cerr << "Cannot read /proc/" << pid << "/status" << std::endl;
+        return 1;
+    }
+
+    std::cout << "connections,rss_kb,threads,kb_per_connection" << std::endl;
+    std::cout << 0 << "," << baseRss << "," << readStatusField(pid, "Threads:") << ",0" << std::endl;
+
+    std::vector<SOCKET> sockets;
+    sockets.reserve(total);
+
+    while (static_cast<int>(sockets.size()) < total)
+    {
+        for (int i = 0; i < step && static_cast<int>(sockets.size()) < total; ++i)
+        {
+            SOCKET s = openConnection(port);
+            if (s == INVALID_SOCKET)
+            {
+                std::cerr << "connect failed after " << sockets.size() << " connections: " << strerror(errno) << std::endl;
+                total = static_cast<int>(sockets.size());
+                break;
+            }
+            if (login)
+            {
+                std::string cmd = "LOGIN bench" + std::to_string(sockets.size()) + "\n";
+                send(s, cmd.c_str(), cmd.size(), MSG_NOSIGNAL);
+            }
+            sockets.push_back(s);
+        }
+
+        // Give the server time to accept and settle before sampling
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        long rss = readStatusField(pid, "VmRSS:");
+        long threads = readStatusField(pid, "Threads:");
+        double perConnection = sockets.empty() ? 0.0 : static_cast<double>(rss - baseRss) / sockets.size();
+        std::cout << sockets.size() << "," << rss << "," << threads << "," << perConnection << std::endl;
+    }
+
+    for (SOCKET s : sockets)
+    {
+        closesocket(s);
+    }
+    return 0;
+}
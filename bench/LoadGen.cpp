@@ -0,0 +1,432 @@
+// Load generator: drives many simulated users against a running ChatServer
+// through ChatClient. Users log in at a fixed rate; once all of them are in,
+// each one sends commands at random (Poisson) intervals from a MSG/DM/WHO
+// mix for the given duration. MSG and DM text carries its send time, so
+// every delivery gives an end-to-end latency; WHO is followed by a PING and
+// timed until the PONG comes back.
+//
+// Usage: ./LoadGen [--host=127.0.0.1] [--port=4000] [--users=1000]
+//                  [--threads=4] [--login-rate=500] [--rate=0.2]
+//                  [--mix=80,15,5] [--size=64] [--duration=10]
+//                  [--prefix=load]
+//
+//   --login-rate  LOGINs per second while ramping up
+//   --rate        commands per second per user
+//   --mix         MSG,DM,WHO percentages
+//   --size        bytes of text per MSG/DM
+
+#include "../ChatClient.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    int port = 4000;
+    int users = 1000;
+    int threads = 4;
+    double loginRate = 500;
+    double rate = 0.2;
+    int mix[3] = {80, 15, 5}; // MSG, DM, WHO
+    int size = 64;
+    double duration = 10;
+    std::string prefix = "load";
+};
+
+enum Kind
+{
+    Msg,
+    Dm,
+    Who,
+    Login,
+    KindCount
+};
+
+static const char *kindNames[KindCount] = {"msg", "dm", "who", "login"};
+
+struct Stats
+{
+    long sent[KindCount] = {};
+    long delivered[KindCount] = {};
+    std::vector<double> latencyUs[KindCount];
+    long errors = 0;
+    long disconnects = 0;
+};
+
+struct User
+{
+    ChatClient client;
+    std::string name;
+    bool loggedIn = false;
+    Clock::time_point loginSent;
+    Clock::time_point nextSend;
+    std::deque<Clock::time_point> pings; // WHOs awaiting their PONG
+
+    User(const Options &options, std::string username)
+        : client(options.host, options.port), name(std::move(username)) {}
+};
+
+// Shared between the workers and main, in steady_clock nanoseconds
+static std::atomic<int> loggedInUsers(0);
+static std::atomic<int> failedUsers(0);
+static std::atomic<long long> trafficStart(0);
+static std::atomic<long long> trafficEnd(0);
+static std::atomic<bool> stopping(false);
+
+static long long nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static Clock::time_point fromNs(long long ns)
+{
+    return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+static std::string_view nextToken(std::string_view &rest)
+{
+    size_t space = rest.find(' ');
+    std::string_view token = rest.substr(0, space);
+    rest = space == std::string_view::npos ? std::string_view() : rest.substr(space + 1);
+    return token;
+}
+
+// Latency of a "<send time> <padding>" text, if it is one of ours
+static bool recordDelivery(std::string_view text, Kind kind, Stats &stats)
+{
+    std::string_view stamp = nextToken(text);
+    long long sentNs = 0;
+    for (char digit : stamp)
+    {
+        if (digit < '0' || digit > '9')
+            return false;
+        sentNs = sentNs * 10 + (digit - '0');
+    }
+    if (sentNs < trafficStart.load(std::memory_order_relaxed))
+        return false;
+
+    stats.delivered[kind]++;
+    stats.latencyUs[kind].push_back((nowNs() - sentNs) / 1000.0);
+    return true;
+}
+
+static void handleLine(User &user, std::string_view line, Stats &stats)
+{
+    std::string_view rest = line;
+    std::string_view kind = nextToken(rest);
+
+    if (kind == "MSG")
+    {
+        nextToken(rest); // Sender
+        recordDelivery(rest, Msg, stats);
+    }
+    else if (kind == "DM")
+    {
+        nextToken(rest);
+        recordDelivery(rest, Dm, stats);
+    }
+    else if (kind == "PONG" && !user.pings.empty())
+    {
+        stats.delivered[Who]++;
+        stats.latencyUs[Who].push_back(std::chrono::duration<double, std::micro>(Clock::now() - user.pings.front()).count());
+        user.pings.pop_front();
+    }
+    else if (kind == "OK" && !user.loggedIn)
+    {
+        user.loggedIn = true;
+        stats.delivered[Login]++;
+        stats.latencyUs[Login].push_back(std::chrono::duration<double, std::micro>(Clock::now() - user.loginSent).count());
+        loggedInUsers.fetch_add(1);
+    }
+    else if (kind == "ERR")
+    {
+        if (!user.loggedIn)
+        {
+            std::cerr << user.name << ": LOGIN refused: " << line << std::endl;
+            failedUsers.fetch_add(1);
+        }
+        stats.errors++;
+    }
+}
+
+static void sendCommand(User &user, const Options &options, const std::vector<std::string> &names,
+                        std::mt19937 &rng, Stats &stats)
+{
+    std::uniform_int_distribution<int> pick(0, 99);
+    int roll = pick(rng);
+    Kind kind = roll < options.mix[Msg] ? Msg : roll < options.mix[Msg] + options.mix[Dm] ? Dm : Who;
+
+    std::string line;
+    if (kind == Who)
+    {
+        line = "WHO\nPING";
+        user.pings.push_back(Clock::now());
+    }
+    else
+    {
+        std::string text = std::to_string(nowNs()) + " ";
+        if (static_cast<int>(text.size()) < options.size)
+        {
+            text.append(options.size - text.size(), 'x');
+        }
+        if (kind == Msg)
+        {
+            line = "MSG " + text;
+        }
+        else
+        {
+            std::uniform_int_distribution<size_t> target(0, names.size() - 1);
+            std::string_view to = names[target(rng)];
+            if (to == user.name)
+                to = names[(target(rng) + 1) % names.size()];
+            line = "DM " + std::string(to) + " " + text;
+        }
+    }
+
+    if (user.client.sendMessage(line))
+    {
+        stats.sent[kind]++;
+    }
+}
+
+static void worker(int index, const Options &options, const std::vector<std::string> &names, Stats &stats)
+{
+    std::vector<std::unique_ptr<User>> users;
+    for (size_t i = index; i < names.size(); i += options.threads)
+    {
+        users.push_back(std::make_unique<User>(options, names[i]));
+    }
+
+    std::vector<pollfd> fds(users.size(), pollfd{INVALID_SOCKET, POLLIN, 0});
+    std::mt19937 rng(static_cast<unsigned>(index + 1));
+    std::exponential_distribution<double> gap(options.rate > 0 ? options.rate : 1);
+    std::vector<std::string> lines;
+
+    auto rampStart = Clock::now();
+    auto loginInterval = std::chrono::duration<double>(options.threads / options.loginRate);
+    size_t started = 0;
+    bool scheduled = false;
+
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        auto now = Clock::now();
+
+        // Ramp-up: this thread's share of the login rate
+        while (started < users.size() && now >= rampStart + std::chrono::duration_cast<Clock::duration>(loginInterval * started))
+        {
+            User &user = *users[started];
+            if (user.client.connect())
+            {
+                int one = 1;
+                setsockopt(user.client.getSocket(), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
+                user.loginSent = Clock::now();
+                user.client.sendMessage("LOGIN " + user.name);
+                fds[started].fd = user.client.getSocket();
+                stats.sent[Login]++;
+            }
+            else
+            {
+                failedUsers.fetch_add(1);
+            }
+            ++started;
+        }
+
+        long long start = trafficStart.load(std::memory_order_relaxed);
+        if (start && options.rate > 0 && now < fromNs(trafficEnd.load(std::memory_order_relaxed)))
+        {
+            if (!scheduled)
+            {
+                for (auto &user : users)
+                {
+                    user->nextSend = fromNs(start) + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap(rng)));
+                }
+                scheduled = true;
+            }
+            for (auto &user : users)
+            {
+                if (user->loggedIn && user->client.isConnected() && user->nextSend <= now)
+                {
+                    sendCommand(*user, options, names, rng, stats);
+                    user->nextSend += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap(rng)));
+                }
+            }
+        }
+
+        if (pollSockets(fds.data(), fds.size(), 1) <= 0)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+            User &user = *users[i];
+            lines.clear();
+            if (user.client.receiveLines(lines) <= 0)
+            {
+                if (!user.loggedIn)
+                    failedUsers.fetch_add(1);
+                stats.disconnects++;
+                user.client.disconnect();
+                fds[i].fd = INVALID_SOCKET;
+                continue;
+            }
+            for (const std::string &line : lines)
+            {
+                handleLine(user, line, stats);
+            }
+        }
+    }
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+        {
+            return false;
+        }
+        std::string name = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+
+        if (name == "host")
+            options.host = value;
+        else if (name == "port")
+            options.port = std::atoi(value.c_str());
+        else if (name == "users")
+            options.users = std::atoi(value.c_str());
+        else if (name == "threads")
+            options.threads = std::atoi(value.c_str());
+        else if (name == "login-rate")
+            options.loginRate = std::atof(value.c_str());
+        else if (name == "rate")
+            options.rate = std::atof(value.c_str());
+        else if (name == "size")
+            options.size = std::atoi(value.c_str());
+        else if (name == "duration")
+            options.duration = std::atof(value.c_str());
+        else if (name == "prefix")
+            options.prefix = value;
+        else if (name == "mix")
+        {
+            int msg = 0, dm = 0, who = 0;
+            if (std::sscanf(value.c_str(), "%d,%d,%d", &msg, &dm, &who) != 3 || msg < 0 || dm < 0 || who < 0 || msg + dm + who != 100)
+                return false;
+            options.mix[Msg] = msg;
+            options.mix[Dm] = dm;
+            options.mix[Who] = who;
+        }
+        else
+            return false;
+    }
+
+    // Keep "DM <user> <text>" inside the server's line limit
+    int longest = MAX_BUFFER_SIZE - 1 - static_cast<int>(std::string("DM  ").size() + options.prefix.size() + 10);
+    options.size = std::min(options.size, longest);
+    return options.users > 1 && options.threads > 0 && options.loginRate > 0 && options.rate >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--host=127.0.0.1] [--port=4000] [--users=1000] [--threads=4]"
+                  << " [--login-rate=500] [--rate=0.2] [--mix=80,15,5] [--size=64] [--duration=10] [--prefix=load]" << std::endl;
+        return 1;
+    }
+    options.threads = std::min(options.threads, options.users);
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::vector<std::string> names;
+    for (int i = 0; i < options.users; ++i)
+    {
+        names.push_back(options.prefix + std::to_string(i));
+    }
+
+    std::vector<Stats> stats(options.threads);
+    std::vector<std::thread> workers;
+    auto rampStart = Clock::now();
+    for (int i = 0; i < options.threads; ++i)
+    {
+        workers.emplace_back(worker, i, std::cref(options), std::cref(names), std::ref(stats[i]));
+    }
+
+    // Traffic starts once every user has logged in (or failed to)
+    auto rampDeadline = rampStart + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(options.users / options.loginRate + 10));
+    while (loggedInUsers.load() + failedUsers.load() < options.users && Clock::now() < rampDeadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double rampSeconds = std::chrono::duration<double>(Clock::now() - rampStart).count();
+    std::cerr << loggedInUsers.load() << "/" << options.users << " users logged in after " << rampSeconds << " s" << std::endl;
+
+    long long start = nowNs();
+    trafficEnd.store(start + static_cast<long long>(options.duration * 1e9));
+    trafficStart.store(start);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    std::this_thread::sleep_for(std::chrono::seconds(2)); // Let in-flight deliveries land
+    stopping.store(true);
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+
+    Stats total;
+    for (Stats &part : stats)
+    {
+        for (int kind = 0; kind < KindCount; ++kind)
+        {
+            total.sent[kind] += part.sent[kind];
+            total.delivered[kind] += part.delivered[kind];
+            total.latencyUs[kind].insert(total.latencyUs[kind].end(), part.latencyUs[kind].begin(), part.latencyUs[kind].end());
+        }
+        total.errors += part.errors;
+        total.disconnects += part.disconnects;
+    }
+
+    std::cout << "kind,sent,sent_per_sec,delivered,delivered_per_sec,p50_us,p99_us,p999_us,max_us" << std::endl;
+    for (int kind = 0; kind < KindCount; ++kind)
+    {
+        std::vector<double> &latencies = total.latencyUs[kind];
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p)
+        {
+            return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+        };
+
+        double seconds = kind == Login ? rampSeconds : options.duration;
+        std::cout << kindNames[kind] << "," << total.sent[kind] << "," << static_cast<long>(total.sent[kind] / seconds) << ","
+                  << total.delivered[kind] << "," << static_cast<long>(total.delivered[kind] / seconds) << ","
+                  << percentile(0.50) << "," << percentile(0.99) << "," << percentile(0.999) << ","
+                  << (latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+    }
+    std::cerr << "errors: " << total.errors << ", disconnects: " << total.disconnects << std::endl;
+    return loggedInUsers.load() == options.users ? 0 : 1;
+}
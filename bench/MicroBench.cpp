@@ -0,0 +1,288 @@
+// Microbenchmarks for the server's hot paths, run against the real server
+// code with in-memory clients (no sockets, no event loop):
+//
+//   handleMessage/*   ChatListener parsing and dispatch of one command line
+//   fanout/N          BroadcastService::chatMessage to a room of N
+//   lookup/*/N        findClientByUsername / isUsernameTaken with N users
+//   sendMessage/B     Client::sendMessage framing and queueing of B bytes
+//
+// Each benchmark runs in batches until --min-time seconds have passed, five
+// times over; the median and fastest ns per operation are written to stdout
+// as JSON, so results can be kept and compared from release to release.
+//
+// Usage: ./MicroBench [--filter=substring] [--min-time=0.2]
+
+#include "../ChatServer.h"
+#include "../ChatListener.h"
+#include "../ClientPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Stands in for a socket: queueing refuses clients whose socket is invalid
+static SOCKET placeholderSocket()
+{
+    static SOCKET fd = ::open("/dev/null", O_WRONLY);
+    return fd;
+}
+
+// A client whose output goes nowhere: queued buffers are dropped by drain()
+// instead of being written to a socket
+class MemoryClient : public Client
+{
+public:
+    explicit MemoryClient(ChatServer *srv) : Client(placeholderSocket(), srv)
+    {
+        setProtocol(Protocol::Text);
+    }
+
+    ~MemoryClient()
+    {
+        clientSocket = INVALID_SOCKET; // Shared; not ours to close
+    }
+
+    size_t drain()
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        size_t drained = outboundBytes;
+        consumeOutbound(outboundBytes);
+        return drained;
+    }
+
+protected:
+    void onOutboundQueued(bool) override {}
+};
+
+struct Result
+{
+    std::string name;
+    long iterations;
+    double medianNs;
+    double minNs;
+};
+
+static double minTime = 0.2;
+static std::string filter;
+static std::vector<Result> results;
+
+// Times body() over batches of batchSize calls; between() runs after each
+// batch, outside the timed region (e.g. to drain queues)
+static void measure(const std::string &name, long batchSize, const std::function<void()> &body,
+                    const std::function<void()> &between = [] {})
+{
+    if (name.find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    for (long i = 0; i < batchSize; ++i) // Warm-up
+        body();
+    between();
+
+    std::vector<double> samples;
+    long iterations = 0;
+    for (int repetition = 0; repetition < 5; ++repetition)
+    {
+        Clock::duration elapsed{};
+        long calls = 0;
+        while (std::chrono::duration<double>(elapsed).count() < minTime)
+        {
+            auto start = Clock::now();
+            for (long i = 0; i < batchSize; ++i)
+                body();
+            elapsed += Clock::now() - start;
+            calls += batchSize;
+            between();
+        }
+        samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / calls);
+        iterations += calls;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    results.push_back({name, iterations, samples[samples.size() / 2], samples.front()});
+    std::cerr << name << ": " << samples[samples.size() / 2] << " ns/op" << std::endl;
+}
+
+// Logs in count in-memory clients the way handleLogin does, minus the
+// per-login INFO broadcast, and puts them in the default room
+static std::vector<std::shared_ptr<MemoryClient>> loginClients(ChatServer &server, int count, std::shared_ptr<Room> &room)
+{
+    std::vector<std::shared_ptr<MemoryClient>> clients;
+    for (int i = 0; i < count; ++i)
+    {
+        auto client = ClientPool::make<MemoryClient>(&server);
+        std::string name = "user" + std::to_string(i);
+        server.claimUsername(name, client, [](bool) {}); // No peers: settled at once
+        client->setUsername(name);
+        client->setAuthenticated(true);
+        server.addAuthenticatedClient(client);
+        server.joinRoom(client, DEFAULT_ROOM, room);
+        clients.push_back(client);
+    }
+    return clients;
+}
+
+static void benchHandleMessage()
+{
+    // One client sends millions of commands; rate limiting would refuse them
+    ServerOptions options;
+    options.commandRate = 0;
+    options.byteRate = 0;
+    ChatServer server(options);
+    ChatListener listener(&server);
+    std::shared_ptr<Room> room;
+    auto clients = loginClients(server, 10, room);
+    auto &client = clients.front();
+
+    // Replies are discarded after every batch; the room holds ten users, so
+    // MSG fans out to nine and WHO lists ten
+    auto drainAll = [&]
+    {
+        for (auto &c : clients)
+            c->drain();
+    };
+    const std::pair<const char *, const char *> lines[] = {
+        {"PING", "PING"},
+        {"MSG", "MSG hello everyone, this is a typical chat line of moderate length"},
+        {"DM", "DM user1 are you around for a quick call later today?"},
+        {"WHO", "WHO"},
+        {"unknown", "FROB something"},
+    };
+    for (auto &line : lines)
+    {
+        std::string_view text = line.second;
+        measure(std::string("handleMessage/") + line.first, 256, [&]
+                { listener.handleMessage(client, text); }, drainAll);
+    }
+}
+
+static void benchFanout()
+{
+    for (int members : {10, 100, 1000})
+    {
+        ChatServer server;
+        std::shared_ptr<Room> room;
+        auto clients = loginClients(server, members, room);
+
+        const std::string &sender = clients.front()->getUsername();
+
+        // Small batches keep every queue under the high watermark
+        measure("fanout/" + std::to_string(members), 64, [&]
+                { server.getBroadcasts().chatMessage(*room, sender, "hello everyone, this is a typical chat line of moderate length"); },
+                [&]
+                {
+                    for (auto &c : clients)
+                        c->drain();
+                });
+    }
+}
+
+static void benchLookup()
+{
+    for (int users : {10, 1000, 100000})
+    {
+        // Names map onto a small pool of clients: lookups only touch the
+        // registry and the authenticated flag, and 100k full clients would
+        // mostly measure cache misses on receive rings
+        ChatServer server;
+        std::vector<std::shared_ptr<MemoryClient>> pool;
+        for (int i = 0; i < 64; ++i)
+        {
+            pool.push_back(ClientPool::make<MemoryClient>(&server));
+            pool.back()->setAuthenticated(true);
+        }
+
+        std::vector<std::string> names, missing;
+        for (int i = 0; i < users; ++i)
+        {
+            names.push_back("user" + std::to_string(i));
+            missing.push_back("nobody" + std::to_string(i));
+            server.claimUsername(names.back(), pool[i % pool.size()], [](bool) {});
+        }
+
+        size_t next = 0;
+        std::string suffix = "/" + std::to_string(users);
+        measure("lookup/findClientByUsername" + suffix, 1024, [&]
+                {
+                    volatile bool found = server.findClientByUsername(names[next]) != nullptr;
+                    (void)found;
+                    next = next + 1 == names.size() ? 0 : next + 1; });
+        measure("lookup/isUsernameTaken" + suffix, 1024, [&]
+                {
+                    volatile bool taken = server.isUsernameTaken(names[next]);
+                    (void)taken;
+                    next = next + 1 == names.size() ? 0 : next + 1; });
+        measure("lookup/isUsernameTaken-miss" + suffix, 1024, [&]
+                {
+                    volatile bool taken = server.isUsernameTaken(missing[next]);
+                    (void)taken;
+                    next = next + 1 == missing.size() ? 0 : next + 1; });
+    }
+}
+
+static void benchSendMessage()
+{
+    ChatServer server;
+    auto client = ClientPool::make<MemoryClient>(&server);
+
+    for (size_t bytes : {16, 64, 512})
+    {
+        std::string message = "MSG user0 " + std::string(bytes, 'x');
+        message.resize(bytes);
+        measure("sendMessage/" + std::to_string(bytes), 256, [&]
+                { client->sendMessage(message); }, [&]
+                { client->drain(); });
+    }
+}
+
+static void writeJson()
+{
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::cout << "{\n";
+    std::cout << "  \"context\": {\"date\": \"" << date << "\", \"compiler\": \"" << __VERSION__ << "\", \"min_time_s\": " << minTime << "},\n";
+    std::cout << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &r = results[i];
+        std::cout << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                  << ", \"ns_per_op\": " << r.medianNs << ", \"ns_per_op_min\": " << r.minNs << "}"
+                  << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--filter=", 0) == 0)
+            filter = arg.substr(9);
+        else if (arg.rfind("--min-time=", 0) == 0)
+            minTime = std::atof(arg.c_str() + 11);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter=substring] [--min-time=0.2]" << std::endl;
+            return 1;
+        }
+    }
+
+    benchHandleMessage();
+    benchFanout();
+    benchLookup();
+    benchSendMessage();
+    writeJson();
+    return 0;
+}
@@ -0,0 +1,129 @@
+// Parallel fan-out benchmark: times one room broadcast, from the call to the
+// last recipient's write, with the fan-out pool at different sizes, to find
+// the recipient count where splitting a broadcast starts to pay off (the
+// server's --fanout-threshold).
+//
+// Recipients are in-memory clients whose output is written to /dev/null as
+// soon as it is queued, so each delivery costs a syscall like a real socket
+// write does, without needing tens of thousands of connections. The pool is
+// forced on for every size (threshold 1); 0 workers is the sequential loop.
+//
+// Usage: ./ParallelFanoutBench [broadcasts] [max-workers]
+
+#include "../ChatServer.h"
+#include "../ClientPool.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static int nullFd = -1;
+
+// Writes whatever is queued straight away, the way a writable socket would
+// take it. Every client shares the one /dev/null descriptor.
+class NullClient : public Client
+{
+public:
+    explicit NullClient(ChatServer *srv) : Client(nullFd, srv)
+    {
+        setProtocol(Protocol::Text);
+    }
+
+    ~NullClient()
+    {
+        clientSocket = INVALID_SOCKET; // Not ours to close
+    }
+
+protected:
+    void onOutboundQueued(bool) override
+    {
+        static const std::vector<char> scratch(64 * 1024);
+        std::lock_guard<std::mutex> lock(sendMutex);
+        size_t length = std::min(outboundBytes, scratch.size());
+        (void)!::write(nullFd, scratch.data(), length);
+        consumeOutbound(outboundBytes);
+    }
+};
+
+// Median microseconds per broadcast to `recipients` with `workers` pool threads
+static double run(int recipients, int workers, int broadcasts)
+{
+    ServerOptions options;
+    options.ioBackend = IoBackendType::Threads; // Unsharded, so the pool is used
+    options.fanoutThreads = workers;
+    options.fanoutThreshold = 1;
+    ChatServer server(options);
+
+    // Members are listed directly rather than logged in and joined one by
+    // one: every join copies the room's snapshot, which is quadratic at 50k
+    auto members = std::make_shared<Room::Members>();
+    for (int i = 0; i < recipients; ++i)
+    {
+        auto client = ClientPool::make<NullClient>(&server);
+        client->setUsername("user" + std::to_string(i));
+        client->setAuthenticated(true);
+        members->push_back(client);
+    }
+
+    WireRef payload = WireBuffer::frame("MSG sender hello everyone, this is a typical chat line of moderate length");
+
+    std::vector<double> samples;
+    for (int i = 0; i < broadcasts + 2; ++i)
+    {
+        auto start = Clock::now();
+        server.getBroadcasts().toMembers(members, payload, "sender");
+        samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    samples.erase(samples.begin(), samples.begin() + 2); // Warm-up
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+    int broadcasts = argc > 1 ? std::atoi(argv[1]) : 50;
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    int maxWorkers = argc > 2 ? std::atoi(argv[2]) : std::max(cores - 1, 1);
+
+    nullFd = ::open("/dev/null", O_WRONLY);
+    if (nullFd < 0 || broadcasts < 1)
+    {
+        std::cerr << "Usage: " << argv[0] << " [broadcasts] [max-workers]" << std::endl;
+        return 1;
+    }
+    Log::setLevel(Log::Level::Warn);
+
+    std::vector<int> workerCounts{0};
+    for (int workers = 1; workers < maxWorkers; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(maxWorkers);
+
+    std::cerr << cores << " cores, " << broadcasts << " broadcasts per point" << std::endl;
+    std::cout << "recipients,workers,us_per_broadcast,speedup" << std::endl;
+    for (int recipients : {256, 1024, 4096, 16384, 50000})
+    {
+        double sequential = 0;
+        for (int workers : workerCounts)
+        {
+            double us = run(recipients, workers, broadcasts);
+            if (workers == 0)
+            {
+                sequential = us;
+            }
+            std::cout << recipients << "," << workers << "," << us << "," << sequential / us << std::endl;
+        }
+    }
+    ::close(nullFd);
+    return 0;
+}
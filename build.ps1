@@ -14,7 +14,7 @@ if ($gppExists) {
     Write-Host "`nBuilding with g++..." -ForegroundColor Green
     
     Write-Host "Compiling server..." -ForegroundColor Yellow
-    g++ -std=c++17 -O2 -static -static-libgcc -static-libstdc++ -o ChatServer.exe main.cpp ChatServer.cpp Client.cpp ChatListener.cpp BroadcastClient.cpp DMClient.cpp -lws2_32
+    g++ -std=c++17 -O2 -static -static-libgcc -static-libstdc++ -o ChatServer.exe main.cpp ChatServer.cpp Client.cpp ChatListener.cpp BroadcastService.cpp DMService.cpp Reactor.cpp UringBackend.cpp ReceiveBuffer.cpp WireBuffer.cpp UserRegistry.cpp ClientRoster.cpp CommandTable.cpp TimerWheel.cpp RoomManager.cpp Connect.cpp BinaryProtocol.cpp Compression.cpp Metrics.cpp Logger.cpp MessageLog.cpp MailboxStore.cpp FanoutPool.cpp CommandPool.cpp ClientPool.cpp TokenBucket.cpp Federation.cpp HotRestart.cpp -lws2_32
     
     if ($LASTEXITCODE -eq 0) {
         Write-Host "✓ Server build successful!" -ForegroundColor Green
@@ -43,7 +43,7 @@ else {
         Write-Host "✓ cl found" -ForegroundColor Green
         
         Write-Host "`nCompiling server..." -ForegroundColor Yellow
-        cl /EHsc /std:c++17 /O2 /Fe:ChatServer.exe main.cpp MessageServer.cpp Connect.cpp ChatListener.cpp BroadcastMessage.cpp DM.cpp ws2_32.lib /nologo
+        cl /EHsc /std:c++17 /O2 /Fe:ChatServer.exe main.cpp ChatServer.cpp Client.cpp ChatListener.cpp BroadcastService.cpp DMService.cpp Reactor.cpp UringBackend.cpp ReceiveBuffer.cpp WireBuffer.cpp UserRegistry.cpp ClientRoster.cpp CommandTable.cpp TimerWheel.cpp RoomManager.cpp Connect.cpp BinaryProtocol.cpp Compression.cpp Metrics.cpp Logger.cpp MessageLog.cpp MailboxStore.cpp FanoutPool.cpp CommandPool.cpp ClientPool.cpp TokenBucket.cpp Federation.cpp HotRestart.cpp ws2_32.lib /nologo
         
         if ($LASTEXITCODE -eq 0) {
             Write-Host "✓ Server build successful!" -ForegroundColor Green
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Build script for TCP Chat Server on Linux
+# Usage: ./build.sh
+
+set -e
+
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++17 -O2 -pthread"
+LIBS=""
+
+# zlib is optional: with it the binary protocol can negotiate compression
+if echo '#include <zlib.h>' | $CXX -E -x c++ - >/dev/null 2>&1; then
+    CXXFLAGS="$CXXFLAGS -DCHATTCP_HAVE_ZLIB"
+    LIBS="-lz"
+fi
+
+CORE_SOURCES="ChatServer.cpp Client.cpp ChatListener.cpp BroadcastService.cpp DMService.cpp Reactor.cpp UringBackend.cpp ReceiveBuffer.cpp WireBuffer.cpp UserRegistry.cpp ClientRoster.cpp CommandTable.cpp TimerWheel.cpp RoomManager.cpp Connect.cpp BinaryProtocol.cpp Compression.cpp Metrics.cpp Logger.cpp MessageLog.cpp MailboxStore.cpp FanoutPool.cpp CommandPool.cpp ClientPool.cpp TokenBucket.cpp Federation.cpp HotRestart.cpp"
+SERVER_SOURCES="main.cpp $CORE_SOURCES"
+
+echo "========================================"
+echo "   Building TCP Chat Server (Linux)"
+echo "========================================"
+
+echo "Compiling server..."
+$CXX $CXXFLAGS -o ChatServer $SERVER_SOURCES $LIBS
+
+echo "Building test client..."
+$CXX $CXXFLAGS -o ChatClient ChatClient.cpp
+
+echo "Building benchmarks..."
+$CXX $CXXFLAGS -o bench/IdleConnections bench/IdleConnections.cpp
+$CXX $CXXFLAGS -o bench/BroadcastBench bench/BroadcastBench.cpp
+$CXX $CXXFLAGS -o bench/FanoutBench bench/FanoutBench.cpp WireBuffer.cpp
+$CXX $CXXFLAGS -o bench/CommandBench bench/CommandBench.cpp CommandTable.cpp
+$CXX $CXXFLAGS -o bench/LoadGen bench/LoadGen.cpp
+$CXX $CXXFLAGS -o bench/MicroBench bench/MicroBench.cpp $CORE_SOURCES $LIBS
+$CXX $CXXFLAGS -o bench/ParallelFanoutBench bench/ParallelFanoutBench.cpp $CORE_SOURCES $LIBS
+if [ -n "$LIBS" ]; then
+    $CXX $CXXFLAGS -o bench/CompressionBench bench/CompressionBench.cpp Compression.cpp WireBuffer.cpp $LIBS
+fi
+
+echo "========================================"
+echo "   Build Complete!"
+echo "========================================"
+echo "To run the server:"
+echo "  ./ChatServer"
+echo "  ./ChatServer 5000 120    (custom port & timeout)"
@@ -1,8 +1,11 @@
 #include "ChatServer.h"
+#include "Logger.h"
 #include <iostream>
 #include <cstdlib>
 #include <csignal>
+#include <string>
 #include "serverDefaults.h"
+#include "ServerOptions.h"
 
 ChatServer* globalServer = nullptr;
 
@@ -11,38 +14,134 @@ void signalHandler(int signal) {
     if (globalServer) {
         globalServer->stop();
     }
+    Log::stop();
     exit(0);
 }
 
 int main(int argc, char* argv[]) {
-    int port = DEFAULT_PORT;
-    int idleTimeout = DEFAULT_IDLE_TIMEOUT; 
+    ServerOptions options;
+    int positional = 0;
 
-    // Check for port from CLI
-    if (argc >= 2) {
-        port = std::atoi(argv[1]);
-    }
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
 
-    // Check for idle timeout from CLI
-    if (argc >= 3) {
-        idleTimeout = std::atoi(argv[2]);
+        if (arg.rfind("--io=", 0) == 0) {
+            if (!parseIoBackend(arg.substr(5), options.ioBackend)) {
+                std::cerr << "Unknown I/O backend: " << arg.substr(5) << " (use threads, epoll or uring)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--shards=", 0) == 0) {
+            options.shards = std::atoi(arg.c_str() + 9);
+        }
+        else if (arg == "--pin-cpus") {
+            options.pinCpus = true;
+        }
+        else if (arg.rfind("--fanout-threads=", 0) == 0) {
+            options.fanoutThreads = std::atoi(arg.c_str() + 17);
+        }
+        else if (arg.rfind("--fanout-threshold=", 0) == 0) {
+            options.fanoutThreshold = std::strtoul(arg.c_str() + 19, nullptr, 10);
+        }
+        else if (arg.rfind("--command-threads=", 0) == 0) {
+            options.commandThreads = std::atoi(arg.c_str() + 18);
+        }
+        else if (arg.rfind("--command-rate=", 0) == 0) {
+            options.commandRate = std::strtoul(arg.c_str() + 15, nullptr, 10);
+        }
+        else if (arg.rfind("--command-burst=", 0) == 0) {
+            options.commandBurst = std::strtoul(arg.c_str() + 16, nullptr, 10);
+        }
+        else if (arg.rfind("--byte-rate=", 0) == 0) {
+            options.byteRate = std::strtoul(arg.c_str() + 12, nullptr, 10);
+        }
+        else if (arg.rfind("--byte-burst=", 0) == 0) {
+            options.byteBurst = std::strtoul(arg.c_str() + 13, nullptr, 10);
+        }
+        else if (arg.rfind("--fanout-budget=", 0) == 0) {
+            options.fanoutBudget = std::strtoul(arg.c_str() + 16, nullptr, 10);
+        }
+        else if (arg.rfind("--out-high=", 0) == 0) {
+            options.outboundHighWatermark = std::strtoul(arg.c_str() + 11, nullptr, 10);
+        }
+        else if (arg.rfind("--out-low=", 0) == 0) {
+            options.outboundLowWatermark = std::strtoul(arg.c_str() + 10, nullptr, 10);
+        }
+        else if (arg.rfind("--slow-policy=", 0) == 0) {
+            if (!parseSlowConsumerPolicy(arg.substr(14), options.slowConsumerPolicy)) {
+                std::cerr << "Unknown slow consumer policy: " << arg.substr(14) << " (use disconnect or drop)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--slow-grace-ms=", 0) == 0) {
+            options.slowConsumerGraceMs = std::atoi(arg.c_str() + 16);
+        }
+        else if (arg.rfind("--stats-port=", 0) == 0) {
+            options.statsPort = std::atoi(arg.c_str() + 13);
+        }
+        else if (arg.rfind("--admin-token=", 0) == 0) {
+            options.adminToken = arg.substr(14);
+        }
+        else if (arg.rfind("--history-dir=", 0) == 0) {
+            options.historyDir = arg.substr(14);
+        }
+        else if (arg.rfind("--mailbox-dir=", 0) == 0) {
+            options.mailboxDir = arg.substr(14);
+        }
+        else if (arg.rfind("--peer-port=", 0) == 0) {
+            options.peerPort = std::atoi(arg.c_str() + 12);
+        }
+        else if (arg.rfind("--peer-bind=", 0) == 0) {
+            options.peerBind = arg.substr(12);
+        }
+        else if (arg.rfind("--peer=", 0) == 0) {
+            options.peers.push_back(arg.substr(7));
+        }
+        else if (arg.rfind("--node-id=", 0) == 0) {
+            options.nodeId = arg.substr(10);
+        }
+        else if (arg.rfind("--handoff-socket=", 0) == 0) {
+            options.handoffSocket = arg.substr(17);
+        }
+        else if (arg.rfind("--log-level=", 0) == 0) {
+            Log::Level level;
+            if (!Log::parseLevel(arg.substr(12), level)) {
+                std::cerr << "Unknown log level: " << arg.substr(12) << " (use debug, info, warn or error)" << std::endl;
+                return 1;
+            }
+            Log::setLevel(level);
+        }
+        else if (positional == 0) {
+            // Check for port from CLI
+            options.port = std::atoi(argv[i]);
+            ++positional;
+        }
+        else if (positional == 1) {
+            // Check for idle timeout from CLI
+            options.idleTimeoutSeconds = std::atoi(argv[i]);
+            ++positional;
+        }
     }
 
     std::cout << "========================================" << std::endl;
     std::cout << "   TCP Chat Server (OOP Architecture)" << std::endl;
     std::cout << "========================================" << std::endl;
-    std::cout << "Port: " << port << std::endl;
-    std::cout << "Idle Timeout: " << idleTimeout << " seconds" << std::endl;
+    std::cout << "Port: " << options.port << std::endl;
+    std::cout << "Idle Timeout: " << options.idleTimeoutSeconds << " seconds" << std::endl;
+    if (options.outboundLowWatermark > options.outboundHighWatermark) {
+        options.outboundLowWatermark = options.outboundHighWatermark;
+    }
+
     std::cout << "========================================" << std::endl;
     std::cout << "\nArchitecture:" << std::endl;
     std::cout << "  - ChatServer: Main server (always active)" << std::endl;
     std::cout << "  - Client: Base class for each connection" << std::endl;
-    std::cout << "  - BroadcastClient: Handles message broadcasting" << std::endl;
-    std::cout << "  - DMClient: Handles direct messages" << std::endl;
+    std::cout << "  - BroadcastService: Handles message broadcasting" << std::endl;
+    std::cout << "  - DMService: Handles direct messages" << std::endl;
     std::cout << "  - Connect: Manages client-server connection" << std::endl;
     std::cout << "========================================" << std::endl;
 
-    ChatServer server(port, idleTimeout);
+    ChatServer server(options);
     globalServer = &server;
 
     // Set up signal handler for graceful shutdown
@@ -56,13 +155,25 @@ int main(int argc, char* argv[]) {
 
     std::cout << "\nProtocol Commands:" << std::endl;
     std::cout << "  LOGIN <username>   - Log in with a username" << std::endl;
-    std::cout << "  MSG <text>         - Send a message to all users" << std::endl;
-    std::cout << "  DM <user> <text>   - Send a direct message" << std::endl;
+    std::cout << "  MSG <text>         - Send a message to your current room" << std::endl;
+    std::cout << "  JOIN <#room>       - Join a room and make it current" << std::endl;
+    std::cout << "  PART [#room]       - Leave a room (default: the current one)" << std::endl;
+    std::cout << "  ROOM [#room]       - Switch the current room, or list joined rooms" << std::endl;
+    std::cout << "  DM <user> <text>   - Send a direct message" << (options.mailboxDir.empty() ? "" : " (kept for offline users)") << std::endl;
     std::cout << "  WHO                - List all connected users" << std::endl;
     std::cout << "  PING               - Keep connection alive (server responds with PONG)" << std::endl;
+    if (!options.historyDir.empty()) {
+        std::cout << "  HISTORY [n]        - Replay recent messages from your rooms and DMs" << std::endl;
+    }
+    if (!options.adminToken.empty()) {
+        std::cout << "  STATS <token>      - Server metrics (admin token required)" << std::endl;
+    }
     std::cout << "\nPress Ctrl+C to stop the server\n" << std::endl;
 
+    // From here on, connection threads hand their log lines to a writer thread
+    Log::start();
     server.start();
+    Log::stop();
 
     return 0;
 }
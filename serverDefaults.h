@@ -1,3 +1,69 @@
 #define DEFAULT_PORT 4000
 #define DEFAULT_IDLE_TIMEOUT 60
-#define MAX_BUFFER_SIZE 1024
\ No newline at end of file
+#define MAX_BUFFER_SIZE 1024
+#define REACTOR_MAX_EVENTS 256
+#define REACTOR_READS_PER_EVENT 4
+#define URING_QUEUE_DEPTH 1024
+#define URING_BUFFER_COUNT 1024
+#define URING_MAX_IOV 64
+#define RECV_BUFFER_SIZE 4096
+#define DEFAULT_OUTBOUND_HIGH_WATERMARK (256 * 1024)
+#define DEFAULT_OUTBOUND_LOW_WATERMARK (64 * 1024)
+#define DEFAULT_SLOW_CONSUMER_GRACE_MS 5000
+#define OUTBOUND_HARD_LIMIT_FACTOR 4
+#define OUTBOUND_MAX_IOV 64
+#define WRITER_POLL_MS 50
+#define USER_REGISTRY_STRIPES 64
+#define COMMAND_TABLE_SIZE 64
+#define TIMER_TICK_MS 100
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_LEVELS 4
+#define DEFAULT_ROOM "#lobby"
+#define ROOM_NAME_MAX_LENGTH 32
+#define MAX_ROOMS_PER_CLIENT 64
+#define BINARY_PROTOCOL_VERSION 1
+#define BINARY_MAX_FRAME (64 * 1024)
+#define DEFLATE_LEVEL 6
+#define DEFLATE_MIN_FRAME 96
+#define METRICS_POLL_MS 200
+#define LOG_RECORD_SIZE 240
+#define LOG_RING_RECORDS 64
+#define LOG_FLUSH_MS 20
+#define LOG_RATE_SLOTS 64
+#define LOG_RATE_WINDOW_MS 1000
+#define LOG_RATE_BURST 5
+#define HISTORY_SEGMENT_SIZE (16 * 1024 * 1024)
+#define HISTORY_MAX_SEGMENTS 8
+#define HISTORY_INDEX_INTERVAL 64
+#define HISTORY_MAX_PENDING (4 * 1024 * 1024)
+#define HISTORY_SCAN_LIMIT 200000
+#define HISTORY_DEFAULT_COUNT 20
+#define HISTORY_MAX_COUNT 200
+#define MAILBOX_MAX_MESSAGES 100
+#define MAILBOX_MAX_BYTES (64 * 1024)
+#define MAILBOX_MAX_USERS 10000
+#define MAILBOX_MAX_NAME 64
+#define MAILBOX_TTL_SECONDS (7 * 24 * 3600)
+#define MAILBOX_SWEEP_MS (10 * 60 * 1000)
+#define DEFAULT_FANOUT_THRESHOLD 4096
+#define FANOUT_CHUNK 512
+#define COMMAND_INBOX_LIMIT (64 * 1024)
+#define COMMAND_STALL_POLL_MS 200
+#define COMMAND_BATCHES_PER_TURN 4
+#define CLIENT_SLAB_SLOTS 64
+#define DEFAULT_COMMAND_RATE 100
+#define DEFAULT_COMMAND_BURST 200
+#define DEFAULT_BYTE_RATE (128 * 1024)
+#define DEFAULT_BYTE_BURST (512 * 1024)
+#define PEER_POLL_MS 200
+#define PEER_RETRY_MS 1000
+#define PEER_HANDSHAKE_MS 2000
+#define PEER_CLAIM_TIMEOUT_MS 2000
+#define PEER_MAX_FRAME (BINARY_MAX_FRAME + 1024)
+#define PEER_QUEUE_LIMIT (16 * 1024 * 1024)
+#define HANDOFF_POLL_MS 200
+#define HANDOFF_TIMEOUT_MS 10000
+#define HANDOFF_HELLO_MS 2000
+#define HANDOFF_FD_BATCH 200
+#define DEFAULT_PEER_BIND "127.0.0.1"
+#define REMOTE_USER_ID_BIT (1ULL << 63)
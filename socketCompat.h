@@ -0,0 +1,141 @@
+#ifndef SOCKETCOMPAT_H
+#define SOCKETCOMPAT_H
+
+// Thin portability layer so the server builds against Winsock on Windows and
+// BSD sockets on Linux. Only the names the code base already uses are mapped.
+
+#ifdef _WIN32
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 // WSAPoll
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+inline int lastSocketError()
+{
+    return WSAGetLastError();
+}
+
+inline bool socketWouldBlock()
+{
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+inline bool socketStartup()
+{
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+}
+
+inline void socketCleanup()
+{
+    WSACleanup();
+}
+
+inline bool setNonBlocking(SOCKET socket)
+{
+    u_long mode = 1;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+}
+
+inline int pollSockets(pollfd *fds, size_t count, int timeoutMs)
+{
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+}
+
+// Scatter/gather element for sendVector()
+typedef WSABUF IoSlice;
+
+inline void setIoSlice(IoSlice &slice, const char *data, size_t length)
+{
+    slice.buf = const_cast<char *>(data);
+    slice.len = static_cast<ULONG>(length);
+}
+
+// Writes the slices with one call; returns bytes written or SOCKET_ERROR
+inline long sendVector(SOCKET socket, IoSlice *slices, size_t count)
+{
+    DWORD sent = 0;
+    if (WSASend(socket, slices, static_cast<DWORD>(count), &sent, 0, NULL, NULL) == SOCKET_ERROR)
+    {
+        return SOCKET_ERROR;
+    }
+    return static_cast<long>(sent);
+}
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+
+typedef int SOCKET;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket ::close
+
+inline int lastSocketError()
+{
+    return errno;
+}
+
+inline bool socketWouldBlock()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+inline bool socketStartup()
+{
+    return true;
+}
+
+inline void socketCleanup()
+{
+}
+
+inline bool setNonBlocking(SOCKET socket)
+{
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+inline int pollSockets(pollfd *fds, size_t count, int timeoutMs)
+{
+    return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+
+// Scatter/gather element for sendVector()
+typedef iovec IoSlice;
+
+inline void setIoSlice(IoSlice &slice, const char *data, size_t length)
+{
+    slice.iov_base = const_cast<char *>(data);
+    slice.iov_len = length;
+}
+
+// Writes the slices with one call; returns bytes written or SOCKET_ERROR
+inline long sendVector(SOCKET socket, IoSlice *slices, size_t count)
+{
+    msghdr msg{};
+    msg.msg_iov = slices;
+    msg.msg_iovlen = count;
+    return static_cast<long>(sendmsg(socket, &msg, MSG_NOSIGNAL));
+}
+
+#endif
+
+#endif